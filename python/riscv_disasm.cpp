@@ -0,0 +1,285 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "columns.hpp"
+#include <memory>
+#include <mutex>
+
+//Python module over decoded_program. decode() takes anything with the buffer protocol, decodes it with the GIL
+//released and hands back every column as an array that points straight into the decoded_program, which lives
+//until the last array referring to it goes away
+
+namespace
+{
+	//Exports one column of a decoded_program through the buffer protocol, owner is a capsule holding the program
+	struct column_object
+	{
+		PyObject_HEAD
+		PyObject* owner;
+		void* data;
+		Py_ssize_t count;
+		Py_ssize_t item_size;
+		const char* format;
+	};
+
+	int column_getbuffer(PyObject* self, Py_buffer* view, int flags)
+	{
+		auto column = reinterpret_cast<column_object*>(self);
+
+		if (flags & PyBUF_WRITABLE) {
+			PyErr_SetString(PyExc_BufferError, "decoded columns are read only");
+			view->obj = nullptr;
+			return -1;
+		}
+
+		view->buf = column->data;
+		view->obj = Py_NewRef(self);
+		view->len = column->count * column->item_size;
+		view->itemsize = column->item_size;
+		view->readonly = 1;
+		view->ndim = 1;
+		view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>(column->format) : nullptr;
+		view->shape = (flags & PyBUF_ND) ? &column->count : nullptr;
+		view->strides = (flags & PyBUF_STRIDES) ? &column->item_size : nullptr;
+		view->suboffsets = nullptr;
+		view->internal = nullptr;
+
+		return 0;
+	}
+
+	void column_dealloc(PyObject* self)
+	{
+		Py_XDECREF(reinterpret_cast<column_object*>(self)->owner);
+		Py_TYPE(self)->tp_free(self);
+	}
+
+	PyBufferProcs column_buffer = { column_getbuffer, nullptr };
+
+	PyTypeObject column_type = [] {
+		PyTypeObject type{};
+
+		//The reference PyVarObject_HEAD_INIT would have set up, everything else starts out zero
+		Py_SET_REFCNT(reinterpret_cast<PyObject*>(&type), 1);
+
+		type.tp_name = "riscv_disasm.column";
+		type.tp_basicsize = sizeof(column_object);
+		type.tp_dealloc = column_dealloc;
+		type.tp_as_buffer = &column_buffer;
+		type.tp_flags = Py_TPFLAGS_DEFAULT;
+		type.tp_doc = "One column of decoded instructions, read only buffer";
+
+		return type;
+	}();
+
+	PyObject* numpy_frombuffer = nullptr;
+
+	void release_program(PyObject* capsule)
+	{
+		delete static_cast<riscv::decoded_program*>(PyCapsule_GetPointer(capsule, "riscv_disasm.program"));
+	}
+
+	//numpy.frombuffer on the column when numpy is around (no copy, the array keeps the column alive), a memoryview otherwise
+	PyObject* make_column(PyObject* owner, const void* data, const size_t count, const size_t item_size, const char* format, const char* dtype)
+	{
+		auto column = PyObject_New(column_object, &column_type);
+
+		if (!column)
+			return nullptr;
+
+		column->owner = Py_NewRef(owner);
+		column->data = const_cast<void*>(data);
+		column->count = static_cast<Py_ssize_t>(count);
+		column->item_size = static_cast<Py_ssize_t>(item_size);
+		column->format = format;
+
+		PyObject* result = numpy_frombuffer ? PyObject_CallFunction(numpy_frombuffer, "Os", column, dtype) : PyMemoryView_FromObject(reinterpret_cast<PyObject*>(column));
+
+		Py_DECREF(column);
+		return result;
+	}
+
+	std::mutex shared_pool_lock;
+	std::unique_ptr<riscv::thread_pool> shared_pool;
+
+	riscv::thread_pool& get_shared_pool()
+	{
+		std::scoped_lock lock{ shared_pool_lock };
+
+		if (!shared_pool)
+			shared_pool = std::make_unique<riscv::thread_pool>();
+
+		return *shared_pool;
+	}
+
+	PyObject* decode(PyObject*, PyObject* args, PyObject* kwargs)
+	{
+		static const char* keywords[] = { "code", "address", "rv32", "threads", nullptr };
+
+		Py_buffer code;
+		unsigned long long address = 0;
+		int rv32 = 0;
+		Py_ssize_t threads = 0;
+
+		if (!PyArg_ParseTupleAndKeywords(args, kwargs, "y*|Kpn:decode", const_cast<char**>(keywords), &code, &address, &rv32, &threads))
+			return nullptr;
+
+		const riscv::isa arch = rv32 ? riscv::isa::RV32 : riscv::isa::RV64;
+		riscv::decoded_program* program = nullptr;
+		std::string error;
+
+		Py_BEGIN_ALLOW_THREADS
+
+		try {
+			//The buffer is held until we're done, so the image can point right at it
+			riscv::image img{ arch };
+			img.add_segment(riscv::segment{ address, static_cast<const uint8_t*>(code.buf), static_cast<size_t>(code.len), true, false, "buffer" });
+
+			const riscv::segment& seg = img.get_segments().front();
+
+			if (threads > 0) {
+				riscv::thread_pool pool{ static_cast<size_t>(threads) };
+				program = new riscv::decoded_program{ riscv::decoded_program::decode(img, seg, pool) };
+			} else {
+				program = new riscv::decoded_program{ riscv::decoded_program::decode(img, seg, get_shared_pool()) };
+			}
+		} catch (const std::exception& exception) {
+			error = exception.what();
+		}
+
+		Py_END_ALLOW_THREADS
+
+		PyBuffer_Release(&code);
+
+		if (!program) {
+			PyErr_SetString(PyExc_RuntimeError, error.c_str());
+			return nullptr;
+		}
+
+		PyObject* owner = PyCapsule_New(program, "riscv_disasm.program", release_program);
+
+		if (!owner) {
+			delete program;
+			return nullptr;
+		}
+
+		PyObject* result = PyDict_New();
+
+		const struct
+		{
+			const char* name;
+			const void* data;
+			size_t item_size;
+			const char* format;
+			const char* dtype;
+		} columns[] = {
+			{ "offset", program->get_offsets().data(), 4, "I", "<u4" },
+			{ "mnemonic", program->get_mnemonics().data(), 2, "H", "<u2" },
+			{ "rd", program->get_rd().data(), 1, "B", "u1" },
+			{ "rs1", program->get_rs1().data(), 1, "B", "u1" },
+			{ "rs2", program->get_rs2().data(), 1, "B", "u1" },
+			{ "rs3", program->get_rs3().data(), 1, "B", "u1" },
+			{ "immediate", program->get_immediates().data(), 4, "i", "<i4" },
+			{ "flags", program->get_flags().data(), 1, "B", "u1" }
+		};
+
+		for (auto& column : columns)
+		{
+			PyObject* value = result ? make_column(owner, column.data, program->size(), column.item_size, column.format, column.dtype) : nullptr;
+
+			if (!value || PyDict_SetItemString(result, column.name, value) < 0) {
+				Py_XDECREF(value);
+				Py_XDECREF(result);
+				Py_DECREF(owner);
+				return nullptr;
+			}
+
+			Py_DECREF(value);
+		}
+
+		PyObject* base = PyLong_FromUnsignedLongLong(address);
+
+		if (!base || PyDict_SetItemString(result, "base", base) < 0) {
+			Py_XDECREF(base);
+			Py_DECREF(result);
+			Py_DECREF(owner);
+			return nullptr;
+		}
+
+		Py_DECREF(base);
+		Py_DECREF(owner);
+
+		return result;
+	}
+
+	PyObject* mnemonics(PyObject*, PyObject*)
+	{
+		const size_t count = riscv::instruction::get_mnemonic_count();
+		PyObject* names = PyList_New(static_cast<Py_ssize_t>(count));
+
+		for (size_t i = 0; names && i < count; i++)
+		{
+			const std::string_view name = riscv::instruction::get_mnemonic_name(static_cast<uint16_t>(i));
+			PyObject* text = PyUnicode_FromStringAndSize(name.data(), static_cast<Py_ssize_t>(name.size()));
+
+			if (!text) {
+				Py_DECREF(names);
+				return nullptr;
+			}
+
+			PyList_SET_ITEM(names, static_cast<Py_ssize_t>(i), text);
+		}
+
+		return names;
+	}
+
+	PyMethodDef methods[] = {
+		{ "decode", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(decode)), METH_VARARGS | METH_KEYWORDS,
+			"decode(code, address=0, rv32=False, threads=0) -> dict\n\n"
+			"Linear decode of a buffer (bytes, mmap, numpy array...) placed at address. Returns the columns offset, mnemonic,\n"
+			"rd, rs1, rs2, rs3, immediate and flags as numpy arrays (memoryviews without numpy) sharing the native memory,\n"
+			"plus base. threads=0 uses a pool shared by all calls, otherwise a pool of that many threads" },
+		{ "mnemonics", mnemonics, METH_NOARGS, "mnemonics() -> list of names, indexed by the mnemonic column" },
+		{ nullptr, nullptr, 0, nullptr }
+	};
+
+	PyModuleDef module_definition = { PyModuleDef_HEAD_INIT, "riscv_disasm", "RISC-V disassembler", -1, methods, nullptr, nullptr, nullptr, nullptr };
+}
+
+PyMODINIT_FUNC PyInit_riscv_disasm(void)
+{
+	if (PyType_Ready(&column_type) < 0)
+		return nullptr;
+
+	PyObject* module = PyModule_Create(&module_definition);
+
+	if (!module)
+		return nullptr;
+
+	//numpy is optional, without it the columns come back as memoryviews
+	if (PyObject* numpy = PyImport_ImportModule("numpy")) {
+		numpy_frombuffer = PyObject_GetAttrString(numpy, "frombuffer");
+		Py_DECREF(numpy);
+	}
+
+	PyErr_Clear();
+
+	PyModule_AddIntConstant(module, "invalid_mnemonic", riscv::instruction::invalid_mnemonic);
+	PyModule_AddIntConstant(module, "compressed", 0x10);
+	PyModule_AddIntConstant(module, "extension_mask", 0x0f);
+
+	return module;
+}
\ No newline at end of file
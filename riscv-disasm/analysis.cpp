@@ -0,0 +1,417 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "analysis.hpp"
+#include <algorithm>
+
+namespace riscv
+{
+	namespace analysis
+	{
+		namespace
+		{
+			//Working space for one function at a time, each worker keeps its own and reuses it so only the
+			//results end up in the dataflow's arena, at their final size
+			struct scratch
+			{
+				std::vector<uint32_t> block_of;
+				std::vector<uint32_t> visited;
+				std::vector<uint32_t> worklist;
+				std::vector<uint32_t> chains;
+				std::vector<uint32_t> offsets;
+			};
+
+			thread_local scratch local;
+		}
+
+		const control_flow classify(const instruction::object& instruction, const uint64_t address)
+		{
+			const uint32_t raw = instruction.get_expanded();
+			const uint64_t target = address + static_cast<int64_t>(instruction.get_immediate());
+
+			switch (raw & 0x7f)
+			{
+			case 0x63:
+				return { flow_kind::branch, target };
+
+			case 0x6f:
+				return { ((raw >> 7) & 0x1f) == 0 ? flow_kind::jump : flow_kind::call, target };
+
+			case 0x67: {
+				const uint32_t rd = (raw >> 7) & 0x1f;
+				const uint32_t rs1 = (raw >> 15) & 0x1f;
+
+				if (rd != 0)
+					return { flow_kind::indirect_call, 0 };
+
+				//jalr zero, 0(ra)
+				if (rs1 == 1 && instruction.get_immediate() == 0)
+					return { flow_kind::ret, 0 };
+
+				return { flow_kind::indirect_jump, 0 };
+			}
+
+			case 0x73:
+				if (raw == 0x73)
+					return { flow_kind::syscall, 0 };
+				break;
+			}
+
+			return { flow_kind::none, 0 };
+		}
+
+		dataflow::dataflow(const std::vector<instruction::object>& instructions, const uint64_t base_address, const std::vector<function_range>& functions, thread_pool& pool)
+			: m_instructions{ instructions }
+		{
+			m_addresses.reserve(instructions.size());
+
+			uint64_t address = base_address;
+			for (auto& instruction : instructions)
+			{
+				m_addresses.push_back(address);
+				address += instruction.get_length();
+			}
+
+			m_usage.resize(instructions.size());
+
+			//Table lookups dominate here so chunk them out over the pool as well
+			constexpr size_t chunk = 4096;
+			pool.parallel_for((instructions.size() + chunk - 1) / chunk, [this](const size_t c)
+			{
+				const size_t end = std::min(m_instructions.size(), (c + 1) * chunk);
+
+				for (size_t i = c * chunk; i < end; i++)
+				{
+					auto usage = m_instructions[i].get_register_usage();
+
+					switch (classify(m_instructions[i], m_addresses[i]).kind)
+					{
+					case flow_kind::call:
+					case flow_kind::indirect_call:
+						usage.use |= abi::arguments;
+						usage.def |= abi::caller_saved;
+						break;
+
+					case flow_kind::syscall:
+						usage.use |= abi::arguments;
+						usage.def |= abi::return_values;
+						break;
+
+					default:
+						break;
+					}
+
+					m_usage[i] = usage;
+				}
+			});
+
+			for (auto& range : functions)
+				m_functions.push_back(function_info{ range, std::pmr::vector<basic_block>{ &m_arena }, std::pmr::vector<uint32_t>{ &m_arena }, std::pmr::vector<uint32_t>{ &m_arena } });
+
+			pool.parallel_for(m_functions.size(), [this](const size_t i)
+			{
+				split_blocks(m_functions[i]);
+				solve_liveness(m_functions[i]);
+				build_def_use(m_functions[i]);
+			});
+		}
+
+		dataflow::dataflow(const std::vector<instruction::object>& instructions, const uint64_t base_address, thread_pool& pool)
+			: dataflow(instructions, base_address, { function_range{ 0, instructions.size() } }, pool)
+		{}
+
+		const std::vector<bool> find_leaders(const std::vector<instruction::object>& instructions, const std::vector<uint64_t>& addresses, const function_range& range)
+		{
+			auto& [begin, end] { range };
+
+			std::vector<bool> leaders(end - begin + 1, false);
+
+			if (begin >= end)
+				return leaders;
+
+			leaders[0] = true;
+
+			auto first = addresses.begin() + begin;
+			auto last = addresses.begin() + end;
+
+			for (size_t i = begin; i < end; i++)
+			{
+				auto flow = classify(instructions[i], addresses[i]);
+
+				switch (flow.kind)
+				{
+				case flow_kind::branch:
+				case flow_kind::jump: {
+					auto target = std::lower_bound(first, last, flow.target);
+
+					if (target != last && *target == flow.target)
+						leaders[target - first] = true;
+
+					leaders[i + 1 - begin] = true;
+					break;
+				}
+
+				case flow_kind::indirect_jump:
+				case flow_kind::ret:
+					leaders[i + 1 - begin] = true;
+					break;
+
+				default:
+					break;
+				}
+			}
+
+			return leaders;
+		}
+
+		const size_t dataflow::find_index(const uint64_t address, const function_range& range) const
+		{
+			auto first = m_addresses.begin() + range.begin;
+			auto last = m_addresses.begin() + range.end;
+			auto found = std::lower_bound(first, last, address);
+
+			if (found == last || *found != address)
+				return SIZE_MAX;
+
+			return found - m_addresses.begin();
+		}
+
+		void dataflow::split_blocks(function_info& function) const
+		{
+			auto& [begin, end] { function.range };
+
+			if (begin >= end)
+				return;
+
+			const std::vector<bool> leaders = find_leaders(m_instructions, m_addresses, function.range);
+
+			std::vector<uint32_t>& block_of = local.block_of;
+			block_of.assign(end - begin, 0);
+			function.blocks.reserve(std::count(leaders.begin(), leaders.end() - 1, true));
+
+			for (size_t i = begin; i < end; i++)
+			{
+				if (leaders[i - begin]) {
+					function.blocks.push_back(basic_block{ i, i, std::pmr::vector<uint32_t>{ &m_arena }, 0, 0, 0, 0, 0 });
+					function.blocks.back().successors.reserve(2);
+				}
+
+				function.blocks.back().end = i + 1;
+				block_of[i - begin] = static_cast<uint32_t>(function.blocks.size() - 1);
+			}
+
+			for (size_t b = 0; b < function.blocks.size(); b++)
+			{
+				auto& block = function.blocks[b];
+				const size_t last = block.end - 1;
+				const bool has_next = block.end < end;
+				auto flow = classify(m_instructions[last], m_addresses[last]);
+
+				//Jumping somewhere outside of the function is a tail call
+				auto add_target = [&](const uint64_t address)
+				{
+					const size_t target = find_index(address, function.range);
+
+					if (target != SIZE_MAX)
+						block.successors.push_back(block_of[target - begin]);
+					else //The callee returns through our ra, so it is still needed
+						block.exit_live |= abi::arguments | abi::callee_saved | abi::x_range(1, 1);
+				};
+
+				switch (flow.kind)
+				{
+				case flow_kind::branch:
+					add_target(flow.target);
+
+					if (has_next)
+						block.successors.push_back(static_cast<uint32_t>(b + 1));
+					else
+						block.exit_live = abi::all;
+					break;
+
+				case flow_kind::jump:
+					add_target(flow.target);
+					break;
+
+				case flow_kind::ret:
+					block.exit_live = abi::return_values | abi::callee_saved;
+					break;
+
+				//Could be a jump table or a tail call through a register, nothing we can rule out
+				case flow_kind::indirect_jump:
+					block.exit_live = abi::all;
+					break;
+
+				default:
+					if (has_next)
+						block.successors.push_back(static_cast<uint32_t>(b + 1));
+					else
+						block.exit_live = abi::all;
+					break;
+				}
+
+				for (size_t i = block.end; i-- > block.begin;)
+				{
+					block.use = (block.use & ~m_usage[i].def) | m_usage[i].use;
+					block.def |= m_usage[i].def;
+				}
+			}
+		}
+
+		void dataflow::solve_liveness(function_info& function) const
+		{
+			bool changed = true;
+
+			//Walking the blocks backwards converges in a couple of passes for anything that isn't a crazy loop nest
+			while (changed)
+			{
+				changed = false;
+
+				for (size_t b = function.blocks.size(); b-- > 0;)
+				{
+					auto& block = function.blocks[b];
+					uint64_t live_out = block.exit_live;
+
+					for (auto successor : block.successors)
+						live_out |= function.blocks[successor].live_in;
+
+					const uint64_t live_in = block.use | (live_out & ~block.def);
+
+					if (live_in != block.live_in || live_out != block.live_out) {
+						block.live_in = live_in;
+						block.live_out = live_out;
+						changed = true;
+					}
+				}
+			}
+		}
+
+		void dataflow::build_def_use(function_info& function) const
+		{
+			auto& [begin, end] { function.range };
+
+			function.def_use_offsets.assign(1, 0);
+
+			if (begin >= end)
+				return;
+
+			std::vector<uint32_t>& block_of = local.block_of;
+			block_of.assign(end - begin, 0);
+
+			for (uint32_t b = 0; b < function.blocks.size(); b++)
+				std::fill(block_of.begin() + (function.blocks[b].begin - begin), block_of.begin() + (function.blocks[b].end - begin), b);
+
+			std::vector<uint32_t>& visited = local.visited;
+			std::vector<uint32_t>& worklist = local.worklist;
+			std::vector<uint32_t>& chains = local.chains;
+			std::vector<uint32_t>& offsets = local.offsets;
+
+			visited.assign(function.blocks.size(), 0);
+			chains.clear();
+			offsets.assign(1, 0);
+			uint32_t stamp = 0;
+
+			//Collects the uses of reg starting at instruction index first, returns true if the value survives to the end of the block
+			auto scan = [&](const size_t first, const size_t last, const uint64_t reg)
+			{
+				for (size_t j = first; j < last; j++)
+				{
+					if (m_usage[j].use & reg)
+						chains.push_back(static_cast<uint32_t>(j));
+
+					if (m_usage[j].def & reg)
+						return false;
+				}
+
+				return true;
+			};
+
+			for (size_t i = begin; i < end; i++)
+			{
+				const size_t chain_start = chains.size();
+				uint64_t defs = m_usage[i].def;
+
+				while (defs)
+				{
+					const uint64_t reg = defs & (~defs + 1);
+					defs &= defs - 1;
+
+					auto& home = function.blocks[block_of[i - begin]];
+
+					if (!scan(i + 1, home.end, reg) || !(home.live_out & reg))
+						continue;
+
+					stamp++;
+					worklist.clear();
+
+					for (auto successor : home.successors)
+						worklist.push_back(successor);
+
+					while (!worklist.empty())
+					{
+						const uint32_t b = worklist.back();
+						worklist.pop_back();
+
+						auto& block = function.blocks[b];
+
+						if (visited[b] == stamp || !(block.live_in & reg))
+							continue;
+
+						visited[b] = stamp;
+
+						if (scan(block.begin, block.end, reg) && (block.live_out & reg)) {
+							for (auto successor : block.successors)
+								worklist.push_back(successor);
+						}
+					}
+				}
+
+				//Calls define a lot of registers at once, so the same use can show up more than once
+				std::sort(chains.begin() + chain_start, chains.end());
+				chains.erase(std::unique(chains.begin() + chain_start, chains.end()), chains.end());
+				offsets.push_back(static_cast<uint32_t>(chains.size()));
+			}
+
+			function.def_use_offsets.assign(offsets.begin(), offsets.end());
+			function.def_use_chains.assign(chains.begin(), chains.end());
+		}
+
+		const std::vector<function_info>& dataflow::get_functions() const
+		{
+			return m_functions;
+		}
+
+		const uint64_t dataflow::get_address(const size_t index) const
+		{
+			return m_addresses[index];
+		}
+
+		const instruction::register_usage& dataflow::get_usage(const size_t index) const
+		{
+			return m_usage[index];
+		}
+
+		const uint64_t dataflow::live_after(const function_info& function, const size_t block, const size_t index) const
+		{
+			auto& current = function.blocks[block];
+			uint64_t live = current.live_out;
+
+			for (size_t i = current.end; --i > index;)
+				live = (live & ~m_usage[i].def) | m_usage[i].use;
+
+			return live;
+		}
+	}
+}
@@ -0,0 +1,140 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "arena.hpp"
+#include "instructions.hpp"
+#include "thread_pool.hpp"
+
+namespace riscv
+{
+	namespace analysis
+	{
+		enum class flow_kind : uint8_t
+		{
+			none,
+			branch,
+			jump,
+			call,
+			indirect_jump,
+			indirect_call,
+			ret,
+			syscall
+		};
+
+		struct control_flow
+		{
+			flow_kind kind;
+			uint64_t target;
+		};
+
+		const control_flow classify(const instruction::object& instruction, const uint64_t address);
+
+		//Register sets the calling convention cares about, same bit layout as instruction::register_usage
+		namespace abi
+		{
+			constexpr uint64_t x_range(const uint32_t first, const uint32_t last)
+			{
+				return ((~0ull >> (63 - last)) >> first) << first;
+			}
+
+			constexpr uint64_t f_range(const uint32_t first, const uint32_t last)
+			{
+				return x_range(first + 32, last + 32);
+			}
+
+			constexpr uint64_t arguments = x_range(10, 17) | f_range(10, 17);
+			constexpr uint64_t return_values = x_range(10, 11) | f_range(10, 11);
+			constexpr uint64_t caller_saved = x_range(1, 1) | x_range(5, 7) | x_range(10, 17) | x_range(28, 31) | f_range(0, 7) | f_range(10, 17) | f_range(28, 31);
+			constexpr uint64_t callee_saved = x_range(2, 4) | x_range(8, 9) | x_range(18, 27) | f_range(8, 9) | f_range(18, 27);
+			constexpr uint64_t all = ~1ull;
+		}
+
+		//Indices into the instruction vector, end is exclusive
+		struct function_range
+		{
+			size_t begin;
+			size_t end;
+		};
+
+		//leaders[i] is set when instruction range.begin + i starts a basic block, one extra slot for the end
+		const std::vector<bool> find_leaders(const std::vector<instruction::object>& instructions, const std::vector<uint64_t>& addresses, const function_range& range);
+
+		struct basic_block
+		{
+			size_t begin;
+			size_t end;
+			std::pmr::vector<uint32_t> successors;
+
+			//What is live once control leaves the function from this block (returns, tail calls, indirect jumps)
+			uint64_t exit_live;
+
+			//Upward exposed uses and everything written inside the block
+			uint64_t use;
+			uint64_t def;
+
+			uint64_t live_in;
+			uint64_t live_out;
+		};
+
+		struct function_info
+		{
+			function_range range;
+			std::pmr::vector<basic_block> blocks;
+
+			//def-use chains in compressed row form, uses of whatever instruction range.begin + i writes
+			//are def_use_chains[def_use_offsets[i] .. def_use_offsets[i + 1]] (global instruction indices)
+			std::pmr::vector<uint32_t> def_use_offsets;
+			std::pmr::vector<uint32_t> def_use_chains;
+		};
+
+		class dataflow
+		{
+			const std::vector<instruction::object>& m_instructions;
+			std::vector<uint64_t> m_addresses;
+			std::vector<instruction::register_usage> m_usage;
+
+			//Blocks, edges and chains of every function, all handed back at once with the dataflow
+			mutable arena m_arena{ 256 * 1024 };
+			std::vector<function_info> m_functions;
+
+			const size_t find_index(const uint64_t address, const function_range& range) const;
+
+			void split_blocks(function_info& function) const;
+			void solve_liveness(function_info& function) const;
+			void build_def_use(function_info& function) const;
+
+		public:
+			dataflow() = delete;
+			dataflow(const dataflow& flow) = delete;
+			dataflow(dataflow&& flow) = delete;
+
+			dataflow(const std::vector<instruction::object>& instructions, const uint64_t base_address, const std::vector<function_range>& functions, thread_pool& pool);
+
+			//Treats the whole listing as a single function
+			dataflow(const std::vector<instruction::object>& instructions, const uint64_t base_address, thread_pool& pool);
+
+			const std::vector<function_info>& get_functions() const;
+			const uint64_t get_address(const size_t index) const;
+
+			//Register usage including what calls, returns and system calls touch according to the calling convention
+			const instruction::register_usage& get_usage(const size_t index) const;
+
+			//Registers live right after the instruction executes
+			const uint64_t live_after(const function_info& function, const size_t block, const size_t index) const;
+		};
+	}
+}
@@ -0,0 +1,122 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "archive.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace riscv
+{
+	namespace archive
+	{
+		namespace
+		{
+			constexpr char magic[] = "!<arch>\n";
+			constexpr size_t magic_size = 8;
+			constexpr size_t header_size = 60;
+
+			std::string field(const std::vector<uint8_t>& file, const size_t offset, const size_t size)
+			{
+				std::string text{ reinterpret_cast<const char*>(file.data() + offset), size };
+				text.erase(text.find_last_not_of(' ') + 1);
+				return text;
+			}
+
+			size_t number(const std::string& text)
+			{
+				size_t value = 0;
+
+				for (const char c : text)
+				{
+					if (c < '0' || c > '9')
+						throw std::runtime_error("ar: bad number in member header");
+
+					value = value * 10 + (c - '0');
+				}
+
+				return value;
+			}
+		}
+
+		bool is_archive(const std::vector<uint8_t>& file)
+		{
+			return file.size() >= magic_size && std::memcmp(file.data(), magic, magic_size) == 0;
+		}
+
+		std::vector<member> read(const std::vector<uint8_t>& file)
+		{
+			if (!is_archive(file))
+				throw std::runtime_error("ar: not an archive");
+
+			std::vector<member> members;
+			std::string long_names;
+
+			for (size_t offset = magic_size; offset + header_size <= file.size();)
+			{
+				if (file[offset + 58] != '`' || file[offset + 59] != '\n')
+					throw std::runtime_error("ar: bad member header");
+
+				std::string name = field(file, offset, 16);
+				size_t size = number(field(file, offset + 48, 10));
+				size_t data = offset + header_size;
+
+				if (data > file.size() || file.size() - data < size)
+					throw std::runtime_error("ar: member extends past the end of the file");
+
+				//Members start on even offsets
+				const size_t next = data + size + (size & 1);
+
+				if (name == "/" || name == "/SYM64/" || name == "__.SYMDEF" || name == "__.SYMDEF SORTED") {
+					offset = next;
+					continue;
+				}
+
+				if (name == "//") {
+					long_names.assign(reinterpret_cast<const char*>(file.data() + data), size);
+					offset = next;
+					continue;
+				}
+
+				if (name.rfind("#1/", 0) == 0) {
+					//BSD: the name sits in front of the data and counts towards the size
+					const size_t length = number(name.substr(3));
+					if (length > size)
+						throw std::runtime_error("ar: bad member name");
+
+					name.assign(reinterpret_cast<const char*>(file.data() + data), length);
+					name.erase(name.find_last_not_of('\0') + 1);
+					data += length;
+					size -= length;
+				} else if (name.size() > 1 && name[0] == '/') {
+					//GNU: offset into the long name table, names there end in "/\n"
+					const size_t at = number(name.substr(1));
+					if (at >= long_names.size())
+						throw std::runtime_error("ar: bad long name offset");
+
+					name = long_names.substr(at, long_names.find('\n', at) - at);
+					if (!name.empty() && name.back() == '/')
+						name.pop_back();
+				} else if (!name.empty() && name.back() == '/') {
+					name.pop_back();
+				}
+
+				members.push_back({ std::move(name), std::vector<uint8_t>(file.begin() + data, file.begin() + data + size) });
+				offset = next;
+			}
+
+			return members;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace riscv
+{
+	namespace archive
+	{
+		struct member
+		{
+			std::string name;
+			std::vector<uint8_t> data;
+		};
+
+		bool is_archive(const std::vector<uint8_t>& file);
+
+		//Members of a System V/GNU or BSD ar archive in file order, the symbol index and long name table are skipped.
+		//Throws std::runtime_error on a malformed archive
+		std::vector<member> read(const std::vector<uint8_t>& file);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,143 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "arena.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace riscv
+{
+	arena::arena(const size_t block_size) : m_block_size{ block_size }
+	{}
+
+	arena::~arena()
+	{
+		release();
+	}
+
+	arena::block* arena::grow(block* full, const size_t minimum)
+	{
+		std::scoped_lock lock{ m_grow };
+
+		//Someone else already replaced it
+		block* current = m_current.load();
+		if (current != full)
+			return current;
+
+		const size_t capacity = std::max(m_block_size, minimum);
+		void* memory = std::malloc(sizeof(block) + capacity);
+
+		if (!memory)
+			throw std::bad_alloc{};
+
+		block* fresh = new (memory) block{ current, capacity, 0 };
+		m_reserved += sizeof(block) + capacity;
+		m_current.store(fresh);
+
+		return fresh;
+	}
+
+	void* arena::do_allocate(size_t bytes, size_t alignment)
+	{
+		//Worst case padding is claimed up front, the atomic add can't know where the previous allocation ended
+		const size_t claim = bytes + alignment - 1;
+
+		for (block* current = m_current.load();;)
+		{
+			if (current) {
+				const size_t offset = current->used.fetch_add(claim);
+
+				if (offset + claim <= current->capacity) {
+					const uintptr_t start = reinterpret_cast<uintptr_t>(current + 1) + offset;
+					return reinterpret_cast<void*>((start + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1));
+				}
+			}
+
+			current = grow(current, claim);
+		}
+	}
+
+	void arena::do_deallocate(void*, size_t, size_t)
+	{
+		//Monotonic, everything goes back in release()
+	}
+
+	bool arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+	{
+		return this == &other;
+	}
+
+	void arena::release()
+	{
+		std::scoped_lock lock{ m_grow };
+
+		for (block* current = m_current.exchange(nullptr); current;)
+		{
+			block* next = current->next;
+			current->~block();
+			std::free(current);
+			current = next;
+		}
+
+		m_reserved = 0;
+	}
+
+	const size_t arena::get_reserved() const
+	{
+		return m_reserved;
+	}
+
+	string_pool::string_pool() : m_arena{ 16 * 1024 }
+	{}
+
+	const uint32_t string_pool::intern(const std::string_view text)
+	{
+		std::scoped_lock lock{ m_lock };
+
+		if (auto found = m_index.find(text); found != m_index.end())
+			return found->second;
+
+		char* copy = static_cast<char*>(m_arena.allocate(text.size() + 1, 1));
+		std::memcpy(copy, text.data(), text.size());
+		copy[text.size()] = '\0';
+
+		const std::string_view stored{ copy, text.size() };
+		const uint32_t id = static_cast<uint32_t>(m_strings.size());
+
+		m_strings.push_back(stored);
+		m_index.emplace(stored, id);
+
+		return id;
+	}
+
+	const std::string_view string_pool::get(const uint32_t id) const
+	{
+		std::scoped_lock lock{ m_lock };
+		return m_strings[id];
+	}
+
+	const std::string_view string_pool::store(const std::string_view text)
+	{
+		const uint32_t id = intern(text);
+		return get(id);
+	}
+
+	const size_t string_pool::size() const
+	{
+		std::scoped_lock lock{ m_lock };
+		return m_strings.size();
+	}
+}
\ No newline at end of file
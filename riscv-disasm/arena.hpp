@@ -0,0 +1,89 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace riscv
+{
+	//Monotonic allocator for analysis results made of lots of small pieces: bumps through big blocks, never frees
+	//anything on its own and hands all of it back at once on release() or destruction. Allocating is one atomic add,
+	//so every worker filling in the same result can share the result's arena. Works as a std::pmr resource
+	class arena : public std::pmr::memory_resource
+	{
+		struct block
+		{
+			block* next;
+			size_t capacity;
+			std::atomic<size_t> used;
+		};
+
+		std::atomic<block*> m_current = nullptr;
+		std::mutex m_grow;
+		size_t m_block_size;
+		std::atomic<size_t> m_reserved = 0;
+
+		block* grow(block* full, const size_t minimum);
+
+	protected:
+		void* do_allocate(size_t bytes, size_t alignment) override;
+		void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+	public:
+		arena(const arena& other) = delete;
+		arena(arena&& other) = delete;
+
+		explicit arena(const size_t block_size = 64 * 1024);
+		~arena();
+
+		//Everything allocated so far is gone, nothing that points into the arena may be used afterwards
+		void release();
+
+		//Bytes taken from the system, not bytes handed out
+		const size_t get_reserved() const;
+	};
+
+	//Every distinct string stored once, in an arena, and referred to by a 32 bit id. Views stay valid for as long
+	//as the pool does. Safe to intern from several threads
+	class string_pool
+	{
+		arena m_arena;
+		mutable std::mutex m_lock;
+		std::vector<std::string_view> m_strings;
+		std::unordered_map<std::string_view, uint32_t> m_index;
+
+	public:
+		string_pool(const string_pool& pool) = delete;
+		string_pool(string_pool&& pool) = delete;
+
+		string_pool();
+
+		const uint32_t intern(const std::string_view text);
+		const std::string_view get(const uint32_t id) const;
+
+		//intern and get in one
+		const std::string_view store(const std::string_view text);
+
+		const size_t size() const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,129 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "batch.hpp"
+#include "archive.hpp"
+#include "elf.hpp"
+#include "program.hpp"
+#include <fstream>
+#include <set>
+
+namespace riscv
+{
+	namespace
+	{
+		bool is_batch_file(const std::filesystem::path& path)
+		{
+			return path.extension() == ".o" || path.extension() == ".a";
+		}
+
+		void list_elf(std::ostream& out, std::vector<uint8_t>&& file, thread_pool& pool)
+		{
+			const image img = elf::load(std::move(file));
+
+			program prog{ img, pool };
+			prog.analyze();
+			prog.print(out);
+		}
+
+		void process(const batch_input& input, thread_pool& pool)
+		{
+			std::vector<uint8_t> file = read_file(input.source.string());
+
+			std::filesystem::create_directories(input.output.parent_path());
+			std::ofstream out{ input.output };
+
+			if (!out)
+				throw std::runtime_error("can't create " + input.output.string());
+
+			if (!archive::is_archive(file)) {
+				list_elf(out, std::move(file), pool);
+				return;
+			}
+
+			for (auto& member : archive::read(file))
+			{
+				//Archives can carry things besides objects
+				if (!elf::is_elf(member.data))
+					continue;
+
+				out << "; " << member.name << "\n";
+				list_elf(out, std::move(member.data), pool);
+				out << "\n";
+			}
+		}
+	}
+
+	std::vector<batch_input> collect_inputs(const std::vector<std::filesystem::path>& paths, const std::filesystem::path& output_directory)
+	{
+		std::vector<batch_input> inputs;
+		std::set<std::filesystem::path> sources;
+		std::set<std::filesystem::path> outputs;
+
+		//a/lib.o and b/lib.o would both end up as lib.o.s, the later one gets lib.o.1.s and so on. The same file
+		//named twice is only listed once
+		auto add = [&](const std::filesystem::path& source, const std::string& name)
+		{
+			if (!sources.insert(std::filesystem::weakly_canonical(source)).second)
+				return;
+
+			std::filesystem::path output = output_directory / (name + ".s");
+
+			for (size_t suffix = 1; !outputs.insert(output).second; suffix++)
+				output = output_directory / (name + "." + std::to_string(suffix) + ".s");
+
+			inputs.push_back({ source, std::move(output) });
+		};
+
+		for (auto& path : paths)
+		{
+			if (!std::filesystem::is_directory(path)) {
+				add(path, path.filename().string());
+				continue;
+			}
+
+			for (auto& entry : std::filesystem::recursive_directory_iterator{ path })
+			{
+				if (entry.is_regular_file() && is_batch_file(entry.path()))
+					add(entry.path(), std::filesystem::relative(entry.path(), path).string());
+			}
+		}
+
+		return inputs;
+	}
+
+	size_t run_batch(const std::vector<batch_input>& inputs, thread_pool& pool, std::ostream& errors)
+	{
+		std::mutex lock;
+		size_t failed = 0;
+
+		pool.parallel_for(inputs.size(), [&](const size_t index)
+		{
+			try {
+				process(inputs[index], pool);
+			} catch (const std::exception& error) {
+				//No half written listings left behind
+				std::error_code ignored;
+				std::filesystem::remove(inputs[index].output, ignored);
+
+				std::scoped_lock guard{ lock };
+				errors << inputs[index].source.string() << ": " << error.what() << std::endl;
+				failed++;
+			}
+		});
+
+		return failed;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "thread_pool.hpp"
+#include <filesystem>
+#include <ostream>
+
+namespace riscv
+{
+	struct batch_input
+	{
+		std::filesystem::path source;
+		std::filesystem::path output;
+	};
+
+	//Directories are walked for .o and .a files and keep their layout under the output directory,
+	//files named directly are taken whatever they are called. Outputs that would clash get a numeric suffix
+	std::vector<batch_input> collect_inputs(const std::vector<std::filesystem::path>& paths, const std::filesystem::path& output_directory);
+
+	//Lists every input into its own output file, archives get all their members in one. Inputs are spread over
+	//the pool and their functions go back into the same pool. Returns how many inputs failed, the reasons go to errors
+	size_t run_batch(const std::vector<batch_input>& inputs, thread_pool& pool, std::ostream& errors);
+}
\ No newline at end of file
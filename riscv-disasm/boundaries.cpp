@@ -0,0 +1,52 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "boundaries.hpp"
+
+namespace riscv
+{
+	namespace
+	{
+		constexpr size_t lead_in = 64;
+	}
+
+	void scan_chunks(const uint8_t* data, const size_t size, const size_t chunk_size, thread_pool& pool, const std::function<uint64_t(const size_t index, const uint64_t start, const uint64_t end)>& scan)
+	{
+		const size_t chunks = (size + chunk_size - 1) / chunk_size;
+
+		std::vector<uint64_t> starts(chunks);
+		std::vector<uint64_t> ends(chunks);
+
+		auto chunk_end = [&](const size_t index) { return std::min<uint64_t>(static_cast<uint64_t>(index + 1) * chunk_size, size); };
+
+		pool.parallel_for(chunks, [&](const size_t index)
+		{
+			const uint64_t begin = static_cast<uint64_t>(index) * chunk_size;
+
+			starts[index] = index ? walk_lengths(data, begin > lead_in ? begin - lead_in : 0, begin) : 0;
+			ends[index] = scan(index, starts[index], chunk_end(index));
+		});
+
+		//A redone chunk that ends where it did before puts everything after it back in step
+		for (size_t i = 1; i < chunks; i++)
+		{
+			if (starts[i] == ends[i - 1])
+				continue;
+
+			starts[i] = ends[i - 1];
+			ends[i] = scan(i, starts[i], chunk_end(i));
+		}
+	}
+}
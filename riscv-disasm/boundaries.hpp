@@ -0,0 +1,44 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "thread_pool.hpp"
+#include <cstdint>
+#include <functional>
+
+namespace riscv
+{
+	//Length of the instruction starting with this byte, only the low two bits of the first halfword matter
+	inline size_t instruction_length(const uint8_t first)
+	{
+		return (first & 0x3) == 0x3 ? 4 : 2;
+	}
+
+	//Offset decoding ends up at once it passes target, starting from a known start
+	inline uint64_t walk_lengths(const uint8_t* data, uint64_t offset, const uint64_t target)
+	{
+		while (offset < target)
+			offset += instruction_length(data[offset]);
+
+		return offset;
+	}
+
+	//Splits size bytes of code into chunks and hands them to scan(index, start, end) in parallel, scan returns where
+	//its last instruction ended. Only the first chunk's start is known, the others guess theirs by walking lengths from
+	//a short lead in. Mixed 16/32 bit code nearly always falls into step on the way, when it doesn't the chunk gets
+	//scanned again (on this thread) from where the one before it really ended
+	void scan_chunks(const uint8_t* data, const size_t size, const size_t chunk_size, thread_pool& pool, const std::function<uint64_t(const size_t index, const uint64_t start, const uint64_t end)>& scan);
+}
@@ -0,0 +1,298 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "columns.hpp"
+#include "boundaries.hpp"
+#include <stdexcept>
+
+namespace riscv
+{
+	namespace
+	{
+		constexpr size_t chunk_size = 1024 * 1024;
+
+		//Decodes the instructions starting in [from, end), returns where the last one ended. Code keeps using the
+		//same encodings over and over, so rows are cached on the raw bits direct mapped like decode_cache does
+		uint64_t decode_chunk(const image& img, const segment& seg, const uint64_t from, const uint64_t end, decoded_program& out)
+		{
+			struct slot
+			{
+				uint32_t raw;
+				bool valid = false;
+				decoded_program::row described;
+			};
+
+			constexpr uint32_t cache_bits = 12;
+			std::vector<slot> cache(size_t{ 1 } << cache_bits);
+
+			uint64_t offset = from;
+
+			while (offset < end && offset + 2 <= seg.size)
+			{
+				uint32_t raw = seg.data[offset] | (seg.data[offset + 1] << 8);
+				uint32_t length = 2;
+
+				if ((raw & 0x3) == 0x3) {
+					//Cut off in the middle of a 32 bit instruction
+					if (offset + 4 > seg.size)
+						break;
+
+					raw |= (seg.data[offset + 2] << 16) | (static_cast<uint32_t>(seg.data[offset + 3]) << 24);
+					length = 4;
+				}
+
+				slot& entry = cache[static_cast<uint32_t>(raw * 0x9e3779b1u) >> (32 - cache_bits)];
+
+				if (!entry.valid || entry.raw != raw) {
+					entry.raw = raw;
+					entry.valid = true;
+					entry.described = decoded_program::describe(instruction::object{ raw, img.get_architecture() }, img.get_architecture());
+				}
+
+				out.append(entry.described, seg.address + offset);
+				offset += length;
+			}
+
+			return offset;
+		}
+	}
+
+	const operand_fields get_operand_fields(const uint32_t expanded)
+	{
+		const uint8_t rd = (expanded >> 7) & 0x1f;
+		const uint8_t rs1 = (expanded >> 15) & 0x1f;
+		const uint8_t rs2 = (expanded >> 20) & 0x1f;
+
+		switch (expanded & 0x7f)
+		{
+		case 0x37: //U and J
+		case 0x17:
+		case 0x6f:
+			return { rd, 0, 0, 0 };
+
+		case 0x23: //S and B
+		case 0x27:
+		case 0x63:
+			return { 0, rs1, rs2, 0 };
+
+		case 0x43: //R4
+		case 0x47:
+		case 0x4b:
+		case 0x4f:
+			return { rd, rs1, rs2, static_cast<uint8_t>(expanded >> 27) };
+
+		case 0x33: //R
+		case 0x3b:
+		case 0x2f:
+		case 0x53:
+			return { rd, rs1, rs2, 0 };
+
+		default: //I
+			return { rd, rs1, 0, 0 };
+		}
+	}
+
+	decoded_program::decoded_program(const isa arch, const uint64_t base_address) : m_base{ base_address }, m_architecture{ arch }
+	{}
+
+	decoded_program decoded_program::decode(const image& img, const segment& seg, thread_pool& pool)
+	{
+		const size_t chunks = (seg.size + chunk_size - 1) / chunk_size;
+
+		std::vector<decoded_program> parts(chunks, decoded_program{ img.get_architecture(), seg.address });
+
+		scan_chunks(seg.data, seg.size, chunk_size, pool, [&](const size_t index, const uint64_t start, const uint64_t end)
+		{
+			//Scanned again if the start was guessed wrong
+			parts[index] = decoded_program{ img.get_architecture(), seg.address };
+			parts[index].reserve(static_cast<size_t>(end - std::min(start, end)) / 3);
+			return decode_chunk(img, seg, start, end, parts[index]);
+		});
+
+		decoded_program program{ img.get_architecture(), seg.address };
+
+		size_t total = 0;
+		for (auto& part : parts)
+			total += part.size();
+
+		program.reserve(total);
+
+		for (auto& part : parts)
+			program.append(part);
+
+		return program;
+	}
+
+	const decoded_program::row decoded_program::describe(const instruction::object& instruction, const isa arch)
+	{
+		const uint32_t expanded = instruction.get_expanded();
+		const instruction::instruction_entry* entry = expanded ? instruction::find_instruction(instruction.get_raw(), arch) : nullptr;
+
+		return row{ instruction::get_mnemonic_id(entry), entry ? get_operand_fields(expanded) : operand_fields{}, entry ? instruction.get_immediate() : 0,
+			static_cast<uint8_t>(static_cast<uint8_t>(instruction.get_extension()) | (instruction.get_length() == 2 ? compressed_flag : 0)) };
+	}
+
+	void decoded_program::append(const instruction::object& instruction, const uint64_t address)
+	{
+		append(describe(instruction, m_architecture), address);
+	}
+
+	void decoded_program::append(const row& described, const uint64_t address)
+	{
+		if (address < m_base || address - m_base > 0xffffffff)
+			throw std::invalid_argument("decoded_program: address out of range");
+
+		m_offsets.push_back(static_cast<uint32_t>(address - m_base));
+		m_mnemonics.push_back(described.mnemonic);
+		m_rd.push_back(described.fields.rd);
+		m_rs1.push_back(described.fields.rs1);
+		m_rs2.push_back(described.fields.rs2);
+		m_rs3.push_back(described.fields.rs3);
+		m_immediates.push_back(described.immediate);
+		m_flags.push_back(described.flags);
+	}
+
+	void decoded_program::append(const decoded_program& other)
+	{
+		const uint64_t shift = other.m_base - m_base;
+
+		if (other.m_base < m_base || (other.size() && shift + other.m_offsets.back() > 0xffffffff))
+			throw std::invalid_argument("decoded_program: address out of range");
+
+		for (const uint32_t offset : other.m_offsets)
+			m_offsets.push_back(static_cast<uint32_t>(offset + shift));
+
+		m_mnemonics.insert(m_mnemonics.end(), other.m_mnemonics.begin(), other.m_mnemonics.end());
+		m_rd.insert(m_rd.end(), other.m_rd.begin(), other.m_rd.end());
+		m_rs1.insert(m_rs1.end(), other.m_rs1.begin(), other.m_rs1.end());
+		m_rs2.insert(m_rs2.end(), other.m_rs2.begin(), other.m_rs2.end());
+		m_rs3.insert(m_rs3.end(), other.m_rs3.begin(), other.m_rs3.end());
+		m_immediates.insert(m_immediates.end(), other.m_immediates.begin(), other.m_immediates.end());
+		m_flags.insert(m_flags.end(), other.m_flags.begin(), other.m_flags.end());
+	}
+
+	void decoded_program::reserve(const size_t count)
+	{
+		m_offsets.reserve(count);
+		m_mnemonics.reserve(count);
+		m_rd.reserve(count);
+		m_rs1.reserve(count);
+		m_rs2.reserve(count);
+		m_rs3.reserve(count);
+		m_immediates.reserve(count);
+		m_flags.reserve(count);
+	}
+
+	size_t decoded_program::size() const
+	{
+		return m_offsets.size();
+	}
+
+	const isa decoded_program::get_architecture() const
+	{
+		return m_architecture;
+	}
+
+	const uint64_t decoded_program::get_address(const size_t index) const
+	{
+		return m_base + m_offsets[index];
+	}
+
+	const uint8_t decoded_program::get_length(const size_t index) const
+	{
+		return m_flags[index] & compressed_flag ? 2 : 4;
+	}
+
+	const instruction::extensions decoded_program::get_extension(const size_t index) const
+	{
+		return static_cast<instruction::extensions>(m_flags[index] & extension_mask);
+	}
+
+	const std::vector<uint32_t>& decoded_program::get_offsets() const
+	{
+		return m_offsets;
+	}
+
+	const std::vector<uint16_t>& decoded_program::get_mnemonics() const
+	{
+		return m_mnemonics;
+	}
+
+	const std::vector<uint8_t>& decoded_program::get_rd() const
+	{
+		return m_rd;
+	}
+
+	const std::vector<uint8_t>& decoded_program::get_rs1() const
+	{
+		return m_rs1;
+	}
+
+	const std::vector<uint8_t>& decoded_program::get_rs2() const
+	{
+		return m_rs2;
+	}
+
+	const std::vector<uint8_t>& decoded_program::get_rs3() const
+	{
+		return m_rs3;
+	}
+
+	const std::vector<int32_t>& decoded_program::get_immediates() const
+	{
+		return m_immediates;
+	}
+
+	const std::vector<uint8_t>& decoded_program::get_flags() const
+	{
+		return m_flags;
+	}
+
+	std::vector<size_t> decoded_program::find_mnemonic(const uint16_t mnemonic) const
+	{
+		std::vector<size_t> found;
+
+		for (size_t i = 0; i < m_mnemonics.size(); i++)
+		{
+			if (m_mnemonics[i] == mnemonic)
+				found.push_back(i);
+		}
+
+		return found;
+	}
+
+	std::vector<size_t> decoded_program::find_rd(const uint8_t reg) const
+	{
+		std::vector<size_t> found;
+
+		for (size_t i = 0; i < m_rd.size(); i++)
+		{
+			if (m_rd[i] == reg)
+				found.push_back(i);
+		}
+
+		return found;
+	}
+
+	size_t decoded_program::count_extension(const instruction::extensions extension) const
+	{
+		size_t count = 0;
+
+		for (const uint8_t flags : m_flags)
+			count += (flags & extension_mask) == static_cast<uint8_t>(extension);
+
+		return count;
+	}
+}
\ No newline at end of file
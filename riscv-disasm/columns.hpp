@@ -0,0 +1,102 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "image.hpp"
+#include "thread_pool.hpp"
+
+namespace riscv
+{
+	//Register fields of an expanded encoding the way decoded_program stores them, 0 for fields the format doesn't have
+	struct operand_fields
+	{
+		uint8_t rd;
+		uint8_t rs1;
+		uint8_t rs2;
+		uint8_t rs3;
+	};
+
+	const operand_fields get_operand_fields(const uint32_t expanded);
+
+	//Decoded code stored by column instead of as instruction::object + address (24 bytes): a 32 bit offset from
+	//the base, a mnemonic id, the four register fields, the immediate and one byte for the extension and whether
+	//it's compressed, 15 bytes per instruction. Register fields and immediate come from the expanded encoding,
+	//fields the format doesn't have are 0. Scans over one column only touch that column
+	class decoded_program
+	{
+		uint64_t m_base;
+		isa m_architecture;
+
+		std::vector<uint32_t> m_offsets;
+		std::vector<uint16_t> m_mnemonics;
+		std::vector<uint8_t> m_rd;
+		std::vector<uint8_t> m_rs1;
+		std::vector<uint8_t> m_rs2;
+		std::vector<uint8_t> m_rs3;
+		std::vector<int32_t> m_immediates;
+		std::vector<uint8_t> m_flags;
+
+		static constexpr uint8_t compressed_flag = 0x10;
+		static constexpr uint8_t extension_mask = 0x0f;
+
+	public:
+		decoded_program() = delete;
+
+		decoded_program(const isa arch, const uint64_t base_address);
+
+		//Linear decode of a whole segment, split over the pool. Chunks resync with a short lead in and any chunk
+		//that didn't start where the one before it ended gets redone from there, so the result is exact
+		static decoded_program decode(const image& img, const segment& seg, thread_pool& pool);
+
+		//Everything but the offset, the same for every instruction with the same raw bits
+		struct row
+		{
+			uint16_t mnemonic;
+			operand_fields fields;
+			int32_t immediate;
+			uint8_t flags;
+		};
+
+		static const row describe(const instruction::object& instruction, const isa arch);
+
+		//Throws std::invalid_argument for addresses more than 4 GiB past the base
+		void append(const instruction::object& instruction, const uint64_t address);
+		void append(const row& described, const uint64_t address);
+		void append(const decoded_program& other);
+		void reserve(const size_t count);
+
+		size_t size() const;
+		const isa get_architecture() const;
+
+		const uint64_t get_address(const size_t index) const;
+		const uint8_t get_length(const size_t index) const;
+		const instruction::extensions get_extension(const size_t index) const;
+
+		const std::vector<uint32_t>& get_offsets() const;
+		const std::vector<uint16_t>& get_mnemonics() const;
+		const std::vector<uint8_t>& get_rd() const;
+		const std::vector<uint8_t>& get_rs1() const;
+		const std::vector<uint8_t>& get_rs2() const;
+		const std::vector<uint8_t>& get_rs3() const;
+		const std::vector<int32_t>& get_immediates() const;
+		const std::vector<uint8_t>& get_flags() const;
+
+		//Column scans, indices in address order. find_rd matches the rd field, x or f register depending on the mnemonic
+		std::vector<size_t> find_mnemonic(const uint16_t mnemonic) const;
+		std::vector<size_t> find_rd(const uint8_t reg) const;
+		size_t count_extension(const instruction::extensions extension) const;
+	};
+}
\ No newline at end of file
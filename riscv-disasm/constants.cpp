@@ -0,0 +1,179 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "constants.hpp"
+#include "analysis.hpp"
+
+namespace riscv
+{
+	namespace analysis
+	{
+		namespace
+		{
+			constexpr uint64_t sign_extend_word(const uint64_t value)
+			{
+				return static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(value)));
+			}
+		}
+
+		void constant_tracker::set(const uint32_t reg, const uint64_t value)
+		{
+			if (reg == 0)
+				return;
+
+			m_values[reg] = m_rv32 ? static_cast<uint32_t>(value) : value;
+			m_known |= 1u << reg;
+		}
+
+		void constant_tracker::kill(const uint64_t x_regs)
+		{
+			m_known &= ~static_cast<uint32_t>(x_regs) | 1u;
+		}
+
+		std::optional<uint64_t> constant_tracker::step(const instruction::object& instruction, const uint64_t pc)
+		{
+			const uint32_t expanded = instruction.get_expanded();
+
+			const uint32_t opcode = expanded & 0x7f;
+			const uint32_t rd = (expanded >> 7) & 0x1f;
+			const uint32_t funct3 = (expanded >> 12) & 0x7;
+			const uint32_t rs1 = (expanded >> 15) & 0x1f;
+			const uint32_t rs2 = (expanded >> 20) & 0x1f;
+			const int64_t imm = instruction.get_immediate();
+
+			const bool base_known = rs1 != 0 && known(rs1);
+			const uint64_t base = value(rs1);
+
+			switch (opcode)
+			{
+			case 0x17: //AUIPC
+				set(rd, pc + imm);
+				return value(rd);
+
+			case 0x37: //LUI
+				set(rd, imm);
+				return std::nullopt;
+
+			case 0x13:
+				if (!known(rs1))
+					break;
+
+				if (funct3 == 0) {
+					set(rd, base + imm);
+
+					if (base_known)
+						return value(rd);
+
+					return std::nullopt;
+				}
+
+				if (funct3 == 1 || funct3 == 5) {
+					const uint32_t shamt = (expanded >> 20) & (m_rv32 ? 0x1f : 0x3f);
+
+					if (funct3 == 1)
+						set(rd, base << shamt);
+					else if (expanded & 0x40000000)
+						set(rd, m_rv32 ? static_cast<uint64_t>(static_cast<int32_t>(base) >> shamt) : static_cast<uint64_t>(static_cast<int64_t>(base) >> shamt));
+					else
+						set(rd, m_rv32 ? static_cast<uint32_t>(base) >> shamt : base >> shamt);
+
+					return std::nullopt;
+				}
+				break;
+
+			case 0x1b: { //ADDIW and the 32 bit shifts
+				if (!known(rs1))
+					break;
+
+				const uint32_t shamt = (expanded >> 20) & 0x1f;
+
+				if (funct3 == 0)
+					set(rd, sign_extend_word(base + imm));
+				else if (funct3 == 1)
+					set(rd, sign_extend_word(static_cast<uint32_t>(base) << shamt));
+				else if (expanded & 0x40000000)
+					set(rd, sign_extend_word(static_cast<int32_t>(base) >> shamt));
+				else
+					set(rd, sign_extend_word(static_cast<uint32_t>(base) >> shamt));
+
+				return std::nullopt;
+			}
+
+			case 0x33: //ADD, C.MV and C.ADD end up here
+				if ((expanded >> 25) != 0 || funct3 != 0 || !known(rs1) || !known(rs2))
+					break;
+
+				set(rd, base + value(rs2));
+				return std::nullopt;
+
+			case 0x67: { //JALR
+				std::optional<uint64_t> target;
+
+				if (base_known)
+					target = (base + imm) & ~1ull;
+
+				if (rd != 0)
+					kill(abi::caller_saved);
+
+				return target;
+			}
+
+			case 0x6f: //JAL
+				if (rd != 0)
+					kill(abi::caller_saved);
+
+				return std::nullopt;
+
+			case 0x03:
+			case 0x07:
+			case 0x23:
+			case 0x27: {
+				std::optional<uint64_t> address;
+
+				if (base_known)
+					address = m_rv32 ? static_cast<uint32_t>(base + imm) : base + imm;
+
+				kill(instruction.get_register_usage().def);
+				return address;
+			}
+
+			default:
+				break;
+			}
+
+			kill(instruction.get_register_usage().def);
+			return std::nullopt;
+		}
+
+		const std::vector<resolved_value> propagate_constants(const std::vector<instruction::object>& instructions, const std::vector<uint64_t>& addresses, const isa arch)
+		{
+			std::vector<resolved_value> resolved;
+			const std::vector<bool> leaders = find_leaders(instructions, addresses, function_range{ 0, instructions.size() });
+
+			constant_tracker state{ arch };
+
+			for (size_t i = 0; i < instructions.size(); i++)
+			{
+				if (leaders[i])
+					state.reset();
+
+				if (auto value = state.step(instructions[i], addresses[i]))
+					resolved.push_back({ i, *value });
+			}
+
+			return resolved;
+		}
+	}
+}
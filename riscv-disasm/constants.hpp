@@ -0,0 +1,70 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "instructions.hpp"
+#include <optional>
+
+namespace riscv
+{
+	namespace analysis
+	{
+		//Absolute value an instruction works out to: the result of AUIPC/ADDI pairs, the target of a JALR,
+		//or the effective address of a load or store whose base register is known
+		struct resolved_value
+		{
+			size_t index;
+			uint64_t value;
+		};
+
+		//Known integer register values at one point in a straight line of code
+		class constant_tracker
+		{
+			std::array<uint64_t, 32> m_values{};
+			uint32_t m_known = 1;
+			const bool m_rv32;
+
+			void set(const uint32_t reg, const uint64_t value);
+			void kill(const uint64_t x_regs);
+
+		public:
+			explicit constant_tracker(const isa arch) : m_rv32{ arch == isa::RV32 }
+			{}
+
+			bool known(const uint32_t reg) const
+			{
+				return (m_known >> reg) & 1;
+			}
+
+			uint64_t value(const uint32_t reg) const
+			{
+				return m_values[reg];
+			}
+
+			void reset()
+			{
+				m_known = 1;
+			}
+
+			//Applies one instruction, returns the absolute value it works out to if there is one worth showing
+			std::optional<uint64_t> step(const instruction::object& instruction, const uint64_t pc);
+		};
+
+		//Tracks pc and known integer register values through AUIPC, LUI, ADDI(W), shifts, moves and the compressed forms of those,
+		//starting from scratch at every block boundary. The result is sorted by index.
+		const std::vector<resolved_value> propagate_constants(const std::vector<instruction::object>& instructions, const std::vector<uint64_t>& addresses, const isa arch);
+	}
+}
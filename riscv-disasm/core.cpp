@@ -0,0 +1,353 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "core.hpp"
+#include "elf.hpp"
+#include "trace.hpp"
+#include "view.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace riscv
+{
+	namespace core
+	{
+		namespace
+		{
+			enum : uint32_t
+			{
+				et_exec = 2,
+				et_dyn = 3,
+				et_core = 4,
+
+				pt_load = 1,
+				pt_note = 4,
+				pf_x = 0x1,
+				pf_w = 0x2,
+
+				nt_prstatus = 1,
+				nt_file = 0x46494c45
+			};
+
+			//Bounds checked little endian reads over a mapped file, ELF32 fields are widened
+			class reader
+			{
+				const uint8_t* m_data;
+				size_t m_size;
+				bool m_64;
+
+			public:
+				reader(const uint8_t* data, const size_t size) : m_data{ data }, m_size{ size }, m_64{ size > 4 && data[4] == 2 }
+				{}
+
+				template<typename T>
+				T get(const uint64_t offset) const
+				{
+					if (offset > m_size || m_size - offset < sizeof(T))
+						throw std::runtime_error("core: read past the end of the file");
+
+					T value;
+					std::memcpy(&value, m_data + offset, sizeof(T));
+					return value;
+				}
+
+				uint64_t word(const uint64_t offset) const
+				{
+					return m_64 ? get<uint64_t>(offset) : get<uint32_t>(offset);
+				}
+
+				bool is_64() const
+				{
+					return m_64;
+				}
+
+				size_t word_size() const
+				{
+					return m_64 ? 8 : 4;
+				}
+			};
+
+			struct program_header
+			{
+				uint32_t type;
+				uint32_t flags;
+				uint64_t offset;
+				uint64_t address;
+				uint64_t file_size;
+			};
+
+			std::vector<program_header> program_headers(const reader& elf)
+			{
+				const uint64_t table = elf.word(elf.is_64() ? 0x20 : 0x1c);
+				const uint16_t entry_size = elf.get<uint16_t>(elf.is_64() ? 0x36 : 0x2a);
+				const uint16_t count = elf.get<uint16_t>(elf.is_64() ? 0x38 : 0x2c);
+
+				std::vector<program_header> headers;
+
+				for (uint16_t i = 0; table && i < count; i++)
+				{
+					const uint64_t at = table + static_cast<uint64_t>(i) * entry_size;
+
+					if (elf.is_64())
+						headers.push_back({ elf.get<uint32_t>(at), elf.get<uint32_t>(at + 4), elf.get<uint64_t>(at + 8), elf.get<uint64_t>(at + 16), elf.get<uint64_t>(at + 32) });
+					else
+						headers.push_back({ elf.get<uint32_t>(at), elf.get<uint32_t>(at + 24), elf.get<uint32_t>(at + 4), elf.get<uint32_t>(at + 8), elf.get<uint32_t>(at + 16) });
+				}
+
+				return headers;
+			}
+
+			void check_header(const uint8_t* data, const size_t size, const char* what)
+			{
+				if (size < 0x34 || std::memcmp(data, "\x7f" "ELF", 4) != 0)
+					throw std::runtime_error(std::string{ what } + ": not an ELF file");
+
+				if (data[5] != 1)
+					throw std::runtime_error(std::string{ what } + ": only little endian files are supported");
+
+				const reader elf{ data, size };
+
+				if (elf.get<uint16_t>(0x12) != elf::machine_riscv)
+					throw std::runtime_error(std::string{ what } + ": not a RISC-V file");
+			}
+
+			//struct elf_prstatus, pr_reg is the kernel's user_regs_struct
+			thread_state read_prstatus(const reader& elf, const uint64_t at, const uint64_t size)
+			{
+				const uint64_t registers = elf.is_64() ? 112 : 72;
+				const uint64_t pid = elf.is_64() ? 32 : 24;
+
+				if (size < registers + 32 * elf.word_size())
+					throw std::runtime_error("core: NT_PRSTATUS note too small");
+
+				thread_state thread{ elf.get<uint32_t>(at + pid), elf.get<uint16_t>(at + 12), {} };
+
+				for (size_t i = 0; i < thread.registers.size(); i++)
+					thread.registers[i] = elf.word(at + registers + i * elf.word_size());
+
+				return thread;
+			}
+
+			//count and page size, count start/end/page offset triples, then count file names
+			void read_file_note(const reader& elf, const uint64_t at, const uint64_t size, std::vector<file_range>& files)
+			{
+				const uint64_t word = elf.word_size();
+				const uint64_t count = elf.word(at);
+				const uint64_t page_size = elf.word(at + word);
+
+				if (count > size / (3 * word))
+					throw std::runtime_error("core: bad NT_FILE note");
+
+				uint64_t names = at + 2 * word + count * 3 * word;
+				const uint64_t end = at + size;
+
+				for (uint64_t i = 0; i < count; i++)
+				{
+					const uint64_t triple = at + 2 * word + i * 3 * word;
+					file_range range{ elf.word(triple), elf.word(triple + word), elf.word(triple + 2 * word) * page_size, {} };
+
+					while (names < end)
+					{
+						const char character = static_cast<char>(elf.get<uint8_t>(names++));
+
+						if (!character)
+							break;
+
+						range.path += character;
+					}
+
+					files.push_back(std::move(range));
+				}
+			}
+
+			void read_notes(const reader& elf, uint64_t at, const uint64_t end, dump& core)
+			{
+				while (at + 12 <= end)
+				{
+					const uint32_t name_size = elf.get<uint32_t>(at);
+					const uint32_t description_size = elf.get<uint32_t>(at + 4);
+					const uint32_t type = elf.get<uint32_t>(at + 8);
+
+					const uint64_t description = at + 12 + ((name_size + 3ull) & ~3ull);
+					const uint64_t next = description + ((description_size + 3ull) & ~3ull);
+
+					if (next > end)
+						throw std::runtime_error("core: note runs past its segment");
+
+					//Only the kernel's own notes, everything else (LINUX notes with FP state etc.) is skipped
+					if (name_size == 5 && elf.get<uint32_t>(at + 12) == 0x45524f43) {
+						if (type == nt_prstatus)
+							core.threads.push_back(read_prstatus(elf, description, description_size));
+						else if (type == nt_file)
+							read_file_note(elf, description, description_size, core.files);
+					}
+
+					at = next;
+				}
+			}
+
+			void print_window(std::ostream& out, const dump& core, const char* label, const uint64_t address, const size_t before, const size_t after)
+			{
+				out << label << " 0x" << std::hex << address << " <" << describe(core, address) << ">\n";
+
+				const segment* seg = core.memory.find_segment(address);
+
+				if (!seg) {
+					out << "  not in the dump\n";
+					return;
+				}
+
+				code_view view{ core.memory, *seg, 4 };
+				view.print(out, address, before, after + 1);
+			}
+		}
+
+		bool is_core(const uint8_t* data, const size_t size)
+		{
+			return size >= 0x34 && std::memcmp(data, "\x7f" "ELF", 4) == 0 && data[5] == 1 && (data[0x10] | (data[0x11] << 8)) == et_core;
+		}
+
+		dump load(const std::string& path)
+		{
+			auto mapping = std::make_shared<file_mapping>(path);
+			check_header(mapping->data(), mapping->size(), "core");
+
+			if (!is_core(mapping->data(), mapping->size()))
+				throw std::runtime_error("core: not a core file");
+
+			const reader elf{ mapping->data(), mapping->size() };
+			dump core{ image{ elf.is_64() ? isa::RV64 : isa::RV32 }, {}, {} };
+
+			for (auto& header : program_headers(elf))
+			{
+				if (header.offset > mapping->size() || mapping->size() - header.offset < header.file_size)
+					throw std::runtime_error("core: segment extends past the end of the file");
+
+				if (header.type == pt_note) {
+					read_notes(elf, header.offset, header.offset + header.file_size, core);
+					continue;
+				}
+
+				//Pages the kernel left out (file backed code, mostly) have no file size
+				if (header.type != pt_load || !header.file_size)
+					continue;
+
+				core.memory.add_segment(segment{ header.address, mapping->data() + header.offset, static_cast<size_t>(header.file_size), (header.flags & pf_x) != 0, (header.flags & pf_w) != 0, "core" });
+			}
+
+			core.memory.add_storage(std::move(mapping));
+			return core;
+		}
+
+		uint64_t add_executable(dump& core, const std::string& path)
+		{
+			uint64_t bias = 0;
+
+			{
+				const file_mapping mapping{ path };
+				check_header(mapping.data(), mapping.size(), path.c_str());
+
+				const reader elf{ mapping.data(), mapping.size() };
+
+				if (elf.get<uint16_t>(0x10) == et_dyn) {
+					const auto headers = program_headers(elf);
+					auto first = std::find_if(headers.begin(), headers.end(), [](const program_header& header) { return header.type == pt_load; });
+
+					const std::string name = std::filesystem::path{ path }.filename().string();
+					auto mapped = std::find_if(core.files.begin(), core.files.end(), [&name](const file_range& range)
+					{
+						return range.offset == 0 && std::filesystem::path{ range.path }.filename().string() == name;
+					});
+
+					if (first == headers.end() || mapped == core.files.end())
+						throw std::runtime_error(path + " isn't mapped in the core");
+
+					bias = mapped->begin - (first->address - first->offset);
+				} else if (elf.get<uint16_t>(0x10) != et_exec) {
+					throw std::runtime_error(path + " isn't an executable");
+				}
+			}
+
+			auto executable = std::make_shared<image>(elf::load(path));
+
+			for (auto& seg : executable->get_segments())
+				core.memory.add_segment(segment{ seg.address + bias, seg.data, seg.size, seg.executable, seg.writable, seg.name });
+
+			for (auto& sym : executable->get_symbols())
+				core.memory.add_symbol(symbol{ sym.address + bias, sym.size, sym.name, sym.function });
+
+			core.memory.add_storage(std::move(executable));
+			return bias;
+		}
+
+		std::string describe(const dump& core, const uint64_t address)
+		{
+			auto& symbols = core.memory.get_symbols();
+			auto after = std::upper_bound(symbols.begin(), symbols.end(), address, [](const uint64_t addr, const symbol& sym) { return addr < sym.address; });
+
+			//Sized symbols have to cover it, unsized ones (assembly labels) only have to be in the same segment
+			for (auto sym = after; sym != symbols.begin();)
+			{
+				--sym;
+
+				if (sym->name.empty())
+					continue;
+
+				const bool covers = sym->size ? address - sym->address < sym->size : core.memory.find_segment(sym->address) == core.memory.find_segment(address);
+
+				if (!covers)
+					break;
+
+				std::string text{ sym->name };
+
+				if (address != sym->address) {
+					text += "+";
+					append_hex(text, address - sym->address);
+				}
+
+				return text;
+			}
+
+			for (auto& range : core.files)
+			{
+				if (address >= range.begin && address < range.end) {
+					std::string text = std::filesystem::path{ range.path }.filename().string() + "+";
+					append_hex(text, address - range.begin + range.offset);
+					return text;
+				}
+			}
+
+			std::string text;
+			append_hex(text, address);
+			return text;
+		}
+
+		void print_threads(std::ostream& out, const dump& core, const size_t before, const size_t after)
+		{
+			for (auto& thread : core.threads)
+			{
+				out << "thread " << std::dec << thread.pid << " signal " << thread.signal << "\n";
+
+				print_window(out, core, "pc", thread.pc(), before, after);
+
+				//The call is the instruction right before the return address
+				print_window(out, core, "ra", thread.ra(), before, after);
+				out << "\n";
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "image.hpp"
+#include <array>
+#include <ostream>
+
+namespace riscv
+{
+	namespace core
+	{
+		//One thread from an NT_PRSTATUS note
+		struct thread_state
+		{
+			uint32_t pid;
+			uint16_t signal;
+
+			//In the kernel's order, the pc sits where x0 would be and x1-x31 follow
+			std::array<uint64_t, 32> registers;
+
+			uint64_t pc() const { return registers[0]; }
+			uint64_t ra() const { return registers[1]; }
+			uint64_t sp() const { return registers[2]; }
+		};
+
+		//A file the process had mapped, from the NT_FILE note
+		struct file_range
+		{
+			uint64_t begin;
+			uint64_t end;
+			uint64_t offset;
+			std::string path;
+		};
+
+		struct dump
+		{
+			image memory;
+			std::vector<thread_state> threads;
+			std::vector<file_range> files;
+		};
+
+		bool is_core(const uint8_t* data, const size_t size);
+
+		//Throws std::runtime_error for anything but a little endian RISC-V ELF core. The file is memory mapped and
+		//the dumped memory is used in place, pages nobody looks at are never read
+		dump load(const std::string& path);
+
+		//Code pages usually aren't dumped, this puts the executable's sections and symbols where the process had it
+		//mapped (position independent ones are found in NT_FILE by file name). Returns the load bias
+		uint64_t add_executable(dump& core, const std::string& path);
+
+		//Closest symbol at or before address as name+0xoffset, the mapped file and offset in it when no symbol
+		//covers it, the plain address otherwise
+		std::string describe(const dump& core, const uint64_t address);
+
+		//Every thread with before/after instructions around its pc and its return address
+		void print_threads(std::ostream& out, const dump& core, const size_t before, const size_t after);
+	}
+}
\ No newline at end of file
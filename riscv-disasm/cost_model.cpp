@@ -0,0 +1,342 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "cost_model.hpp"
+#include "analysis.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace riscv
+{
+	namespace analysis
+	{
+		namespace
+		{
+			//First cycle at or after from where the port stays free for length cycles
+			uint64_t free_slot(const std::vector<bool>& busy, uint64_t from, const uint32_t length)
+			{
+				for (;;)
+				{
+					uint32_t run = 0;
+
+					while (run < length && (from + run >= busy.size() || !busy[from + run]))
+						run++;
+
+					if (run == length)
+						return from;
+
+					from += run + 1;
+				}
+			}
+		}
+
+		cost_model::cost_model(const std::string& path)
+		{
+			std::ifstream file{ path };
+
+			if (!file)
+				throw std::runtime_error("cost model: can't open " + path);
+
+			std::string line;
+			size_t line_number = 0;
+
+			while (std::getline(file, line))
+			{
+				line_number++;
+				line = line.substr(0, line.find('#'));
+
+				std::istringstream fields{ line };
+				std::string name;
+
+				if (!(fields >> name))
+					continue;
+
+				auto malformed = [&]
+				{
+					return std::runtime_error("cost model: " + path + ":" + std::to_string(line_number) + ": malformed line");
+				};
+
+				if (name == "issue_width") {
+					if (!(fields >> m_issue_width) || !m_issue_width)
+						throw malformed();
+
+					continue;
+				}
+
+				if (name == "in_order" || name == "out_of_order") {
+					m_in_order = name == "in_order";
+					continue;
+				}
+
+				if (name == "ports") {
+					std::string port;
+
+					while (fields >> port)
+						m_ports.push_back(port);
+
+					continue;
+				}
+
+				instruction_cost cost{};
+				std::string ports;
+
+				if (!(fields >> cost.latency >> cost.inverse_throughput))
+					throw malformed();
+
+				if (fields >> ports) {
+					std::istringstream port_names{ ports };
+					std::string port;
+
+					while (std::getline(port_names, port, ','))
+					{
+						auto found = std::find(m_ports.begin(), m_ports.end(), port);
+
+						if (found == m_ports.end())
+							throw malformed();
+
+						cost.ports.push_back(static_cast<uint32_t>(found - m_ports.begin()));
+					}
+				}
+
+				std::transform(name.begin(), name.end(), name.begin(), [](const char c) { return static_cast<char>(std::toupper(static_cast<unsigned char>(c))); });
+
+				if (name == "DEFAULT")
+					m_default = cost;
+				else if (name.back() == '*')
+					m_prefixes.emplace_back(name.substr(0, name.size() - 1), cost);
+				else
+					m_costs[name] = cost;
+			}
+
+			std::stable_sort(m_prefixes.begin(), m_prefixes.end(), [](const auto& a, const auto& b) { return a.first.size() > b.first.size(); });
+		}
+
+		const instruction_cost& cost_model::lookup(const instruction::object& instruction, const isa arch) const
+		{
+			const instruction::instruction_entry* entry = instruction::find_instruction(instruction.get_expanded(), arch);
+
+			if (!entry)
+				return m_default;
+
+			const std::string_view mnemonic = std::get<2>(*entry);
+
+			if (auto found = m_costs.find(std::string{ mnemonic }); found != m_costs.end())
+				return found->second;
+
+			for (auto& [prefix, cost] : m_prefixes)
+			{
+				if (mnemonic.compare(0, prefix.size(), prefix) == 0)
+					return cost;
+			}
+
+			return m_default;
+		}
+
+		block_cost cost_model::analyze(const std::vector<instruction::object>& instructions, const size_t begin, const size_t end, const bool loop, const isa arch) const
+		{
+			block_cost result{ 0.0, 0, {}, std::vector<double>(m_ports.size(), 0.0) };
+
+			if (begin >= end)
+				return result;
+
+			std::vector<const instruction_cost*> costs;
+			std::vector<instruction::register_usage> usage;
+
+			for (size_t i = begin; i < end; i++)
+			{
+				costs.push_back(&lookup(instructions[i], arch));
+				usage.push_back(instructions[i].get_register_usage());
+
+				for (const uint32_t port : costs.back()->ports)
+					result.port_pressure[port] += static_cast<double>(costs.back()->inverse_throughput) / costs.back()->ports.size();
+			}
+
+			const size_t count = costs.size();
+
+			//Critical path: longest latency chain through the register dependencies of one pass
+			{
+				std::vector<uint64_t> finish(count, 0);
+				std::vector<size_t> previous(count, SIZE_MAX);
+				std::array<size_t, 64> writer;
+				writer.fill(SIZE_MAX);
+
+				size_t last = 0;
+
+				for (size_t i = 0; i < count; i++)
+				{
+					uint64_t start = 0;
+
+					for (uint64_t sources = usage[i].use; sources; sources &= sources - 1)
+					{
+						const size_t producer = writer[std::countr_zero(sources)];
+
+						if (producer != SIZE_MAX && finish[producer] > start) {
+							start = finish[producer];
+							previous[i] = producer;
+						}
+					}
+
+					finish[i] = start + costs[i]->latency;
+
+					for (uint64_t defs = usage[i].def; defs; defs &= defs - 1)
+						writer[std::countr_zero(defs)] = i;
+
+					if (finish[i] > finish[last])
+						last = i;
+				}
+
+				result.critical_path_cycles = static_cast<uint32_t>(finish[last]);
+
+				for (size_t i = last; i != SIZE_MAX; i = previous[i])
+					result.critical_path.push_back(begin + i);
+
+				std::reverse(result.critical_path.begin(), result.critical_path.end());
+			}
+
+			//Schedule: instructions go out in order at most issue_width a cycle, start once their operands
+			//are ready and a port is free, and in order cores also never start before the previous one did.
+			//There is no limit on how far ahead an out of order core gets, the window is assumed to be big enough
+			const size_t iterations = loop ? loop_iterations : 1;
+
+			std::array<uint64_t, 64> ready{};
+			//Cycle by cycle occupancy, so something that becomes ready early can still use a port that later work already has booked
+			std::vector<std::vector<bool>> port_busy(m_ports.size());
+			std::vector<uint64_t> iteration_end(iterations, 0);
+
+			uint64_t dispatch_cycle = 0;
+			uint32_t dispatched = 0;
+			uint64_t last_start = 0;
+
+			for (size_t iteration = 0; iteration < iterations; iteration++)
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					uint64_t start = dispatch_cycle;
+
+					for (uint64_t sources = usage[i].use; sources; sources &= sources - 1)
+						start = std::max(start, ready[std::countr_zero(sources)]);
+
+					if (m_in_order)
+						start = std::max(start, last_start);
+
+					if (!costs[i]->ports.empty()) {
+						const uint32_t busy_for = std::max<uint32_t>(1, costs[i]->inverse_throughput);
+						uint32_t port = costs[i]->ports.front();
+						uint64_t earliest = UINT64_MAX;
+
+						for (const uint32_t candidate : costs[i]->ports)
+						{
+							const uint64_t slot = free_slot(port_busy[candidate], start, busy_for);
+
+							if (slot < earliest) {
+								earliest = slot;
+								port = candidate;
+							}
+						}
+
+						start = earliest;
+
+						auto& busy = port_busy[port];
+						if (busy.size() < start + busy_for)
+							busy.resize(start + busy_for, false);
+
+						std::fill(busy.begin() + start, busy.begin() + start + busy_for, true);
+					}
+
+					const uint64_t finish = start + costs[i]->latency;
+
+					for (uint64_t defs = usage[i].def; defs; defs &= defs - 1)
+						ready[std::countr_zero(defs)] = finish;
+
+					iteration_end[iteration] = std::max(iteration_end[iteration], finish);
+					last_start = start;
+
+					//A stalled in order pipeline doesn't issue anything behind the stalled instruction either
+					if (m_in_order && start > dispatch_cycle) {
+						dispatch_cycle = start;
+						dispatched = 0;
+					}
+
+					if (++dispatched == m_issue_width) {
+						dispatched = 0;
+						dispatch_cycle++;
+					}
+				}
+			}
+
+			if (iterations == 1)
+				result.cycles_per_iteration = static_cast<double>(iteration_end[0]);
+			else
+				result.cycles_per_iteration = static_cast<double>(iteration_end.back() - iteration_end.front()) / (iterations - 1);
+
+			return result;
+		}
+
+		const std::vector<std::string>& cost_model::get_ports() const
+		{
+			return m_ports;
+		}
+
+		void print_block_costs(std::ostream& out, const cost_model& model, const disassembler& code)
+		{
+			auto& instructions = code.get_decoded();
+			auto& addresses = code.get_addresses();
+			const auto leaders = find_leaders(instructions, addresses, function_range{ 0, instructions.size() });
+
+			for (size_t begin = 0; begin < instructions.size();)
+			{
+				size_t end = begin + 1;
+				while (end < instructions.size() && !leaders[end])
+					end++;
+
+				auto flow = classify(instructions[end - 1], addresses[end - 1]);
+
+				if (code.get_architecture() == isa::RV32)
+					flow.target &= 0xffffffff;
+
+				const bool loop = (flow.kind == flow_kind::branch || flow.kind == flow_kind::jump) && flow.target == addresses[begin];
+				const block_cost cost = model.analyze(instructions, begin, end, loop, code.get_architecture());
+
+				out << "; block 0x" << std::hex << addresses[begin] << ": " << std::fixed << std::setprecision(2) << cost.cycles_per_iteration
+					<< (loop ? " cycles/iteration" : " cycles") << ", critical path " << std::dec << cost.critical_path_cycles << " cycles";
+
+				for (size_t port = 0; port < cost.port_pressure.size(); port++)
+				{
+					if (cost.port_pressure[port] > 0.0)
+						out << ", " << model.get_ports()[port] << " " << cost.port_pressure[port];
+				}
+
+				out << "\n";
+
+				for (size_t i = begin; i < end; i++)
+				{
+					const bool critical = std::find(cost.critical_path.begin(), cost.critical_path.end(), i) != cost.critical_path.end();
+
+					out << (critical ? "* " : "  ") << "0x" << std::hex << addresses[i] << ": ";
+					code.format(out, instructions[i], addresses[i]);
+					out << "\n";
+				}
+
+				begin = end;
+			}
+		}
+	}
+}
\ No newline at end of file
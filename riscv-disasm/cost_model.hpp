@@ -0,0 +1,83 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "disassembler.hpp"
+#include <unordered_map>
+
+namespace riscv
+{
+	namespace analysis
+	{
+		struct instruction_cost
+		{
+			uint32_t latency;
+			uint32_t inverse_throughput;
+			//Indices into the model's ports, any one of them can take the instruction
+			std::vector<uint32_t> ports;
+		};
+
+		struct block_cost
+		{
+			//Steady state for loop bodies, a single pass through the block otherwise
+			double cycles_per_iteration;
+
+			//Longest register dependency chain through one iteration, instruction indices in order
+			uint32_t critical_path_cycles;
+			std::vector<size_t> critical_path;
+
+			//Busy cycles per iteration on every port, split evenly when an instruction can use several
+			std::vector<double> port_pressure;
+		};
+
+		//Per mnemonic latency/throughput table for one core, from a text file like:
+		//	issue_width 2
+		//	out_of_order
+		//	ports ALU0 ALU1 MEM FPU
+		//	default 1 1 ALU0,ALU1
+		//	LD 3 1 MEM
+		//	FDIV* 20 20 FPU
+		//Mnemonics ending in * match by prefix, the longest one wins. Compressed instructions cost what their expansion does
+		class cost_model
+		{
+			std::vector<std::string> m_ports;
+			std::unordered_map<std::string, instruction_cost> m_costs;
+			std::vector<std::pair<std::string, instruction_cost>> m_prefixes;
+			instruction_cost m_default{ 1, 1, {} };
+			uint32_t m_issue_width = 1;
+			bool m_in_order = true;
+
+			static constexpr size_t loop_iterations = 100;
+
+		public:
+			cost_model() = delete;
+
+			//Throws std::runtime_error when the file can't be read or has a malformed line
+			explicit cost_model(const std::string& path);
+
+			const instruction_cost& lookup(const instruction::object& instruction, const isa arch) const;
+
+			//instructions[begin, end) as a straight line, run repeatedly when loop is set
+			block_cost analyze(const std::vector<instruction::object>& instructions, const size_t begin, const size_t end, const bool loop, const isa arch) const;
+
+			const std::vector<std::string>& get_ports() const;
+		};
+
+		//Listing of the disassembled code with every basic block headed by its estimate.
+		//Blocks ending in a branch back to their own start are treated as loop bodies
+		void print_block_costs(std::ostream& out, const cost_model& model, const disassembler& code);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,375 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "diff.hpp"
+#include "analysis.hpp"
+#include "constants.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+
+namespace riscv
+{
+	namespace analysis
+	{
+		namespace
+		{
+			constexpr size_t no_partner = SIZE_MAX;
+			constexpr size_t column_width = 56;
+
+			//Anything bigger gets compared as multisets of block hashes instead of aligned
+			constexpr size_t max_alignment_cells = 4 * 1024 * 1024;
+
+			uint64_t fnv1a(uint64_t hash, const uint64_t value)
+			{
+				for (int i = 0; i < 8; i++)
+				{
+					hash ^= (value >> (i * 8)) & 0xff;
+					hash *= 0x100000001b3ull;
+				}
+
+				return hash;
+			}
+
+			constexpr uint64_t fnv_basis = 0xcbf29ce484222325ull;
+
+			uint32_t normalize(const instruction::object& instruction, const bool resolved)
+			{
+				const uint32_t expanded = instruction.get_expanded();
+
+				switch (expanded & 0x7f)
+				{
+				case 0x63: //Branch offset
+					return expanded & 0x01fff07f;
+
+				case 0x6f: //JAL offset
+				case 0x17: //AUIPC
+				case 0x37: //LUI
+					return expanded & 0xfff;
+
+				case 0x13:
+				case 0x1b:
+				case 0x03:
+				case 0x07:
+				case 0x67:
+					return resolved ? expanded & 0x000fffff : expanded;
+
+				case 0x23:
+				case 0x27:
+					return resolved ? expanded & 0x01fff07f : expanded;
+
+				default:
+					return instruction.get_raw() && !expanded ? instruction.get_raw() : expanded;
+				}
+			}
+
+			bool generated_name(const std::string& name)
+			{
+				return name.rfind("sub_", 0) == 0;
+			}
+
+			//Longest common subsequence of block hashes, pairs of indices that line up
+			std::vector<std::pair<size_t, size_t>> align(const std::vector<uint64_t>& left, const std::vector<uint64_t>& right)
+			{
+				std::vector<std::pair<size_t, size_t>> pairs;
+				const size_t n = left.size();
+				const size_t m = right.size();
+
+				if ((n + 1) * (m + 1) > max_alignment_cells) {
+					std::unordered_map<uint64_t, std::vector<size_t>> positions;
+
+					for (size_t j = m; j-- > 0;)
+						positions[right[j]].push_back(j);
+
+					for (size_t i = 0; i < n; i++)
+					{
+						auto found = positions.find(left[i]);
+
+						if (found != positions.end() && !found->second.empty()) {
+							pairs.emplace_back(i, found->second.back());
+							found->second.pop_back();
+						}
+					}
+
+					//Only pairs that keep both sides in order can be shown as unchanged
+					std::vector<std::pair<size_t, size_t>> ordered;
+					for (auto& pair : pairs)
+					{
+						if (ordered.empty() || pair.second > ordered.back().second)
+							ordered.push_back(pair);
+					}
+
+					return ordered;
+				}
+
+				std::vector<uint32_t> lengths((n + 1) * (m + 1), 0);
+				auto at = [m](const size_t i, const size_t j) { return i * (m + 1) + j; };
+
+				for (size_t i = n; i-- > 0;)
+				{
+					for (size_t j = m; j-- > 0;)
+						lengths[at(i, j)] = left[i] == right[j] ? lengths[at(i + 1, j + 1)] + 1 : std::max(lengths[at(i + 1, j)], lengths[at(i, j + 1)]);
+				}
+
+				for (size_t i = 0, j = 0; i < n && j < m;)
+				{
+					if (left[i] == right[j]) {
+						pairs.emplace_back(i, j);
+						i++;
+						j++;
+					} else if (lengths[at(i + 1, j)] >= lengths[at(i, j + 1)]) {
+						i++;
+					} else {
+						j++;
+					}
+				}
+
+				return pairs;
+			}
+
+			std::vector<std::string> block_lines(const function_digest& digest, const size_t block)
+			{
+				std::vector<std::string> lines;
+				auto& instructions = digest.code->get_decoded();
+				auto& addresses = digest.code->get_addresses();
+
+				for (size_t i = digest.block_starts[block]; i < digest.block_starts[block + 1]; i++)
+				{
+					std::ostringstream line;
+					line << "0x" << std::hex << addresses[i] << ": ";
+					digest.code->format(line, instructions[i], addresses[i]);
+					lines.push_back(line.str());
+				}
+
+				return lines;
+			}
+		}
+
+		function_digest digest_function(const image& img, const function& func)
+		{
+			function_digest digest{ fnv_basis, {}, {}, {}, nullptr };
+
+			std::vector<uint8_t> bytes(func.reachable_end - func.begin);
+			img.read(func.begin, bytes.data(), bytes.size());
+			digest.code = std::make_unique<disassembler>(bytes, img.get_architecture(), func.begin);
+
+			auto& instructions = digest.code->get_decoded();
+			auto& addresses = digest.code->get_addresses();
+			const auto leaders = find_leaders(instructions, addresses, function_range{ 0, instructions.size() });
+
+			constant_tracker constants{ img.get_architecture() };
+			uint64_t block_hash = fnv_basis;
+
+			for (size_t i = 0; i < instructions.size(); i++)
+			{
+				if (leaders[i]) {
+					if (i)
+						digest.block_hashes.push_back(block_hash);
+
+					digest.block_starts.push_back(i);
+					block_hash = fnv_basis;
+					constants.reset();
+				}
+
+				const auto resolved = constants.step(instructions[i], addresses[i]);
+				block_hash = fnv1a(block_hash, normalize(instructions[i], resolved.has_value()));
+
+				auto flow = classify(instructions[i], addresses[i]);
+
+				if (flow.kind == flow_kind::call)
+					digest.callees.push_back(flow.target);
+				else if (flow.kind == flow_kind::indirect_call && resolved)
+					digest.callees.push_back(*resolved);
+			}
+
+			if (!instructions.empty())
+				digest.block_hashes.push_back(block_hash);
+
+			digest.block_starts.push_back(instructions.size());
+
+			for (const uint64_t hash : digest.block_hashes)
+				digest.hash = fnv1a(digest.hash, hash);
+
+			return digest;
+		}
+
+		binary_diff::binary_diff(const image& left, const image& right, thread_pool& pool) : m_left{ left, find_functions(left), {}, {} }, m_right{ right, find_functions(right), {}, {} }
+		{
+			digest(m_left, pool);
+			digest(m_right, pool);
+			match();
+		}
+
+		void binary_diff::digest(side& which, thread_pool& pool)
+		{
+			which.digests.resize(which.functions.size());
+			which.partner.assign(which.functions.size(), no_partner);
+
+			pool.parallel_for(which.functions.size(), [&which](const size_t index) { which.digests[index] = digest_function(which.img, which.functions[index]); });
+		}
+
+		void binary_diff::match()
+		{
+			auto pair_up = [this](const size_t left, const size_t right)
+			{
+				m_left.partner[left] = right;
+				m_right.partner[right] = left;
+			};
+
+			//Identical content that only occurs once on each side
+			std::unordered_map<uint64_t, std::pair<size_t, size_t>> by_hash;
+
+			for (size_t i = 0; i < m_left.digests.size(); i++)
+			{
+				auto& entry = by_hash.try_emplace(m_left.digests[i].hash, no_partner, no_partner).first->second;
+				entry.first = entry.first == no_partner ? i : no_partner - 1;
+			}
+
+			for (size_t i = 0; i < m_right.digests.size(); i++)
+			{
+				auto found = by_hash.find(m_right.digests[i].hash);
+
+				if (found != by_hash.end())
+					found->second.second = found->second.second == no_partner ? i : no_partner - 1;
+			}
+
+			for (auto& [hash, indices] : by_hash)
+			{
+				if (indices.first < no_partner - 1 && indices.second < no_partner - 1)
+					pair_up(indices.first, indices.second);
+			}
+
+			//Same symbol name
+			std::unordered_map<std::string, size_t> right_names;
+
+			for (size_t i = 0; i < m_right.functions.size(); i++)
+			{
+				if (!generated_name(m_right.functions[i].name))
+					right_names.emplace(m_right.functions[i].name, i);
+			}
+
+			for (size_t i = 0; i < m_left.functions.size(); i++)
+			{
+				auto found = right_names.find(m_left.functions[i].name);
+
+				if (m_left.partner[i] == no_partner && found != right_names.end() && m_right.partner[found->second] == no_partner)
+					pair_up(i, found->second);
+			}
+
+			//Call graph: the nth call of a matched pair goes to the same function on both sides
+			auto function_at = [](const side& which, const uint64_t address)
+			{
+				auto found = std::lower_bound(which.functions.begin(), which.functions.end(), address, [](const function& f, const uint64_t a) { return f.begin < a; });
+				return found != which.functions.end() && found->begin == address ? static_cast<size_t>(found - which.functions.begin()) : no_partner;
+			};
+
+			for (bool changed = true; changed;)
+			{
+				changed = false;
+
+				for (size_t i = 0; i < m_left.functions.size(); i++)
+				{
+					if (m_left.partner[i] == no_partner)
+						continue;
+
+					auto& left_calls = m_left.digests[i].callees;
+					auto& right_calls = m_right.digests[m_left.partner[i]].callees;
+
+					if (left_calls.size() != right_calls.size())
+						continue;
+
+					for (size_t call = 0; call < left_calls.size(); call++)
+					{
+						const size_t left = function_at(m_left, left_calls[call]);
+						const size_t right = function_at(m_right, right_calls[call]);
+
+						if (left != no_partner && right != no_partner && m_left.partner[left] == no_partner && m_right.partner[right] == no_partner) {
+							pair_up(left, right);
+							changed = true;
+						}
+					}
+				}
+			}
+		}
+
+		void binary_diff::print_changes(std::ostream& out, const size_t left, const size_t right) const
+		{
+			const function_digest& a = m_left.digests[left];
+			const function_digest& b = m_right.digests[right];
+
+			auto pairs = align(a.block_hashes, b.block_hashes);
+			pairs.emplace_back(a.block_hashes.size(), b.block_hashes.size());
+
+			out << "~ " << m_left.functions[left].name << " 0x" << std::hex << m_left.functions[left].begin << " -> " << m_right.functions[right].name << " 0x" << m_right.functions[right].begin << "\n";
+
+			size_t i = 0;
+			size_t j = 0;
+
+			for (auto& [next_i, next_j] : pairs)
+			{
+				std::vector<std::string> removed;
+				std::vector<std::string> added;
+
+				for (; i < next_i; i++)
+				{
+					auto lines = block_lines(a, i);
+					removed.insert(removed.end(), lines.begin(), lines.end());
+				}
+
+				for (; j < next_j; j++)
+				{
+					auto lines = block_lines(b, j);
+					added.insert(added.end(), lines.begin(), lines.end());
+				}
+
+				for (size_t line = 0; line < std::max(removed.size(), added.size()); line++)
+				{
+					const std::string& left_text = line < removed.size() ? removed[line] : std::string{};
+					const std::string& right_text = line < added.size() ? added[line] : std::string{};
+
+					out << "  " << std::left << std::setw(column_width) << left_text << " | " << right_text << std::right << "\n";
+				}
+
+				//Skip the matching block
+				i = next_i + 1;
+				j = next_j + 1;
+			}
+		}
+
+		void binary_diff::print(std::ostream& out) const
+		{
+			for (size_t i = 0; i < m_left.functions.size(); i++)
+			{
+				if (m_left.partner[i] == no_partner)
+					out << "- " << m_left.functions[i].name << " 0x" << std::hex << m_left.functions[i].begin << "\n";
+			}
+
+			for (size_t i = 0; i < m_right.functions.size(); i++)
+			{
+				if (m_right.partner[i] == no_partner)
+					out << "+ " << m_right.functions[i].name << " 0x" << std::hex << m_right.functions[i].begin << "\n";
+			}
+
+			for (size_t i = 0; i < m_left.functions.size(); i++)
+			{
+				const size_t partner = m_left.partner[i];
+
+				if (partner != no_partner && m_left.digests[i].hash != m_right.digests[partner].hash)
+					print_changes(out, i, partner);
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "disassembler.hpp"
+#include "functions.hpp"
+#include "thread_pool.hpp"
+#include <memory>
+
+namespace riscv
+{
+	namespace analysis
+	{
+		//A function reduced to what survives relinking: registers and plain immediates stay, branch and jump
+		//offsets, auipc/lui upper immediates and the low halves of addresses built from them don't
+		struct function_digest
+		{
+			uint64_t hash;
+			std::vector<uint64_t> block_hashes;
+			//Instruction index every block starts at, plus one past the end
+			std::vector<size_t> block_starts;
+			std::vector<uint64_t> callees;
+			std::unique_ptr<disassembler> code;
+		};
+
+		function_digest digest_function(const image& img, const function& func);
+
+		class binary_diff
+		{
+			struct side
+			{
+				const image& img;
+				std::vector<function> functions;
+				std::vector<function_digest> digests;
+				std::vector<size_t> partner;
+			};
+
+			side m_left;
+			side m_right;
+
+			void digest(side& which, thread_pool& pool);
+			void match();
+			void print_changes(std::ostream& out, const size_t left, const size_t right) const;
+
+		public:
+			binary_diff() = delete;
+			binary_diff(const binary_diff& diff) = delete;
+			binary_diff(binary_diff&& diff) = delete;
+
+			binary_diff(const image& left, const image& right, thread_pool& pool);
+
+			//Removed and added functions, then the changed blocks of every matched function side by side
+			void print(std::ostream& out) const;
+		};
+	}
+}
\ No newline at end of file
@@ -14,123 +14,222 @@
 //	You should have received a copy of the GNU General Public License
 //	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
 #include "disassembler.hpp"
+#include "constants.hpp"
 #include "registers.hpp"
 #include <iostream>
 
 namespace riscv
 {
-	std::vector<instruction::object> disassembler::get_instructions(const std::vector<uint32_t>& code)
+	std::vector<instruction::object> disassembler::get_instructions(const std::vector<uint32_t>& code, const isa arch)
 	{
 		std::vector<instruction::object> instruction_objects;
+		instruction_objects.reserve(code.size());
+
 		for (auto instruction : code)
 		{
-			instruction_objects.emplace_back(instruction::object{ instruction });
+			instruction_objects.emplace_back(instruction::object{ instruction, arch });
 		}
 
 		return instruction_objects;
 	}
 
-	std::vector<instruction::object> disassembler::get_instructions(std::vector<uint32_t>&& code)
+	std::vector<instruction::object> disassembler::get_instructions(std::vector<uint32_t>&& code, const isa arch)
 	{
-		return get_instructions(code);
+		return get_instructions(code, arch);
 	}
 
-	void disassembler::parse_instructions()
+	std::vector<instruction::object> disassembler::get_instructions(const std::vector<uint8_t>& code, const isa arch)
 	{
-		for (const instruction::object& instruction : m_instructions)
+		std::vector<instruction::object> instruction_objects;
+		instruction_objects.reserve(code.size() / 3);
+
+		size_t offset = 0;
+		while (offset + 2 <= code.size())
 		{
-			switch (instruction.get_type())
-			{
-			case instruction::type_identifier::R:
-				parse_instruction(std::get<instruction::type_r>(instruction.get_data()));
-				break;
+			uint32_t instruction = code[offset] | (code[offset + 1] << 8);
 
-			case instruction::type_identifier::R4:
-				parse_instruction(std::get<instruction::type_r4>(instruction.get_data()));
-				break;
+			if ((instruction & 0x3) != 0x3) {
+				instruction_objects.emplace_back(instruction::object{ instruction, arch });
+				offset += 2;
+				continue;
+			}
 
-			case instruction::type_identifier::I:
-				parse_instruction(std::get<instruction::type_i>(instruction.get_data()));
+			//Cut off in the middle of a 32 bit instruction
+			if (offset + 4 > code.size())
 				break;
 
-			case instruction::type_identifier::J:
-				parse_instruction(std::get<instruction::type_j>(instruction.get_data()));
-				break;
+			instruction |= (code[offset + 2] << 16) | (static_cast<uint32_t>(code[offset + 3]) << 24);
+			instruction_objects.emplace_back(instruction::object{ instruction, arch });
+			offset += 4;
+		}
 
-			case instruction::type_identifier::U:
-				parse_instruction(std::get<instruction::type_u>(instruction.get_data()));
-				break;
+		return instruction_objects;
+	}
 
-			case instruction::type_identifier::S:
-				parse_instruction(std::get<instruction::type_s>(instruction.get_data()));
-				break;
+	void disassembler::set_addresses()
+	{
+		m_addresses.reserve(m_instructions.size());
 
-			case instruction::type_identifier::B:
-				parse_instruction(std::get<instruction::type_b>(instruction.get_data()));
-				break;
+		uint64_t address = m_base_address;
+		for (const instruction::object& instruction : m_instructions)
+		{
+			m_addresses.push_back(address);
+			address += instruction.get_length();
+		}
+	}
 
-			default:
-				return;
+	void disassembler::rebase(const uint64_t base_address)
+	{
+		m_base_address = base_address;
+		m_addresses.clear();
+		set_addresses();
+	}
+
+	const uint64_t disassembler::wrap_address(const uint64_t address) const
+	{
+		return m_architecture == isa::RV32 ? (address & 0xffffffff) : address;
+	}
+
+	void disassembler::parse_instructions()
+	{
+		parse_instructions(std::cout);
+	}
+
+	void disassembler::parse_instructions(std::ostream& out)
+	{
+		auto resolved = analysis::propagate_constants(m_instructions, m_addresses, m_architecture);
+		auto next_resolved = resolved.begin();
+
+		for (size_t i = 0; i < m_instructions.size(); i++)
+		{
+			const instruction::object& instruction = m_instructions[i];
+			const uint64_t address = m_addresses[i];
+
+			out << "0x" << std::hex << address << ": ";
+			format(out, instruction, address);
+
+			if (next_resolved != resolved.end() && next_resolved->index == i) {
+				out << " # 0x" << std::hex << next_resolved->value;
+				++next_resolved;
 			}
+
+			out << "\n";
 		}
 	}
 
-	void disassembler::parse_instruction(const instruction::type_i& instruction)
+	void disassembler::format(std::ostream& out, const instruction::object& instruction, const uint64_t address) const
 	{
-		auto potential_instructions = instruction::instruction_table.at(instruction.opcode);
+		switch (instruction.get_type())
+		{
+		case instruction::type_identifier::R:
+			parse_instruction(out, std::get<instruction::type_r>(instruction.get_data()));
+			break;
+
+		case instruction::type_identifier::R4:
+			parse_instruction(out, std::get<instruction::type_r4>(instruction.get_data()));
+			break;
+
+		case instruction::type_identifier::I:
+			parse_instruction(out, std::get<instruction::type_i>(instruction.get_data()));
+			break;
+
+		case instruction::type_identifier::J:
+			parse_instruction(out, std::get<instruction::type_j>(instruction.get_data()), address);
+			break;
+
+		case instruction::type_identifier::U:
+			parse_instruction(out, std::get<instruction::type_u>(instruction.get_data()));
+			break;
+
+		case instruction::type_identifier::S:
+			parse_instruction(out, std::get<instruction::type_s>(instruction.get_data()));
+			break;
+
+		case instruction::type_identifier::B:
+			parse_instruction(out, std::get<instruction::type_b>(instruction.get_data()), address);
+			break;
+
+		case instruction::type_identifier::CEXT:
+			compressed_instruction_handler(out, instruction, address);
+			break;
+
+		default:
+			unknown_instruction_handler(out, instruction);
+			break;
+		}
+	}
+
+	const std::vector<instruction::object>& disassembler::get_decoded() const
+	{
+		return m_instructions;
+	}
+
+	const std::vector<uint64_t>& disassembler::get_addresses() const
+	{
+		return m_addresses;
+	}
+
+	const isa disassembler::get_architecture() const
+	{
+		return m_architecture;
+	}
+
+	void disassembler::parse_instruction(std::ostream& out, const instruction::type_i& instruction) const
+	{
+		auto& potential_instructions = instruction::instruction_table.at(instruction.opcode);
 
 		for (auto& instr_data : potential_instructions)
 		{
 			auto& [proper_opcode, mask, mnemonic, flags] { instr_data };
 
 			if ((instruction.instruction & mask) == proper_opcode) {
-				auto& destination = registers::x_reg_name_table[instruction.rd].second;
-				auto& source = registers::x_reg_name_table[instruction.rs1].second;
+				auto destination = registers::x_reg_name_table[instruction.rd].second;
+				auto source = registers::x_reg_name_table[instruction.rs1].second;
 				signed int immediate = instruction.imm;
 
 				if (flags.is_fence) {
-					fence_instruction_handler(mnemonic, immediate);
+					fence_instruction_handler(out, mnemonic, immediate);
 					return;
 				}
 
 				if (flags.is_e_sys) {
-					std::cout << mnemonic << "\n";
+					out << mnemonic;
 					return;
 				}
 
 				//double check this, these are CSR setting instructions that use rs1 as an immediate rather than register
 				//do we need to make a function for this or eh? (seems wasteful)
 				if (flags.is_imm_csr) {
-					uint8_t csr_source = instruction.rs1;
+					uint32_t csr_source = instruction.rs1;
 
-					std::cout << mnemonic << " " << destination << ", 0x" << std::hex << csr_source << ", 0x" << immediate << "\n";
+					out << mnemonic << " " << destination << ", 0x" << std::hex << csr_source << ", 0x" << (immediate & 0xfff);
 					return;
 				}
 
-				//Make better l8r
-				if (flags.is_float) {
+				//Make better l8r, the base address of float loads is still an integer register
+				if (flags.is_float)
 					destination = registers::f_reg_name_table[instruction.rd].second;
-					source = registers::f_reg_name_table[instruction.rs1].second;
-				}
 
 				//check for shamt instructions
 				if (flags.is_shamt)
 					immediate = (immediate & 0x3F); //This handles both the RV64I and RV32I case, note that this is 000000111111, this will pull out the shamt correctly for both, look in manual
 
 				if (flags.is_sl) {
-					std::cout << mnemonic << " " << destination << ", 0x" << std::hex << immediate << "(" << source << ")\n";
+					out << mnemonic << " " << destination << ", 0x" << std::hex << immediate << "(" << source << ")";
 					return;
 				}
 
-				std::cout << mnemonic << " " << destination << ", " << source << ", 0x" << std::hex << immediate << "\n";
+				out << mnemonic << " " << destination << ", " << source << ", 0x" << std::hex << immediate;
 				return;
 			}
 		}
+
+		unknown_instruction_handler(out, instruction::object{ instruction.instruction });
 	}
 
-	void disassembler::parse_instruction(const instruction::type_r& instruction)
+	void disassembler::parse_instruction(std::ostream& out, const instruction::type_r& instruction) const
 	{
-		auto potential_instructions = instruction::instruction_table.at(instruction.opcode);
+		auto& potential_instructions = instruction::instruction_table.at(instruction.opcode);
 
 		for (auto& instr_data : potential_instructions)
 		{
@@ -140,12 +239,12 @@ namespace riscv
 
 				//A extension checks
 				if (flags.is_a_ext) {
-					a_ext_instruction_handler(instruction, instr_data);
+					a_ext_instruction_handler(out, instruction, instr_data);
 					return;
 				}
 
 				if (flags.is_float) {
-					float_instruction_handler(instruction, instr_data);
+					float_instruction_handler(out, instruction, instr_data);
 					return;
 				}
 
@@ -153,16 +252,18 @@ namespace riscv
 				auto& middle = registers::x_reg_name_table[instruction.rs1].second;
 				auto& last = registers::x_reg_name_table[instruction.rs2].second;
 
-				std::cout << mnemonic << " " << destination << ", " << middle << ", " << last << "\n";
+				out << mnemonic << " " << destination << ", " << middle << ", " << last;
 
 				return;
 			}
 		}
+
+		unknown_instruction_handler(out, instruction::object{ instruction.instruction });
 	}
 
-	void disassembler::parse_instruction(const instruction::type_r4& instruction)
+	void disassembler::parse_instruction(std::ostream& out, const instruction::type_r4& instruction) const
 	{
-		auto potential_instructions = instruction::instruction_table.at(instruction.opcode);
+		auto& potential_instructions = instruction::instruction_table.at(instruction.opcode);
 
 		for (auto& instr_data : potential_instructions)
 		{
@@ -175,16 +276,18 @@ namespace riscv
 				auto& last = registers::f_reg_name_table[instruction.rs3].second;
 				auto& mode = instruction::float_rounding_name[instruction.funct3].second;
 
-				std::cout << mnemonic << "(" << mode << ") " << destination << ", " << first << ", " << middle << ", " << last << "\n";
+				out << mnemonic << "(" << mode << ") " << destination << ", " << first << ", " << middle << ", " << last;
 
 				return;
 			}
 		}
+
+		unknown_instruction_handler(out, instruction::object{ instruction.instruction });
 	}
 
-	void disassembler::parse_instruction(const instruction::type_b& instruction)
+	void disassembler::parse_instruction(std::ostream& out, const instruction::type_b& instruction, const uint64_t address) const
 	{
-		auto potential_instructions = instruction::instruction_table.at(instruction.opcode);
+		auto& potential_instructions = instruction::instruction_table.at(instruction.opcode);
 
 		for (auto& instr_data : potential_instructions)
 		{
@@ -193,25 +296,20 @@ namespace riscv
 			if ((instruction.instruction & mask) == proper_opcode) {
 				auto& destination = registers::x_reg_name_table[instruction.rs1].second;
 				auto& source = registers::x_reg_name_table[instruction.rs2].second;
-				signed int immediate = 0;
-
-				//Might be wrong, make sure to double check....
-				immediate |= (instruction.imm_a << 11);
-				immediate |= (instruction.imm_b << 1);
-				immediate |= (instruction.imm_c << 5);
-				immediate |= (instruction.imm_d << 12);
+				const int64_t offset = instruction::object{ instruction.instruction }.get_immediate();
 
-				//Implement actual pc relative addressing later
-				std::cout << mnemonic << " " << destination << ", " << source << ", 0x" << std::hex << immediate << "(pc)\n";
+				out << mnemonic << " " << destination << ", " << source << ", 0x" << std::hex << wrap_address(address + offset);
 
 				return;
 			}
 		}
+
+		unknown_instruction_handler(out, instruction::object{ instruction.instruction });
 	}
 
-	void disassembler::parse_instruction(const instruction::type_u& instruction)
+	void disassembler::parse_instruction(std::ostream& out, const instruction::type_u& instruction) const
 	{
-		auto potential_instructions = instruction::instruction_table.at(instruction.opcode);
+		auto& potential_instructions = instruction::instruction_table.at(instruction.opcode);
 
 		for (auto& instr_data : potential_instructions)
 		{
@@ -219,42 +317,43 @@ namespace riscv
 
 			if ((instruction.instruction & mask) == proper_opcode) {
 				auto& destination = registers::x_reg_name_table[instruction.rd].second;
-				signed int immediate = instruction.imm;
+				uint32_t immediate = instruction.instruction >> 12;
 
-				std::cout << mnemonic << " " << destination << ", 0x" << std::hex << immediate << "\n";
+				out << mnemonic << " " << destination << ", 0x" << std::hex << immediate;
+				return;
 			}
 		}
+
+		unknown_instruction_handler(out, instruction::object{ instruction.instruction });
 	}
 
-	void disassembler::parse_instruction(const instruction::type_s& instruction)
+	void disassembler::parse_instruction(std::ostream& out, const instruction::type_s& instruction) const
 	{
-		auto potential_instructions = instruction::instruction_table.at(instruction.opcode);
+		auto& potential_instructions = instruction::instruction_table.at(instruction.opcode);
 
 		for (auto& instr_data : potential_instructions)
 		{
 			auto& [proper_opcode, mask, mnemonic, flags] { instr_data };
 
 			if ((instruction.instruction & mask) == proper_opcode) {
-				auto& destination = registers::x_reg_name_table[instruction.rs2].second;
+				auto destination = registers::x_reg_name_table[instruction.rs2].second;
 				auto& source = registers::x_reg_name_table[instruction.rs1].second;
-				signed int immediate = 0;
+				signed int immediate = instruction::object{ instruction.instruction }.get_immediate();
 
-				if (flags.is_float) {
+				if (flags.is_float)
 					destination = registers::f_reg_name_table[instruction.rs2].second;
-					source = registers::f_reg_name_table[instruction.rs1].second;
-				}
-
-				immediate |= instruction.imm_a;
-				immediate |= (instruction.imm_b << 5);
 
-				std::cout << mnemonic << " " << destination << ", 0x" << std::hex << immediate << "(" << source << ")\n";
+				out << mnemonic << " " << destination << ", 0x" << std::hex << immediate << "(" << source << ")";
+				return;
 			}
 		}
+
+		unknown_instruction_handler(out, instruction::object{ instruction.instruction });
 	}
 
-	void disassembler::parse_instruction(const instruction::type_j& instruction)
+	void disassembler::parse_instruction(std::ostream& out, const instruction::type_j& instruction, const uint64_t address) const
 	{
-		auto potential_instructions = instruction::instruction_table.at(instruction.opcode);
+		auto& potential_instructions = instruction::instruction_table.at(instruction.opcode);
 
 		for (auto& instr_data : potential_instructions)
 		{
@@ -262,46 +361,13 @@ namespace riscv
 
 			if ((instruction.instruction & mask) == proper_opcode) {
 				auto& destination = registers::x_reg_name_table[instruction.rd].second;
-				signed int immediate = 0;
-
-				if (flags.is_float)
-					destination = registers::f_reg_name_table[instruction.rd].second;
-
-				//double check
-				immediate |= (instruction.imm_a << 12);
-				immediate |= (instruction.imm_b << 11);
-				immediate |= (instruction.imm_c << 1);
-				immediate |= (instruction.imm_d << 20);
+				const int64_t offset = instruction::object{ instruction.instruction }.get_immediate();
 
-				std::cout << mnemonic << " " << destination << ", 0x" << std::hex << immediate << "(pc)\n";
+				out << mnemonic << " " << destination << ", 0x" << std::hex << wrap_address(address + offset);
+				return;
 			}
 		}
-	}
-
-	void parse_instruction(const instruction::type_cr& instruction)
-	{}
-
-	void parse_instruction(const instruction::type_ci& instruction)
-	{}
-
-	void parse_instruction(const instruction::type_css& instruction)
-	{}
-
-	void parse_instruction(const instruction::type_ciw& instruction)
-	{}
 
-	void parse_instruction(const instruction::type_cl& instruction)
-	{}
-
-	void parse_instruction(const instruction::type_cs& instruction)
-	{}
-
-	void parse_instruction(const instruction::type_ca& instruction)
-	{}
-
-	void parse_instruction(const instruction::type_cb& instruction)
-	{}
-
-	void parse_instruction(const instruction::type_cj& instruction)
-	{}
+		unknown_instruction_handler(out, instruction::object{ instruction.instruction });
+	}
 }
\ No newline at end of file
@@ -16,58 +16,77 @@
 #pragma once
 
 #include "instructions.hpp"
+#include <ostream>
 
 namespace riscv {
-	enum class isa
-	{
-		RV32,
-		RV64,
-		RV128
-	};
-
 	class disassembler
 	{
-		using instruction_data = std::tuple<uint32_t, uint32_t, std::string, instruction::instruction_flags>;
+		using instruction_data = std::tuple<uint32_t, uint32_t, std::string_view, instruction::instruction_flags>;
 
 		std::vector<instruction::object> m_instructions;
 		isa m_architecture;
+		uint64_t m_base_address;
+		std::vector<uint64_t> m_addresses;
 
 		//Use std::span when msvc decides to get off their lazy ass and implement it
-		std::vector<instruction::object> get_instructions(const std::vector<uint32_t>& code);
-		std::vector<instruction::object> get_instructions(std::vector<uint32_t>&& code);
-
-		void parse_instruction(const instruction::type_i& instruction);
-		void parse_instruction(const instruction::type_r& instruction);
-		void parse_instruction(const instruction::type_r4& instruction);
-		void parse_instruction(const instruction::type_b& instruction);
-		void parse_instruction(const instruction::type_u& instruction);
-		void parse_instruction(const instruction::type_s& instruction);
-		void parse_instruction(const instruction::type_j& instruction);
-		void parse_instruction(const instruction::type_cr& instruction);
-		void parse_instruction(const instruction::type_ci& instruction);
-		void parse_instruction(const instruction::type_css& instruction);
-		void parse_instruction(const instruction::type_ciw& instruction);
-		void parse_instruction(const instruction::type_cl& instruction);
-		void parse_instruction(const instruction::type_cs& instruction);
-		void parse_instruction(const instruction::type_ca& instruction);
-		void parse_instruction(const instruction::type_cb& instruction);
-		void parse_instruction(const instruction::type_cj& instruction);
-
-		void fence_instruction_handler(const std::string& mnemonic, const signed int& imm);
-		void float_instruction_handler(const instruction::type_r& instruction, instruction_data instr_data);
-		void a_ext_instruction_handler(const instruction::type_r& instruction, instruction_data instr_data);
+		static std::vector<instruction::object> get_instructions(const std::vector<uint32_t>& code, const isa arch);
+		static std::vector<instruction::object> get_instructions(std::vector<uint32_t>&& code, const isa arch);
+		static std::vector<instruction::object> get_instructions(const std::vector<uint8_t>& code, const isa arch);
+
+		void set_addresses();
+		const uint64_t wrap_address(const uint64_t address) const;
+
+		void parse_instruction(std::ostream& out, const instruction::type_i& instruction) const;
+		void parse_instruction(std::ostream& out, const instruction::type_r& instruction) const;
+		void parse_instruction(std::ostream& out, const instruction::type_r4& instruction) const;
+		void parse_instruction(std::ostream& out, const instruction::type_b& instruction, const uint64_t address) const;
+		void parse_instruction(std::ostream& out, const instruction::type_u& instruction) const;
+		void parse_instruction(std::ostream& out, const instruction::type_s& instruction) const;
+		void parse_instruction(std::ostream& out, const instruction::type_j& instruction, const uint64_t address) const;
+
+		void fence_instruction_handler(std::ostream& out, const std::string_view mnemonic, const signed int& imm) const;
+		void float_instruction_handler(std::ostream& out, const instruction::type_r& instruction, instruction_data instr_data) const;
+		void a_ext_instruction_handler(std::ostream& out, const instruction::type_r& instruction, instruction_data instr_data) const;
+		void compressed_instruction_handler(std::ostream& out, const instruction::object& instruction, const uint64_t address) const;
+		void unknown_instruction_handler(std::ostream& out, const instruction::object& instruction) const;
 
 	public:
 		disassembler() = delete;
 		disassembler(const disassembler& disasm) = delete;
 		disassembler(disassembler&& disasm) = delete;
 
-		disassembler(const std::vector<uint32_t>& code, const isa arch) : m_instructions{ get_instructions(code) }, m_architecture{ arch }
-		{}
+		//One instruction per element, compressed instructions sit in the low half of their element
+		disassembler(const std::vector<uint32_t>& code, const isa arch, const uint64_t base_address = 0) : m_instructions{ get_instructions(code, arch) }, m_architecture{ arch }, m_base_address{ base_address }
+		{
+			set_addresses();
+		}
+
+		disassembler(std::vector<uint32_t>&& code, const isa arch, const uint64_t base_address = 0) : m_instructions{ get_instructions(std::move(code), arch) }, m_architecture{ arch }, m_base_address{ base_address }
+		{
+			set_addresses();
+		}
+
+		//Raw little endian code bytes with 16 and 32 bit instructions mixed the way they are in memory
+		disassembler(const std::vector<uint8_t>& code, const isa arch, const uint64_t base_address = 0) : m_instructions{ get_instructions(code, arch) }, m_architecture{ arch }, m_base_address{ base_address }
+		{
+			set_addresses();
+		}
 
-		disassembler(std::vector<uint32_t>&& code, const isa arch) : m_instructions{ get_instructions(std::move(code)) }, m_architecture{ arch }
+		//Nothing to disassemble up front, just for formatting instructions that come from elsewhere
+		explicit disassembler(const isa arch) : m_architecture{ arch }, m_base_address{ 0 }
 		{}
 
 		void parse_instructions();
+		void parse_instructions(std::ostream& out);
+
+		//Moves the decoded code to another address without decoding it again
+		void rebase(const uint64_t base_address);
+
+		//One instruction without the address prefix or newline, address is what branch and jump targets are relative to
+		void format(std::ostream& out, const instruction::object& instruction, const uint64_t address) const;
+
+		const std::vector<instruction::object>& get_decoded() const;
+		const std::vector<uint64_t>& get_addresses() const;
+		const isa get_architecture() const;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,199 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "discovery.hpp"
+#include "analysis.hpp"
+#include "constants.hpp"
+#include <algorithm>
+
+namespace riscv
+{
+	namespace analysis
+	{
+		namespace
+		{
+			//Switch dispatch sequences are short, no point in keeping more than this around for the jump table matcher
+			constexpr size_t history_length = 32;
+		}
+
+		code_discovery::code_discovery(const image& img, const std::vector<uint64_t>& entry_points) : m_image{ img }, m_worklist{ entry_points }
+		{
+			for (auto& seg : m_image.get_segments())
+				m_visited.emplace_back(seg.executable ? (seg.size + 1) / 2 : 0, false);
+
+			std::vector<std::pair<uint64_t, uint32_t>> found;
+
+			while (!m_worklist.empty())
+			{
+				const uint64_t address = m_worklist.back();
+				m_worklist.pop_back();
+
+				decode_run(address, found);
+			}
+
+			std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+			m_instructions.reserve(found.size());
+			m_addresses.reserve(found.size());
+
+			for (auto& [address, raw] : found)
+			{
+				m_addresses.push_back(address);
+				m_instructions.emplace_back(raw, m_image.get_architecture());
+			}
+
+			std::sort(m_call_targets.begin(), m_call_targets.end());
+			m_call_targets.erase(std::unique(m_call_targets.begin(), m_call_targets.end()), m_call_targets.end());
+
+			std::sort(m_jump_tables.begin(), m_jump_tables.end(), [](const jump_table& a, const jump_table& b) { return a.jump_address < b.jump_address; });
+		}
+
+		bool code_discovery::mark(const uint64_t address)
+		{
+			if (address & 1)
+				return false;
+
+			auto& segments = m_image.get_segments();
+			const segment* seg = m_image.find_segment(address);
+
+			if (!seg || !seg->executable)
+				return false;
+
+			auto& visited = m_visited[seg - segments.data()];
+			const size_t slot = (address - seg->address) / 2;
+
+			if (visited[slot])
+				return false;
+
+			visited[slot] = true;
+			return true;
+		}
+
+		void code_discovery::decode_run(uint64_t address, std::vector<std::pair<uint64_t, uint32_t>>& found)
+		{
+			const isa arch = m_image.get_architecture();
+
+			std::vector<instruction::object> run;
+			std::vector<uint64_t> run_addresses;
+			constant_tracker constants{ arch };
+
+			while (mark(address))
+			{
+				auto low = m_image.read_value<uint16_t>(address);
+				if (!low)
+					return;
+
+				uint32_t raw = *low;
+
+				if ((raw & 0x3) == 0x3) {
+					auto high = m_image.read_value<uint16_t>(address + 2);
+					if (!high)
+						return;
+
+					raw |= static_cast<uint32_t>(*high) << 16;
+				}
+
+				const instruction::object instruction{ raw, arch };
+
+				//Ran into data
+				if (instruction.get_type() == instruction::type_identifier::UNKNOWN || !instruction.get_expanded())
+					return;
+
+				found.emplace_back(address, raw);
+				run.push_back(instruction);
+				run_addresses.push_back(address);
+
+				auto flow = classify(instruction, address);
+				const auto resolved = constants.step(instruction, address);
+
+				//auipc + jalr pairs, calls and tail calls too far away for jal
+				if (resolved && (flow.kind == flow_kind::indirect_call || flow.kind == flow_kind::indirect_jump)) {
+					flow.kind = flow.kind == flow_kind::indirect_call ? flow_kind::call : flow_kind::jump;
+					flow.target = *resolved;
+				}
+
+				if (arch == isa::RV32)
+					flow.target &= 0xffffffff;
+
+				switch (flow.kind)
+				{
+				case flow_kind::branch:
+					m_worklist.push_back(flow.target);
+					break;
+
+				case flow_kind::call:
+					m_worklist.push_back(flow.target);
+					m_call_targets.push_back(flow.target);
+					break;
+
+				case flow_kind::jump:
+					m_worklist.push_back(flow.target);
+					return;
+
+				case flow_kind::ret:
+					return;
+
+				case flow_kind::indirect_jump: {
+					const size_t first = run.size() > history_length ? run.size() - history_length : 0;
+
+					const std::vector<instruction::object> history{ run.begin() + first, run.end() };
+					const std::vector<uint64_t> history_addresses{ run_addresses.begin() + first, run_addresses.end() };
+
+					if (auto table = recover_jump_table(m_image, history, history_addresses)) {
+						m_worklist.insert(m_worklist.end(), table->targets.begin(), table->targets.end());
+						m_jump_tables.push_back(std::move(*table));
+					}
+					return;
+				}
+
+				default:
+					break;
+				}
+
+				address += instruction.get_length();
+			}
+		}
+
+		const std::vector<instruction::object>& code_discovery::get_instructions() const
+		{
+			return m_instructions;
+		}
+
+		const std::vector<uint64_t>& code_discovery::get_addresses() const
+		{
+			return m_addresses;
+		}
+
+		const std::vector<jump_table>& code_discovery::get_jump_tables() const
+		{
+			return m_jump_tables;
+		}
+
+		const std::vector<uint64_t>& code_discovery::get_call_targets() const
+		{
+			return m_call_targets;
+		}
+
+		std::vector<instruction::object> code_discovery::take_instructions()
+		{
+			return std::move(m_instructions);
+		}
+
+		std::vector<uint64_t> code_discovery::take_addresses()
+		{
+			return std::move(m_addresses);
+		}
+	}
+}
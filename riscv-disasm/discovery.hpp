@@ -0,0 +1,58 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "jump_tables.hpp"
+
+namespace riscv
+{
+	namespace analysis
+	{
+		//Recursive traversal: decodes from the entry points and follows branches, calls and recovered jump tables,
+		//so only what is actually reachable as code gets decoded
+		class code_discovery
+		{
+			const image& m_image;
+			std::vector<std::vector<bool>> m_visited;
+			std::vector<uint64_t> m_worklist;
+
+			std::vector<instruction::object> m_instructions;
+			std::vector<uint64_t> m_addresses;
+			std::vector<jump_table> m_jump_tables;
+			std::vector<uint64_t> m_call_targets;
+
+			bool mark(const uint64_t address);
+			void decode_run(uint64_t address, std::vector<std::pair<uint64_t, uint32_t>>& found);
+
+		public:
+			code_discovery() = delete;
+			code_discovery(const code_discovery& discovery) = delete;
+			code_discovery(code_discovery&& discovery) = delete;
+
+			code_discovery(const image& img, const std::vector<uint64_t>& entry_points);
+
+			//Sorted by address, there can be gaps between instructions
+			const std::vector<instruction::object>& get_instructions() const;
+			const std::vector<uint64_t>& get_addresses() const;
+			const std::vector<jump_table>& get_jump_tables() const;
+			//Sorted and unique, includes auipc + jalr calls
+			const std::vector<uint64_t>& get_call_targets() const;
+
+			std::vector<instruction::object> take_instructions();
+			std::vector<uint64_t> take_addresses();
+		};
+	}
+}
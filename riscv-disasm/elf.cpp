@@ -12,4 +12,510 @@
 //	GNU General Public License for more details.
 //
 //	You should have received a copy of the GNU General Public License
-//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
\ No newline at end of file
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "elf.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace riscv
+{
+	namespace elf
+	{
+		namespace
+		{
+			enum : uint32_t
+			{
+				sht_symtab = 2,
+				sht_rela = 4,
+				sht_nobits = 8,
+				sht_dynsym = 11,
+
+				shf_write = 0x1,
+				shf_alloc = 0x2,
+				shf_execinstr = 0x4,
+
+				pt_load = 1,
+				pf_x = 0x1,
+				pf_w = 0x2,
+
+				et_rel = 1,
+
+				stt_func = 2,
+				stt_section = 3,
+				stt_file = 4,
+				shn_undef = 0,
+				shn_loreserve = 0xff00
+			};
+
+			struct section_header
+			{
+				uint32_t name;
+				uint32_t type;
+				uint64_t flags;
+				uint64_t address;
+				uint64_t offset;
+				uint64_t size;
+				uint32_t link;
+				uint32_t info;
+				uint64_t alignment;
+				uint64_t entry_size;
+			};
+
+			//ELF32 and ELF64 only differ in field widths and the order of a few symbol fields, so everything gets read into the 64 bit layout
+			class reader
+			{
+				const std::vector<uint8_t>& m_file;
+				bool m_64;
+
+			public:
+				reader(const std::vector<uint8_t>& file, const bool is_64) : m_file{ file }, m_64{ is_64 }
+				{}
+
+				template<typename T>
+				T get(const uint64_t offset) const
+				{
+					if (offset > m_file.size() || m_file.size() - offset < sizeof(T))
+						throw std::runtime_error("elf: read past the end of the file");
+
+					T value;
+					std::memcpy(&value, m_file.data() + offset, sizeof(T));
+					return value;
+				}
+
+				//Address sized field
+				uint64_t word(const uint64_t offset) const
+				{
+					return m_64 ? get<uint64_t>(offset) : get<uint32_t>(offset);
+				}
+
+				const bool is_64() const
+				{
+					return m_64;
+				}
+
+				section_header section(const uint64_t offset) const
+				{
+					if (m_64)
+						return { get<uint32_t>(offset), get<uint32_t>(offset + 4), get<uint64_t>(offset + 8), get<uint64_t>(offset + 16), get<uint64_t>(offset + 24), get<uint64_t>(offset + 32), get<uint32_t>(offset + 40), get<uint32_t>(offset + 44), get<uint64_t>(offset + 48), get<uint64_t>(offset + 56) };
+
+					return { get<uint32_t>(offset), get<uint32_t>(offset + 4), get<uint32_t>(offset + 8), get<uint32_t>(offset + 12), get<uint32_t>(offset + 16), get<uint32_t>(offset + 20), get<uint32_t>(offset + 24), get<uint32_t>(offset + 28), get<uint32_t>(offset + 32), get<uint32_t>(offset + 36) };
+				}
+
+				//Points into the file, intern or copy it before the file goes away
+				std::string_view string(const section_header& table, const uint32_t index) const
+				{
+					if (index >= table.size || table.offset + index >= m_file.size())
+						return {};
+
+					const char* begin = reinterpret_cast<const char*>(m_file.data() + table.offset + index);
+					return std::string_view{ begin, strnlen(begin, static_cast<size_t>(std::min<uint64_t>(table.size - index, m_file.size() - table.offset - index))) };
+				}
+			};
+
+			//Assembler mapping symbols and local labels aren't worth showing
+			bool is_noise(const std::string_view name)
+			{
+				return name.empty() || name[0] == '$' || name.rfind(".L", 0) == 0;
+			}
+
+			//The ones that matter for reading code, TLS, GOT and relaxation hints are left alone
+			enum : uint32_t
+			{
+				r_riscv_32 = 1,
+				r_riscv_64 = 2,
+				r_riscv_branch = 16,
+				r_riscv_jal = 17,
+				r_riscv_call = 18,
+				r_riscv_call_plt = 19,
+				r_riscv_pcrel_hi20 = 23,
+				r_riscv_pcrel_lo12_i = 24,
+				r_riscv_pcrel_lo12_s = 25,
+				r_riscv_hi20 = 26,
+				r_riscv_lo12_i = 27,
+				r_riscv_lo12_s = 28,
+				r_riscv_add8 = 33,
+				r_riscv_add16 = 34,
+				r_riscv_add32 = 35,
+				r_riscv_add64 = 36,
+				r_riscv_sub8 = 37,
+				r_riscv_sub16 = 38,
+				r_riscv_sub32 = 39,
+				r_riscv_sub64 = 40,
+				r_riscv_rvc_branch = 44,
+				r_riscv_rvc_jump = 45,
+				r_riscv_set8 = 54,
+				r_riscv_set16 = 55,
+				r_riscv_set32 = 56,
+				r_riscv_32_pcrel = 57
+			};
+
+			struct relocation
+			{
+				uint64_t offset;
+				uint32_t symbol;
+				uint32_t type;
+				int64_t addend;
+			};
+
+			template<typename T>
+			T peek(const uint8_t* at)
+			{
+				T value;
+				std::memcpy(&value, at, sizeof(T));
+				return value;
+			}
+
+			template<typename T>
+			void poke(uint8_t* at, const T value)
+			{
+				std::memcpy(at, &value, sizeof(T));
+			}
+
+			uint32_t with_hi20(const uint32_t instruction, const uint64_t value)
+			{
+				return (instruction & 0xfff) | (static_cast<uint32_t>(value + 0x800) & 0xfffff000);
+			}
+
+			uint32_t with_lo12_i(const uint32_t instruction, const uint64_t value)
+			{
+				return (instruction & 0xfffff) | (static_cast<uint32_t>(value & 0xfff) << 20);
+			}
+
+			uint32_t with_lo12_s(const uint32_t instruction, const uint64_t value)
+			{
+				const uint32_t low = static_cast<uint32_t>(value & 0xfff);
+				return (instruction & 0x01fff07f) | ((low >> 5) << 25) | ((low & 0x1f) << 7);
+			}
+
+			uint32_t with_branch(const uint32_t instruction, const uint64_t offset)
+			{
+				const uint32_t v = static_cast<uint32_t>(offset);
+				return (instruction & 0x01fff07f) | (((v >> 12) & 1) << 31) | (((v >> 5) & 0x3f) << 25) | (((v >> 1) & 0xf) << 8) | (((v >> 11) & 1) << 7);
+			}
+
+			uint32_t with_jal(const uint32_t instruction, const uint64_t offset)
+			{
+				const uint32_t v = static_cast<uint32_t>(offset);
+				return (instruction & 0xfff) | (((v >> 20) & 1) << 31) | (((v >> 1) & 0x3ff) << 21) | (((v >> 11) & 1) << 20) | (((v >> 12) & 0xff) << 12);
+			}
+
+			uint16_t with_rvc_branch(const uint16_t instruction, const uint64_t offset)
+			{
+				const uint32_t v = static_cast<uint32_t>(offset);
+				return static_cast<uint16_t>((instruction & 0xe383) | (((v >> 8) & 1) << 12) | (((v >> 3) & 3) << 10) | (((v >> 6) & 3) << 5) | (((v >> 1) & 3) << 3) | (((v >> 5) & 1) << 2));
+			}
+
+			uint16_t with_rvc_jump(const uint16_t instruction, const uint64_t offset)
+			{
+				const uint32_t v = static_cast<uint32_t>(offset);
+				return static_cast<uint16_t>((instruction & 0xe003) | (((v >> 11) & 1) << 12) | (((v >> 4) & 1) << 11) | (((v >> 8) & 3) << 9) | (((v >> 10) & 1) << 8) | (((v >> 6) & 1) << 7) | (((v >> 7) & 1) << 6) | (((v >> 1) & 7) << 3) | (((v >> 5) & 1) << 2));
+			}
+
+			//Bytes the relocation writes, so it can be bounds checked before touching anything
+			size_t patch_size(const uint32_t type)
+			{
+				switch (type)
+				{
+				case r_riscv_add8:
+				case r_riscv_sub8:
+				case r_riscv_set8:
+					return 1;
+				case r_riscv_add16:
+				case r_riscv_sub16:
+				case r_riscv_set16:
+				case r_riscv_rvc_branch:
+				case r_riscv_rvc_jump:
+					return 2;
+				case r_riscv_64:
+				case r_riscv_add64:
+				case r_riscv_sub64:
+				case r_riscv_call:
+				case r_riscv_call_plt:
+					return 8;
+				default:
+					return 4;
+				}
+			}
+		}
+
+		bool is_elf(const std::vector<uint8_t>& file)
+		{
+			return file.size() >= 4 && file[0] == 0x7f && file[1] == 'E' && file[2] == 'L' && file[3] == 'F';
+		}
+
+		image load(std::vector<uint8_t>&& file)
+		{
+			if (!is_elf(file) || file.size() < 0x34)
+				throw std::runtime_error("elf: not an ELF file");
+
+			if (file[5] != 1)
+				throw std::runtime_error("elf: only little endian files are supported");
+
+			//Segments point straight into the file, the image keeps it alive
+			auto storage = std::make_shared<std::vector<uint8_t>>(std::move(file));
+			std::vector<uint8_t>& bytes = *storage;
+			const reader elf{ bytes, bytes[4] == 2 };
+
+			if (elf.get<uint16_t>(0x12) != machine_riscv)
+				throw std::runtime_error("elf: not a RISC-V file");
+
+			image img{ elf.is_64() ? isa::RV64 : isa::RV32 };
+
+			const uint16_t type = elf.get<uint16_t>(0x10);
+			const uint64_t entry = elf.word(0x18);
+			const uint64_t program_headers = elf.word(elf.is_64() ? 0x20 : 0x1c);
+			const uint64_t section_headers = elf.word(elf.is_64() ? 0x28 : 0x20);
+			const uint16_t program_header_size = elf.get<uint16_t>(elf.is_64() ? 0x36 : 0x2a);
+			const uint16_t program_header_count = elf.get<uint16_t>(elf.is_64() ? 0x38 : 0x2c);
+			const uint16_t section_header_size = elf.get<uint16_t>(elf.is_64() ? 0x3a : 0x2e);
+			const uint16_t section_header_count = elf.get<uint16_t>(elf.is_64() ? 0x3c : 0x30);
+			const uint16_t section_names = elf.get<uint16_t>(elf.is_64() ? 0x3e : 0x32);
+
+			std::vector<section_header> sections;
+			for (uint16_t i = 0; section_headers && i < section_header_count; i++)
+				sections.push_back(elf.section(section_headers + static_cast<uint64_t>(i) * section_header_size));
+
+			//Where each section ended up, relocatable objects don't have addresses of their own
+			std::vector<uint64_t> section_addresses(sections.size(), 0);
+			uint64_t next_address = 0;
+			bool mapped = false;
+
+			for (size_t i = 0; i < sections.size(); i++)
+			{
+				const section_header& section = sections[i];
+
+				if (!(section.flags & shf_alloc))
+					continue;
+
+				uint64_t address = section.address;
+
+				if (type == et_rel) {
+					const uint64_t alignment = section.alignment ? section.alignment : 1;
+					address = (next_address + alignment - 1) / alignment * alignment;
+					next_address = address + section.size;
+				}
+
+				section_addresses[i] = address;
+
+				if (section.type == sht_nobits || !section.size)
+					continue;
+
+				if (section.offset > bytes.size() || bytes.size() - section.offset < section.size)
+					throw std::runtime_error("elf: section extends past the end of the file");
+
+				std::string name{ section_names < sections.size() ? elf.string(sections[section_names], section.name) : std::string_view{} };
+				img.add_segment(segment{ address, bytes.data() + section.offset, static_cast<size_t>(section.size), (section.flags & shf_execinstr) != 0, (section.flags & shf_write) != 0, name });
+				mapped = true;
+			}
+
+			//Stripped of section headers, fall back to what the loader would map
+			for (uint16_t i = 0; !mapped && program_headers && i < program_header_count; i++)
+			{
+				const uint64_t header = program_headers + static_cast<uint64_t>(i) * program_header_size;
+
+				if (elf.get<uint32_t>(header) != pt_load)
+					continue;
+
+				const uint32_t flags = elf.is_64() ? elf.get<uint32_t>(header + 4) : elf.get<uint32_t>(header + 24);
+				const uint64_t offset = elf.is_64() ? elf.get<uint64_t>(header + 8) : elf.get<uint32_t>(header + 4);
+				const uint64_t address = elf.is_64() ? elf.get<uint64_t>(header + 16) : elf.get<uint32_t>(header + 8);
+				const uint64_t size = elf.is_64() ? elf.get<uint64_t>(header + 32) : elf.get<uint32_t>(header + 16);
+
+				if (!size)
+					continue;
+
+				if (offset > bytes.size() || bytes.size() - offset < size)
+					throw std::runtime_error("elf: segment extends past the end of the file");
+
+				img.add_segment(segment{ address, bytes.data() + offset, static_cast<size_t>(size), (flags & pf_x) != 0, (flags & pf_w) != 0, "LOAD" });
+			}
+
+			for (auto& table : sections)
+			{
+				if ((table.type != sht_symtab && table.type != sht_dynsym) || table.link >= sections.size())
+					continue;
+
+				const uint64_t symbol_size = elf.is_64() ? 24 : 16;
+
+				for (uint64_t offset = symbol_size; offset + symbol_size <= table.size; offset += symbol_size)
+				{
+					const uint64_t at = table.offset + offset;
+
+					const uint32_t name = elf.get<uint32_t>(at);
+					const uint8_t info = elf.get<uint8_t>(at + (elf.is_64() ? 4 : 12));
+					const uint16_t index = elf.get<uint16_t>(at + (elf.is_64() ? 6 : 14));
+					const uint64_t value = elf.is_64() ? elf.get<uint64_t>(at + 8) : elf.get<uint32_t>(at + 4);
+					const uint64_t size = elf.is_64() ? elf.get<uint64_t>(at + 16) : elf.get<uint32_t>(at + 8);
+					const uint8_t kind = info & 0xf;
+
+					if (index == shn_undef || index >= shn_loreserve || index >= sections.size() || kind == stt_section || kind == stt_file)
+						continue;
+
+					const std::string_view symbol_name = elf.string(sections[table.link], name);
+					if (is_noise(symbol_name))
+						continue;
+
+					const uint64_t address = type == et_rel ? section_addresses[index] + value : value;
+					img.add_symbol(symbol{ address, size, symbol_name, kind == stt_func });
+				}
+			}
+
+			//Relocatable objects get their relocations applied against the layout above, so calls and address
+			//loads show where they really go. Undefined symbols get made up addresses past the last section
+			if (type == et_rel) {
+				const uint64_t symbol_size = elf.is_64() ? 24 : 16;
+				uint64_t next_extern = (next_address + 0xf) & ~0xfull;
+				std::unordered_map<uint64_t, uint64_t> externs;
+
+				auto symbol_value = [&](const section_header& table, const uint32_t entry) -> std::optional<uint64_t>
+				{
+					const uint64_t at = table.offset + static_cast<uint64_t>(entry) * symbol_size;
+					if (!entry || (static_cast<uint64_t>(entry) + 1) * symbol_size > table.size)
+						return std::nullopt;
+
+					const uint16_t index = elf.get<uint16_t>(at + (elf.is_64() ? 6 : 14));
+					const uint64_t value = elf.is_64() ? elf.get<uint64_t>(at + 8) : elf.get<uint32_t>(at + 4);
+
+					if (index != shn_undef && index < sections.size())
+						return section_addresses[index] + value;
+
+					if (index != shn_undef)
+						return value;
+
+					auto [found, inserted] = externs.try_emplace(at, next_extern);
+					if (inserted) {
+						const uint32_t name = elf.get<uint32_t>(at);
+						const std::string_view symbol_name = table.link < sections.size() ? elf.string(sections[table.link], name) : std::string_view{};
+
+						if (!symbol_name.empty())
+							img.add_symbol(symbol{ next_extern, 0, symbol_name, false });
+
+						next_extern += 0x10;
+					}
+
+					return found->second;
+				};
+
+				for (auto& table : sections)
+				{
+					if (table.type != sht_rela || table.info >= sections.size() || table.link >= sections.size())
+						continue;
+
+					const section_header& target = sections[table.info];
+					const section_header& symbols = sections[table.link];
+
+					if (!(target.flags & shf_alloc) || target.type == sht_nobits)
+						continue;
+
+					const uint64_t entry_size = elf.is_64() ? 24 : 12;
+					std::vector<relocation> relocations;
+
+					for (uint64_t offset = 0; offset + entry_size <= table.size; offset += entry_size)
+					{
+						const uint64_t at = table.offset + offset;
+
+						if (elf.is_64()) {
+							const uint64_t info = elf.get<uint64_t>(at + 8);
+							relocations.push_back({ elf.get<uint64_t>(at), static_cast<uint32_t>(info >> 32), static_cast<uint32_t>(info), elf.get<int64_t>(at + 16) });
+						} else {
+							const uint32_t info = elf.get<uint32_t>(at + 4);
+							relocations.push_back({ elf.get<uint32_t>(at), info >> 8, info & 0xff, elf.get<int32_t>(at + 8) });
+						}
+					}
+
+					//pcrel_lo12 points at the auipc, not at the symbol, so the auipc's value has to be known first
+					std::unordered_map<uint64_t, uint64_t> high_parts;
+
+					for (auto& reloc : relocations)
+					{
+						if (reloc.type != r_riscv_pcrel_hi20)
+							continue;
+
+						if (auto value = symbol_value(symbols, reloc.symbol)) {
+							const uint64_t place = section_addresses[table.info] + reloc.offset;
+							high_parts[place] = *value + reloc.addend - place;
+						}
+					}
+
+					for (auto& reloc : relocations)
+					{
+						if (reloc.offset > target.size || target.size - reloc.offset < patch_size(reloc.type))
+							continue;
+
+						auto value = symbol_value(symbols, reloc.symbol);
+						if (!value && reloc.symbol)
+							continue;
+
+						uint8_t* at = bytes.data() + target.offset + reloc.offset;
+						const uint64_t place = section_addresses[table.info] + reloc.offset;
+						const uint64_t absolute = value.value_or(0) + reloc.addend;
+						const uint64_t relative = absolute - place;
+
+						switch (reloc.type)
+						{
+						case r_riscv_32: poke(at, static_cast<uint32_t>(absolute)); break;
+						case r_riscv_64: poke(at, absolute); break;
+						case r_riscv_32_pcrel: poke(at, static_cast<uint32_t>(relative)); break;
+
+						case r_riscv_branch: poke(at, with_branch(peek<uint32_t>(at), relative)); break;
+						case r_riscv_jal: poke(at, with_jal(peek<uint32_t>(at), relative)); break;
+						case r_riscv_rvc_branch: poke(at, with_rvc_branch(peek<uint16_t>(at), relative)); break;
+						case r_riscv_rvc_jump: poke(at, with_rvc_jump(peek<uint16_t>(at), relative)); break;
+
+						case r_riscv_call:
+						case r_riscv_call_plt:
+							poke(at, with_hi20(peek<uint32_t>(at), relative));
+							poke(at + 4, with_lo12_i(peek<uint32_t>(at + 4), relative));
+							break;
+
+						case r_riscv_pcrel_hi20: poke(at, with_hi20(peek<uint32_t>(at), relative)); break;
+						case r_riscv_hi20: poke(at, with_hi20(peek<uint32_t>(at), absolute)); break;
+						case r_riscv_lo12_i: poke(at, with_lo12_i(peek<uint32_t>(at), absolute)); break;
+						case r_riscv_lo12_s: poke(at, with_lo12_s(peek<uint32_t>(at), absolute)); break;
+
+						case r_riscv_pcrel_lo12_i:
+						case r_riscv_pcrel_lo12_s: {
+							auto high = high_parts.find(value.value_or(0));
+							if (high == high_parts.end())
+								break;
+
+							if (reloc.type == r_riscv_pcrel_lo12_i)
+								poke(at, with_lo12_i(peek<uint32_t>(at), high->second));
+							else
+								poke(at, with_lo12_s(peek<uint32_t>(at), high->second));
+							break;
+						}
+
+						case r_riscv_add8: poke(at, static_cast<uint8_t>(peek<uint8_t>(at) + absolute)); break;
+						case r_riscv_add16: poke(at, static_cast<uint16_t>(peek<uint16_t>(at) + absolute)); break;
+						case r_riscv_add32: poke(at, static_cast<uint32_t>(peek<uint32_t>(at) + absolute)); break;
+						case r_riscv_add64: poke(at, peek<uint64_t>(at) + absolute); break;
+						case r_riscv_sub8: poke(at, static_cast<uint8_t>(peek<uint8_t>(at) - absolute)); break;
+						case r_riscv_sub16: poke(at, static_cast<uint16_t>(peek<uint16_t>(at) - absolute)); break;
+						case r_riscv_sub32: poke(at, static_cast<uint32_t>(peek<uint32_t>(at) - absolute)); break;
+						case r_riscv_sub64: poke(at, peek<uint64_t>(at) - absolute); break;
+						case r_riscv_set8: poke(at, static_cast<uint8_t>(absolute)); break;
+						case r_riscv_set16: poke(at, static_cast<uint16_t>(absolute)); break;
+						case r_riscv_set32: poke(at, static_cast<uint32_t>(absolute)); break;
+
+						default:
+							break;
+						}
+					}
+				}
+			}
+
+			if (type != et_rel)
+				img.set_entry_point(entry);
+
+			img.add_storage(std::move(storage));
+			return img;
+		}
+
+		image load(const std::string& path)
+		{
+			return load(read_file(path));
+		}
+	}
+}
\ No newline at end of file
@@ -15,7 +15,20 @@
 //	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
 #pragma once
 
-namespace elf
+#include "image.hpp"
+
+namespace riscv
 {
+	namespace elf
+	{
+		constexpr uint16_t machine_riscv = 243;
+
+		bool is_elf(const std::vector<uint8_t>& file);
 
+		//Throws std::runtime_error on anything that isn't a well formed little endian RISC-V ELF.
+		//Executables are mapped by section, relocatable objects get their sections laid out one after the other from address 0
+		//and their relocations applied to that layout
+		image load(std::vector<uint8_t>&& file);
+		image load(const std::string& path);
+	}
 }
\ No newline at end of file
@@ -0,0 +1,394 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "firmware.hpp"
+#include "elf.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace riscv
+{
+	namespace
+	{
+		//0-15 for hex digits, 0x80 for anything else so a whole record's worth can be or'd together and checked once
+		constexpr std::array<uint8_t, 256> hex_digits = []
+		{
+			std::array<uint8_t, 256> table{};
+			table.fill(0x80);
+
+			for (int i = 0; i < 10; i++)
+				table['0' + i] = static_cast<uint8_t>(i);
+
+			for (int i = 0; i < 6; i++)
+			{
+				table['a' + i] = static_cast<uint8_t>(10 + i);
+				table['A' + i] = static_cast<uint8_t>(10 + i);
+			}
+
+			return table;
+		}();
+
+		//Decodes count bytes worth of digit pairs, bit 0x80 of the result says whether any of them weren't hex
+		uint8_t decode_hex(const uint8_t* text, uint8_t* out, const size_t count, uint32_t& sum)
+		{
+			uint8_t invalid = 0;
+
+			for (size_t i = 0; i < count; i++)
+			{
+				const uint8_t high = hex_digits[text[2 * i]];
+				const uint8_t low = hex_digits[text[2 * i + 1]];
+
+				invalid |= high | low;
+				out[i] = static_cast<uint8_t>((high << 4) | (low & 0x0f));
+				sum += out[i];
+			}
+
+			return invalid & 0x80;
+		}
+
+		const uint8_t* skip_space(const uint8_t* at, const uint8_t* end, size_t& line)
+		{
+			while (at < end && (*at == ' ' || *at == '\t' || *at == '\r' || *at == '\n'))
+				line += *at++ == '\n';
+
+			return at;
+		}
+
+		[[noreturn]] void bad_record(const char* format, const size_t line, const char* problem)
+		{
+			throw std::runtime_error(std::string{ format } + ": line " + std::to_string(line) + ": " + problem);
+		}
+
+		//Collects record data into runs of consecutive bytes, each run ends up as one segment
+		class span_builder
+		{
+			struct run
+			{
+				uint64_t address;
+				//Order in the file, only records that follow on from each other share a run
+				size_t sequence;
+				std::shared_ptr<std::vector<uint8_t>> bytes;
+			};
+
+			std::vector<run> m_runs;
+
+		public:
+			void add(const uint64_t address, const uint8_t* data, const size_t size)
+			{
+				if (m_runs.empty() || m_runs.back().address + m_runs.back().bytes->size() != address)
+					m_runs.push_back(run{ address, m_runs.size(), std::make_shared<std::vector<uint8_t>>() });
+
+				auto& bytes = *m_runs.back().bytes;
+				bytes.insert(bytes.end(), data, data + size);
+			}
+
+			void finish(image& img, const load_options& options);
+		};
+
+		//Splits a span along the load map, or adds it as code when there isn't one
+		void add_span(image& img, const uint64_t address, const uint8_t* data, const size_t size, const std::shared_ptr<const void>& storage, const load_options& options)
+		{
+			if (options.regions.empty()) {
+				img.add_segment(segment{ address, data, size, true, false, "code" }, storage);
+				return;
+			}
+
+			uint64_t at = address;
+			const uint64_t end = address + size;
+
+			while (at < end)
+			{
+				//Region covering at, or where the next one starts
+				const load_region* covering = nullptr;
+				uint64_t next = end;
+
+				for (auto& region : options.regions)
+				{
+					if (at >= region.begin && at < region.end) {
+						covering = &region;
+						break;
+					}
+
+					if (region.begin > at && region.begin < next)
+						next = region.begin;
+				}
+
+				const uint64_t stop = covering ? std::min(end, covering->end) : next;
+				const size_t offset = static_cast<size_t>(at - address);
+
+				if (covering)
+					img.add_segment(segment{ at, data + offset, static_cast<size_t>(stop - at), covering->executable, covering->writable, covering->name }, storage);
+				else
+					img.add_segment(segment{ at, data + offset, static_cast<size_t>(stop - at), false, false, "unmapped" }, storage);
+
+				at = stop;
+			}
+		}
+
+		void span_builder::finish(image& img, const load_options& options)
+		{
+			//Records don't have to come in address order. Runs that touch or overlap get put together into one span,
+			//copied in file order so later records win where they overlap
+			std::sort(m_runs.begin(), m_runs.end(), [](const run& left, const run& right) { return left.address < right.address; });
+
+			for (size_t first = 0; first < m_runs.size();)
+			{
+				uint64_t end = m_runs[first].address + m_runs[first].bytes->size();
+				size_t last = first + 1;
+
+				for (; last < m_runs.size() && m_runs[last].address <= end; last++)
+					end = std::max(end, m_runs[last].address + m_runs[last].bytes->size());
+
+				const uint64_t address = m_runs[first].address;
+				std::shared_ptr<std::vector<uint8_t>> bytes = m_runs[first].bytes;
+
+				if (last - first > 1) {
+					std::sort(m_runs.begin() + first, m_runs.begin() + last, [](const run& left, const run& right) { return left.sequence < right.sequence; });
+
+					bytes = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(end - address));
+
+					for (size_t i = first; i < last; i++)
+						std::copy(m_runs[i].bytes->begin(), m_runs[i].bytes->end(), bytes->begin() + static_cast<size_t>(m_runs[i].address - address));
+				}
+
+				add_span(img, address, bytes->data(), bytes->size(), bytes, options);
+				first = last;
+			}
+
+			m_runs.clear();
+		}
+	}
+
+	std::vector<load_region> read_load_map(const std::string& path)
+	{
+		std::ifstream file{ path };
+
+		if (!file)
+			throw std::runtime_error("can't open " + path);
+
+		std::vector<load_region> regions;
+		std::string line;
+
+		for (size_t number = 1; std::getline(file, line); number++)
+		{
+			line = line.substr(0, line.find('#'));
+
+			std::istringstream words{ line };
+			std::string kind;
+			std::string begin;
+			std::string end;
+
+			if (!(words >> kind))
+				continue;
+
+			if (!(words >> begin >> end) || (kind != "code" && kind != "data" && kind != "rodata"))
+				throw std::runtime_error(path + ": line " + std::to_string(number) + ": expected code|data|rodata <begin> <end> [name]");
+
+			load_region region{ std::stoull(begin, nullptr, 16), std::stoull(end, nullptr, 16), kind == "code", kind == "data", kind };
+			words >> region.name;
+
+			if (region.end <= region.begin)
+				throw std::runtime_error(path + ": line " + std::to_string(number) + ": empty region");
+
+			regions.push_back(std::move(region));
+		}
+
+		return regions;
+	}
+
+	namespace firmware
+	{
+		bool is_intel_hex(const uint8_t* data, const size_t size)
+		{
+			size_t line = 1;
+			const uint8_t* at = skip_space(data, data + size, line);
+			return data + size - at >= 3 && at[0] == ':' && !((hex_digits[at[1]] | hex_digits[at[2]]) & 0x80);
+		}
+
+		bool is_srecord(const uint8_t* data, const size_t size)
+		{
+			size_t line = 1;
+			const uint8_t* at = skip_space(data, data + size, line);
+			return data + size - at >= 4 && at[0] == 'S' && at[1] >= '0' && at[1] <= '9' && !((hex_digits[at[2]] | hex_digits[at[3]]) & 0x80);
+		}
+
+		image load_intel_hex(const uint8_t* data, const size_t size, const load_options& options)
+		{
+			image img{ options.arch };
+			span_builder spans;
+
+			const uint8_t* at = data;
+			const uint8_t* end = data + size;
+
+			uint64_t upper = 0;
+			size_t line = 1;
+			uint8_t record[5 + 255];
+
+			while ((at = skip_space(at, end, line)) < end)
+			{
+				if (*at != ':')
+					bad_record("hex", line, "record doesn't start with ':'");
+
+				//Length first, it says how much is left of the record
+				uint32_t sum = 0;
+
+				if (end - at < 3 || decode_hex(at + 1, record, 1, sum))
+					bad_record("hex", line, "bad record length");
+
+				const size_t length = 5 + record[0];
+
+				if (static_cast<size_t>(end - at - 1) < 2 * length || decode_hex(at + 3, record + 1, length - 1, sum))
+					bad_record("hex", line, "truncated or not hex");
+
+				if (sum & 0xff)
+					bad_record("hex", line, "checksum mismatch");
+
+				at += 1 + 2 * length;
+
+				const uint8_t count = record[0];
+				const uint16_t offset = static_cast<uint16_t>((record[1] << 8) | record[2]);
+				const uint8_t* payload = record + 4;
+
+				//Everything but data has a fixed size, a short one would otherwise read what the last record left behind
+				constexpr int fixed_counts[] = { -1, 0, 2, 4, 2, 4 };
+
+				if (record[3] < std::size(fixed_counts) && fixed_counts[record[3]] >= 0 && count != fixed_counts[record[3]])
+					bad_record("hex", line, "wrong length for the record type");
+
+				switch (record[3])
+				{
+				case 0x00:
+					spans.add(upper + offset, payload, count);
+					break;
+
+				case 0x01:
+					at = end;
+					break;
+
+				case 0x02: //Extended segment address, paragraph number
+					upper = static_cast<uint64_t>((payload[0] << 8) | payload[1]) << 4;
+					break;
+
+				case 0x03: //Start segment address, CS:IP
+					img.set_entry_point((static_cast<uint64_t>((payload[0] << 8) | payload[1]) << 4) + ((payload[2] << 8) | payload[3]));
+					break;
+
+				case 0x04: //Extended linear address, upper 16 bits
+					upper = static_cast<uint64_t>((payload[0] << 8) | payload[1]) << 16;
+					break;
+
+				case 0x05:
+					img.set_entry_point((static_cast<uint64_t>(payload[0]) << 24) | (payload[1] << 16) | (payload[2] << 8) | payload[3]);
+					break;
+
+				default:
+					bad_record("hex", line, "unknown record type");
+				}
+			}
+
+			spans.finish(img, options);
+			return img;
+		}
+
+		image load_srecord(const uint8_t* data, const size_t size, const load_options& options)
+		{
+			image img{ options.arch };
+			span_builder spans;
+
+			const uint8_t* at = data;
+			const uint8_t* end = data + size;
+
+			size_t line = 1;
+			uint8_t record[1 + 255];
+
+			while ((at = skip_space(at, end, line)) < end)
+			{
+				if (end - at < 4 || at[0] != 'S' || at[1] < '0' || at[1] > '9')
+					bad_record("srec", line, "record doesn't start with S and a type");
+
+				const uint8_t type = at[1] - '0';
+				uint32_t sum = 0;
+
+				if (decode_hex(at + 2, record, 1, sum))
+					bad_record("srec", line, "bad record length");
+
+				const size_t length = record[0];
+
+				if (static_cast<size_t>(end - at - 4) < 2 * length || decode_hex(at + 4, record + 1, length, sum))
+					bad_record("srec", line, "truncated or not hex");
+
+				if ((sum & 0xff) != 0xff)
+					bad_record("srec", line, "checksum mismatch");
+
+				at += 4 + 2 * length;
+
+				//S1/S9 have 16 bit addresses, S2/S8 24 and S3/S7 32
+				const size_t address_size = type == 1 || type == 9 ? 2 : type == 2 || type == 8 ? 3 : type == 3 || type == 7 ? 4 : 0;
+
+				if (!address_size)
+					continue; //Header and record counts
+
+				if (length < address_size + 1)
+					bad_record("srec", line, "record too short for its address");
+
+				uint64_t address = 0;
+
+				for (size_t i = 0; i < address_size; i++)
+					address = (address << 8) | record[1 + i];
+
+				if (type <= 3)
+					spans.add(address, record + 1 + address_size, length - address_size - 1);
+				else
+					img.set_entry_point(address);
+			}
+
+			spans.finish(img, options);
+			return img;
+		}
+
+		image load_binary(const uint8_t* data, const size_t size, std::shared_ptr<const void> storage, const load_options& options)
+		{
+			image img{ options.arch };
+
+			if (size)
+				add_span(img, options.base, data, size, storage, options);
+
+			return img;
+		}
+	}
+
+	image load_image(const std::string& path, const load_options& options)
+	{
+		auto mapping = std::make_shared<file_mapping>(path);
+
+		const uint8_t* data = mapping->data();
+		const size_t size = mapping->size();
+
+		if (size >= 4 && std::memcmp(data, "\x7f" "ELF", 4) == 0)
+			return elf::load(std::vector<uint8_t>{ data, data + size });
+
+		if (firmware::is_intel_hex(data, size))
+			return firmware::load_intel_hex(data, size, options);
+
+		if (firmware::is_srecord(data, size))
+			return firmware::load_srecord(data, size, options);
+
+		return firmware::load_binary(data, size, std::move(mapping), options);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "image.hpp"
+
+namespace riscv
+{
+	//Part of the address space and what it holds, for inputs that don't say themselves
+	struct load_region
+	{
+		uint64_t begin;
+		uint64_t end;
+		bool executable;
+		bool writable;
+		std::string name;
+	};
+
+	struct load_options
+	{
+		isa arch = isa::RV64;
+
+		//Where a flat binary starts
+		uint64_t base = 0;
+
+		//Empty means everything is code, otherwise bytes outside every region are read only data
+		std::vector<load_region> regions;
+	};
+
+	//One region per line, "code|data|rodata <hex begin> <hex end> [name]", end exclusive, # starts a comment.
+	//Throws std::runtime_error with the line number for anything else
+	std::vector<load_region> read_load_map(const std::string& path);
+
+	namespace firmware
+	{
+		bool is_intel_hex(const uint8_t* data, const size_t size);
+		bool is_srecord(const uint8_t* data, const size_t size);
+
+		//Both parse straight off the buffer a record at a time. Consecutive records are collected into one
+		//segment, the start address record becomes the entry point. Throws std::runtime_error with the line
+		//number on malformed records and bad checksums
+		image load_intel_hex(const uint8_t* data, const size_t size, const load_options& options);
+		image load_srecord(const uint8_t* data, const size_t size, const load_options& options);
+
+		//data is used in place, storage is whatever keeps it alive
+		image load_binary(const uint8_t* data, const size_t size, std::shared_ptr<const void> storage, const load_options& options);
+	}
+
+	//ELF, Intel HEX, S-record or flat binary, told apart by content. The options only apply to the formats
+	//that don't carry that information themselves
+	image load_image(const std::string& path, const load_options& options = {});
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "functions.hpp"
+#include "analysis.hpp"
+#include "discovery.hpp"
+#include <algorithm>
+#include <sstream>
+
+namespace riscv
+{
+	namespace analysis
+	{
+		namespace
+		{
+			//Linear sweep over the bytes discovery didn't reach, decoding is in sync as long as the gap starts on an instruction
+			void scan_gap(const image& img, uint64_t address, const uint64_t end, std::vector<uint64_t>& starts)
+			{
+				while (address < end)
+				{
+					auto low = img.read_value<uint16_t>(address);
+					if (!low)
+						return;
+
+					uint32_t raw = *low;
+
+					if ((raw & 0x3) == 0x3) {
+						auto high = img.read_value<uint16_t>(address + 2);
+						if (!high)
+							return;
+
+						raw |= static_cast<uint32_t>(*high) << 16;
+					}
+
+					const instruction::object instruction{ raw, img.get_architecture() };
+
+					if (is_prologue(instruction))
+						starts.push_back(address);
+
+					address += instruction.get_length();
+				}
+			}
+
+			void unique(std::vector<uint64_t>& starts)
+			{
+				std::sort(starts.begin(), starts.end());
+				starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+			}
+		}
+
+		bool is_prologue(const instruction::object& instruction)
+		{
+			const uint32_t expanded = instruction.get_expanded();
+
+			//addi, rd = rs1 = sp
+			return (expanded & 0xfffff) == 0x10113 && instruction.get_immediate() < 0;
+		}
+
+		std::vector<function> find_functions(const image& img, const std::vector<uint64_t>& entry_points)
+		{
+			std::vector<uint64_t> starts = entry_points;
+
+			if (auto entry = img.get_entry_point())
+				starts.push_back(*entry);
+
+			for (auto& sym : img.get_symbols())
+			{
+				if (sym.function && img.is_code(sym.address))
+					starts.push_back(sym.address);
+			}
+
+			//Code sections start with a function, and in objects or raw images that is often all there is to go on
+			for (auto& seg : img.get_segments())
+			{
+				if (seg.executable)
+					starts.push_back(seg.address);
+			}
+
+			unique(starts);
+
+			auto discovery = std::make_unique<code_discovery>(img, starts);
+			starts.insert(starts.end(), discovery->get_call_targets().begin(), discovery->get_call_targets().end());
+
+			//Functions only reached through pointers still set up a frame, look for that in the gaps
+			const size_t before_gaps = starts.size();
+
+			for (auto& seg : img.get_segments())
+			{
+				if (!seg.executable)
+					continue;
+
+				auto& addresses = discovery->get_addresses();
+				auto& instructions = discovery->get_instructions();
+
+				auto current = std::lower_bound(addresses.begin(), addresses.end(), seg.address);
+				uint64_t gap = seg.address;
+
+				for (; current != addresses.end() && seg.contains(*current); ++current)
+				{
+					if (*current > gap)
+						scan_gap(img, gap, *current, starts);
+
+					gap = *current + instructions[current - addresses.begin()].get_length();
+				}
+
+				if (gap < seg.address + seg.size)
+					scan_gap(img, gap, seg.address + seg.size, starts);
+			}
+
+			if (starts.size() != before_gaps) {
+				unique(starts);
+				discovery = std::make_unique<code_discovery>(img, starts);
+				starts.insert(starts.end(), discovery->get_call_targets().begin(), discovery->get_call_targets().end());
+			}
+
+			starts.erase(std::remove_if(starts.begin(), starts.end(), [&img](const uint64_t address) { return (address & 1) || !img.is_code(address); }), starts.end());
+			unique(starts);
+
+			auto& addresses = discovery->get_addresses();
+			auto& instructions = discovery->get_instructions();
+			auto& symbols = img.get_symbols();
+
+			std::vector<function> functions;
+			functions.reserve(starts.size());
+
+			for (size_t i = 0; i < starts.size(); i++)
+			{
+				const uint64_t begin = starts[i];
+				const segment* seg = img.find_segment(begin);
+
+				uint64_t limit = seg->address + seg->size;
+
+				if (i + 1 < starts.size())
+					limit = std::min(limit, starts[i + 1]);
+
+				//Prefer a function symbol, but hand written assembly usually only has plain labels
+				auto first = std::lower_bound(symbols.begin(), symbols.end(), begin, [](const symbol& s, const uint64_t address) { return s.address < address; });
+				auto sym = std::find_if(first, symbols.end(), [begin](const symbol& s) { return s.address != begin || s.function; });
+
+				if (sym == symbols.end() || sym->address != begin)
+					sym = first;
+
+				const bool named = sym != symbols.end() && sym->address == begin;
+
+				if (named && sym->size)
+					limit = std::min(limit, begin + sym->size);
+
+				//Last reachable instruction before the limit, the listing still covers everything up to it
+				uint64_t end = limit;
+				auto last = std::lower_bound(addresses.begin(), addresses.end(), limit);
+
+				if (last != addresses.begin() && *(last - 1) >= begin)
+					end = *(last - 1) + instructions[last - 1 - addresses.begin()].get_length();
+
+				std::string name;
+
+				if (named) {
+					name = sym->name;
+				} else {
+					std::ostringstream generated;
+					generated << "sub_" << std::hex << begin;
+					name = generated.str();
+				}
+
+				functions.push_back({ begin, limit, std::min(end, limit), std::move(name) });
+			}
+
+			return functions;
+		}
+	}
+}
\ No newline at end of file
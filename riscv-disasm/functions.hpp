@@ -0,0 +1,42 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "image.hpp"
+
+namespace riscv
+{
+	namespace analysis
+	{
+		struct function
+		{
+			uint64_t begin;
+			//Everything up to the symbol size (or the next start), what gets listed
+			uint64_t end;
+			//End of the last instruction discovery reached, what analysis looks at so padding and inline data stay out
+			uint64_t reachable_end;
+			std::string name;
+		};
+
+		//addi sp, sp, -N in any of its forms (c.addi16sp and c.addi sp expand to it)
+		bool is_prologue(const instruction::object& instruction);
+
+		//Starts come from function symbols, the entry point and the start of every code section, then from call targets
+		//and stack frame setups found in code nothing else reaches. A function ends at its symbol size, or at the next start
+		//if it has none, with the last reachable instruction before that kept separately. Sorted by address
+		std::vector<function> find_functions(const image& img, const std::vector<uint64_t>& entry_points = {});
+	}
+}
\ No newline at end of file
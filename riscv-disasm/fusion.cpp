@@ -0,0 +1,212 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "fusion.hpp"
+#include "analysis.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+namespace riscv
+{
+	namespace analysis
+	{
+		namespace
+		{
+			constexpr const char* fusion_names[] = { "lui_addi", "auipc_addi", "auipc_jalr", "zero_extend", "load_pair" };
+
+			struct fields
+			{
+				uint32_t opcode;
+				uint32_t rd;
+				uint32_t funct3;
+				uint32_t rs1;
+				uint32_t upper;
+				int64_t imm;
+			};
+
+			fields decode(const instruction::object& instruction)
+			{
+				const uint32_t expanded = instruction.get_expanded();
+				return { expanded & 0x7f, (expanded >> 7) & 0x1f, (expanded >> 12) & 0x7, (expanded >> 15) & 0x1f, expanded >> 26, instruction.get_immediate() };
+			}
+
+			//The second instruction has to consume the first one's result and overwrite it, otherwise the pair
+			//still has two architectural results and the core can't fuse it
+			std::optional<fusion_kind> match(const fields& a, const fields& b, const isa arch)
+			{
+				const bool addi = b.opcode == 0x13 && b.funct3 == 0;
+				const bool addiw = b.opcode == 0x1b && b.funct3 == 0;
+				const bool chained = a.rd != 0 && b.rs1 == a.rd && b.rd == a.rd;
+
+				if (a.opcode == 0x37 && (addi || addiw) && chained)
+					return fusion_kind::lui_addi;
+
+				if (a.opcode == 0x17 && addi && chained)
+					return fusion_kind::auipc_addi;
+
+				//Calls overwrite ra and not the auipc temporary, tail calls don't write anything
+				if (a.opcode == 0x17 && b.opcode == 0x67 && a.rd != 0 && b.rs1 == a.rd && (b.rd == a.rd || b.rd == 0 || b.rd == 1))
+					return fusion_kind::auipc_jalr;
+
+				//slli rd, rs, n then srli rd, rd, n
+				const uint32_t shamt_mask = arch == isa::RV32 ? 0x1f : 0x3f;
+				if (a.opcode == 0x13 && a.funct3 == 1 && b.opcode == 0x13 && b.funct3 == 5 && b.upper == 0 && chained && (a.imm & shamt_mask) == (b.imm & shamt_mask))
+					return fusion_kind::zero_extend;
+
+				//Same width loads from neighbouring slots off one base, the base must survive the first one
+				if (a.opcode == b.opcode && (a.opcode == 0x03 || a.opcode == 0x07) && a.funct3 == b.funct3 && (a.funct3 & 3) >= 2 && a.rs1 == b.rs1) {
+					const int64_t width = int64_t{ 1 } << (a.funct3 & 3);
+					const bool integer = a.opcode == 0x03;
+
+					if (b.imm - a.imm == width && !(integer && (a.rd == a.rs1 || a.rd == b.rd)))
+						return fusion_kind::load_pair;
+				}
+
+				return std::nullopt;
+			}
+
+			std::string coverage(const size_t fused, const size_t total)
+			{
+				std::ostringstream out;
+				out << std::fixed << std::setprecision(1) << (total ? 100.0 * 2 * fused / total : 0.0) << "%";
+				return out.str();
+			}
+		}
+
+		const char* fusion_name(const fusion_kind kind)
+		{
+			return fusion_names[static_cast<size_t>(kind)];
+		}
+
+		uint32_t parse_fusion_set(const std::string& names)
+		{
+			if (names == "all")
+				return all_fusions;
+
+			uint32_t enabled = 0;
+			std::istringstream list{ names };
+			std::string name;
+
+			while (std::getline(list, name, ','))
+			{
+				auto found = std::find_if(std::begin(fusion_names), std::end(fusion_names), [&name](const char* other) { return name == other; });
+
+				if (found == std::end(fusion_names))
+					throw std::invalid_argument("unknown fusion pair " + name);
+
+				enabled |= 1u << (found - std::begin(fusion_names));
+			}
+
+			return enabled;
+		}
+
+		std::vector<fused_pair> find_fused_pairs(const std::vector<instruction::object>& instructions, const std::vector<uint64_t>& addresses, const uint32_t enabled, const isa arch)
+		{
+			std::vector<fused_pair> pairs;
+
+			if (instructions.size() < 2)
+				return pairs;
+
+			const auto leaders = find_leaders(instructions, addresses, function_range{ 0, instructions.size() });
+			fields current = decode(instructions[0]);
+
+			for (size_t i = 0; i + 1 < instructions.size(); i++)
+			{
+				const fields next = decode(instructions[i + 1]);
+
+				if (!leaders[i + 1]) {
+					auto kind = match(current, next, arch);
+
+					if (kind && (enabled & (1u << static_cast<uint32_t>(*kind)))) {
+						pairs.push_back({ i, *kind });
+
+						if (i + 2 < instructions.size())
+							current = decode(instructions[i + 2]);
+
+						i++;
+						continue;
+					}
+				}
+
+				current = next;
+			}
+
+			return pairs;
+		}
+
+		void print_fusion_report(std::ostream& out, const std::string& name, const disassembler& code, const uint32_t enabled, const bool listing)
+		{
+			auto& instructions = code.get_decoded();
+			auto& addresses = code.get_addresses();
+			const auto pairs = find_fused_pairs(instructions, addresses, enabled, code.get_architecture());
+
+			size_t by_kind[static_cast<size_t>(fusion_kind::count)] = {};
+			for (auto& pair : pairs)
+				by_kind[static_cast<size_t>(pair.kind)]++;
+
+			out << name << ": " << std::dec << pairs.size() << " fused pairs in " << instructions.size() << " instructions (" << coverage(pairs.size(), instructions.size()) << " covered)";
+
+			for (size_t kind = 0; kind < static_cast<size_t>(fusion_kind::count); kind++)
+			{
+				if (by_kind[kind])
+					out << ", " << fusion_names[kind] << " " << by_kind[kind];
+			}
+
+			out << "\n";
+
+			//Loops are where fusion pays off, a backward branch closes one
+			for (size_t i = 0; i < instructions.size(); i++)
+			{
+				auto flow = classify(instructions[i], addresses[i]);
+
+				if (code.get_architecture() == isa::RV32)
+					flow.target &= 0xffffffff;
+
+				if ((flow.kind != flow_kind::branch && flow.kind != flow_kind::jump) || flow.target > addresses[i] || flow.target < addresses.front())
+					continue;
+
+				const size_t head = std::lower_bound(addresses.begin(), addresses.end(), flow.target) - addresses.begin();
+				const size_t fused = std::count_if(pairs.begin(), pairs.end(), [head, i](const fused_pair& pair) { return pair.first >= head && pair.first < i; });
+
+				out << "  loop 0x" << std::hex << addresses[head] << "-0x" << addresses[i] << ": " << std::dec << fused << " fused pairs in " << (i - head + 1) << " instructions (" << coverage(fused, i - head + 1) << " covered)\n";
+			}
+
+			if (!listing)
+				return;
+
+			auto pair = pairs.begin();
+
+			for (size_t i = 0; i < instructions.size(); i++)
+			{
+				out << "0x" << std::hex << addresses[i] << ": ";
+				code.format(out, instructions[i], addresses[i]);
+
+				if (pair != pairs.end() && pair->first == i) {
+					out << " + ";
+					code.format(out, instructions[i + 1], addresses[i + 1]);
+					out << " ; " << fusion_name(pair->kind);
+
+					++pair;
+					++i;
+				}
+
+				out << "\n";
+			}
+		}
+	}
+}
\ No newline at end of file
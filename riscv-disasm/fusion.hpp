@@ -0,0 +1,56 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "disassembler.hpp"
+
+namespace riscv
+{
+	namespace analysis
+	{
+		enum class fusion_kind : uint8_t
+		{
+			lui_addi,
+			auipc_addi,
+			auipc_jalr,
+			zero_extend,
+			load_pair,
+			count
+		};
+
+		constexpr uint32_t all_fusions = (1u << static_cast<uint32_t>(fusion_kind::count)) - 1;
+
+		const char* fusion_name(const fusion_kind kind);
+
+		//Comma separated names as fusion_name gives them, or "all". Throws std::invalid_argument on an unknown name
+		uint32_t parse_fusion_set(const std::string& names);
+
+		struct fused_pair
+		{
+			//Index of the first instruction, the second is right after it
+			size_t first;
+			fusion_kind kind;
+		};
+
+		//Adjacent pairs in the same basic block, taken greedily front to back so no instruction is in two pairs.
+		//enabled has bit n set for fusion_kind n
+		std::vector<fused_pair> find_fused_pairs(const std::vector<instruction::object>& instructions, const std::vector<uint64_t>& addresses, const uint32_t enabled, const isa arch);
+
+		//Coverage for the whole function and every loop in it (from a backward branch's target to the branch),
+		//optionally followed by the listing with fused pairs printed on one line
+		void print_fusion_report(std::ostream& out, const std::string& name, const disassembler& code, const uint32_t enabled, const bool listing);
+	}
+}
\ No newline at end of file
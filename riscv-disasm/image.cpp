@@ -0,0 +1,179 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "image.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace riscv
+{
+	std::vector<uint8_t> read_file(const std::string& path)
+	{
+		std::ifstream file{ path, std::ios::binary | std::ios::ate };
+
+		if (!file)
+			throw std::runtime_error("can't open " + path);
+
+		std::vector<uint8_t> bytes(static_cast<size_t>(file.tellg()));
+
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+
+		return bytes;
+	}
+
+	file_mapping::file_mapping(const std::string& path)
+	{
+#ifndef _WIN32
+		const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+		if (fd < 0)
+			throw std::runtime_error("can't open " + path);
+
+		struct stat info;
+
+		if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+			void* view = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+			if (view != MAP_FAILED) {
+				m_data = static_cast<const uint8_t*>(view);
+				m_size = static_cast<size_t>(info.st_size);
+				m_mapped = true;
+			}
+		}
+
+		::close(fd);
+
+		if (m_mapped)
+			return;
+#endif
+
+		m_bytes = read_file(path);
+		m_data = m_bytes.data();
+		m_size = m_bytes.size();
+	}
+
+	file_mapping::~file_mapping()
+	{
+#ifndef _WIN32
+		if (m_mapped)
+			::munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+	}
+
+	const uint8_t* file_mapping::data() const
+	{
+		return m_data;
+	}
+
+	size_t file_mapping::size() const
+	{
+		return m_size;
+	}
+
+	void image::add_segment(const segment& seg, std::shared_ptr<const void> storage)
+	{
+		auto position = std::upper_bound(m_segments.begin(), m_segments.end(), seg.address, [](const uint64_t address, const segment& other) { return address < other.address; });
+		m_segments.insert(position, seg);
+
+		if (storage)
+			m_storage.push_back(std::move(storage));
+	}
+
+	void image::add_segment(const uint64_t address, std::vector<uint8_t>&& bytes, const bool executable, const bool writable, const std::string& name)
+	{
+		auto owned = std::make_shared<const std::vector<uint8_t>>(std::move(bytes));
+		add_segment(segment{ address, owned->data(), owned->size(), executable, writable, name }, owned);
+	}
+
+	void image::add_storage(std::shared_ptr<const void> storage)
+	{
+		m_storage.push_back(std::move(storage));
+	}
+
+	void image::add_symbol(const symbol& sym)
+	{
+		auto position = std::upper_bound(m_symbols.begin(), m_symbols.end(), sym.address, [](const uint64_t address, const symbol& other) { return address < other.address; });
+		m_symbols.insert(position, symbol{ sym.address, sym.size, m_strings->store(sym.name), sym.function });
+	}
+
+	void image::set_entry_point(const uint64_t address)
+	{
+		m_entry_point = address;
+	}
+
+	const segment* image::find_segment(const uint64_t address) const
+	{
+		//Last segment starting at or before the address
+		auto found = std::upper_bound(m_segments.begin(), m_segments.end(), address, [](const uint64_t addr, const segment& seg) { return addr < seg.address; });
+
+		while (found != m_segments.begin())
+		{
+			--found;
+
+			//Segments can overlap (sections inside segments), so an earlier one might still cover it
+			if (found->contains(address))
+				return &*found;
+		}
+
+		return nullptr;
+	}
+
+	const std::vector<segment>& image::get_segments() const
+	{
+		return m_segments;
+	}
+
+	const std::vector<symbol>& image::get_symbols() const
+	{
+		return m_symbols;
+	}
+
+	const std::optional<uint64_t> image::get_entry_point() const
+	{
+		return m_entry_point;
+	}
+
+	const isa image::get_architecture() const
+	{
+		return m_architecture;
+	}
+
+	bool image::is_code(const uint64_t address) const
+	{
+		const segment* seg = find_segment(address);
+		return seg && seg->executable;
+	}
+
+	bool image::read(const uint64_t address, void* buffer, const size_t size) const
+	{
+		const segment* seg = find_segment(address);
+
+		if (!seg || seg->size - (address - seg->address) < size)
+			return false;
+
+		std::memcpy(buffer, seg->data + (address - seg->address), size);
+		return true;
+	}
+}
@@ -0,0 +1,123 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "arena.hpp"
+#include "instructions.hpp"
+#include <memory>
+#include <optional>
+
+namespace riscv
+{
+	//A loaded program: address tagged spans of bytes, whatever file format they came from
+	struct segment
+	{
+		uint64_t address;
+		const uint8_t* data;
+		size_t size;
+		bool executable;
+		bool writable;
+		std::string name;
+
+		bool contains(const uint64_t addr) const
+		{
+			return addr >= address && addr - address < size;
+		}
+	};
+
+	struct symbol
+	{
+		uint64_t address;
+		uint64_t size;
+		//Interned into the image, only has to live until add_symbol returns when handed in
+		std::string_view name;
+		bool function;
+	};
+
+	//Whole file in one read, throws std::runtime_error when it can't be opened
+	std::vector<uint8_t> read_file(const std::string& path);
+
+	//Whole file read only, memory mapped where the platform allows it so only the pages that get used are read.
+	//Falls back to read_file, throws std::runtime_error when it can't be opened
+	class file_mapping
+	{
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+		bool m_mapped = false;
+		std::vector<uint8_t> m_bytes;
+
+	public:
+		file_mapping() = delete;
+		file_mapping(const file_mapping& mapping) = delete;
+		file_mapping(file_mapping&& mapping) = delete;
+
+		explicit file_mapping(const std::string& path);
+		~file_mapping();
+
+		const uint8_t* data() const;
+		size_t size() const;
+	};
+
+	class image
+	{
+		std::vector<segment> m_segments;
+		std::vector<symbol> m_symbols;
+		std::vector<std::shared_ptr<const void>> m_storage;
+		//Shared between copies so symbol names stay put
+		std::shared_ptr<string_pool> m_strings;
+		std::optional<uint64_t> m_entry_point;
+		isa m_architecture;
+
+	public:
+		image() = delete;
+
+		explicit image(const isa arch) : m_strings{ std::make_shared<string_pool>() }, m_architecture{ arch }
+		{}
+
+		//data has to outlive the image, pass whatever owns it as storage to have the image keep it alive
+		void add_segment(const segment& seg, std::shared_ptr<const void> storage = nullptr);
+
+		//Copies the bytes into storage owned by the image
+		void add_segment(const uint64_t address, std::vector<uint8_t>&& bytes, const bool executable, const bool writable, const std::string& name);
+
+		//Keeps whatever backs segments added without storage alive for as long as the image
+		void add_storage(std::shared_ptr<const void> storage);
+
+		void add_symbol(const symbol& sym);
+		void set_entry_point(const uint64_t address);
+
+		const segment* find_segment(const uint64_t address) const;
+		const std::vector<segment>& get_segments() const;
+		//Sorted by address
+		const std::vector<symbol>& get_symbols() const;
+		const std::optional<uint64_t> get_entry_point() const;
+		const isa get_architecture() const;
+
+		bool is_code(const uint64_t address) const;
+		bool read(const uint64_t address, void* buffer, const size_t size) const;
+
+		template<typename T>
+		std::optional<T> read_value(const uint64_t address) const
+		{
+			T value{};
+
+			if (!read(address, &value, sizeof(T)))
+				return std::nullopt;
+
+			return value;
+		}
+	};
+}
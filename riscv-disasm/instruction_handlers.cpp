@@ -15,19 +15,18 @@
 //	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
 #include "disassembler.hpp"
 #include "registers.hpp"
-#include <iostream>
 
 namespace riscv
 {
-	void disassembler::fence_instruction_handler(const std::string& mnemonic, const signed int& immediate)
+	void disassembler::fence_instruction_handler(std::ostream& out, const std::string_view mnemonic, const signed int& immediate) const
 	{
 		if (mnemonic == "FENCE.I") {
-			std::cout << mnemonic << "\n";
+			out << mnemonic;
 		} else {
 
 			//FENCE.TSO
 			if (immediate >> 8) {
-				std::cout << "FENCE.TSO rw, rw\n";
+				out << "FENCE.TSO rw, rw";
 				return;
 			}
 
@@ -67,11 +66,11 @@ namespace riscv
 			if (predecessor.w != 0)
 				pre_str.append("w");
 
-			std::cout << mnemonic << " " << pre_str << ", " << succ_str << "\n";
+			out << mnemonic << " " << pre_str << ", " << succ_str;
 		}
 	}
 
-	void disassembler::float_instruction_handler(const instruction::type_r& instruction, instruction_data instr_data)
+	void disassembler::float_instruction_handler(std::ostream& out, const instruction::type_r& instruction, instruction_data instr_data) const
 	{
 		auto& [proper_opcode, mask, mnemonic, flags] { instr_data };
 
@@ -81,14 +80,14 @@ namespace riscv
 		auto& mode			= instruction::float_rounding_name[instruction.funct3].second;
 
 		if (flags.is_special_float) {
-			std::cout << mnemonic << "(" << mode << ") " << destination << ", " << first << "\n";
+			out << mnemonic << "(" << mode << ") " << destination << ", " << first;
 			return;
 		}
 
-		std::cout << mnemonic << "(" << mode << ") " << destination << ", " << first << ", " << last << "\n";
+		out << mnemonic << "(" << mode << ") " << destination << ", " << first << ", " << last;
 	}
 
-	void disassembler::a_ext_instruction_handler(const instruction::type_r& instruction, instruction_data instr_data)
+	void disassembler::a_ext_instruction_handler(std::ostream& out, const instruction::type_r& instruction, instruction_data instr_data) const
 	{
 		auto& [proper_opcode, mask, mnemonic, flags] { instr_data };
 
@@ -107,8 +106,91 @@ namespace riscv
 			aq_rl.append(".RL");
 
 		if (mnemonic == "LR.W" || mnemonic == "LR.D")
-			std::cout << mnemonic << aq_rl << " " << destination << ", (" << address << ")\n";
+			out << mnemonic << aq_rl << " " << destination << ", (" << address << ")";
 		else 
-			std::cout << mnemonic << aq_rl << " " << destination << ", " << middle << ", (" << address << ")\n";
+			out << mnemonic << aq_rl << " " << destination << ", " << middle << ", (" << address << ")";
+	}
+	void disassembler::compressed_instruction_handler(std::ostream& out, const instruction::object& instruction, const uint64_t address) const
+	{
+		const instruction::instruction_entry* entry = instruction::find_instruction(instruction.get_raw(), m_architecture);
+		const uint32_t expanded = instruction.get_expanded();
+
+		if (!entry || !expanded) {
+			unknown_instruction_handler(out, instruction);
+			return;
+		}
+
+		auto& [proper_opcode, mask, mnemonic, flags] { *entry };
+
+		//Everything is printed off of the expanded instruction so we only have to get the immediate shuffling right once
+		const uint32_t rd = (expanded >> 7) & 0x1f;
+		const uint32_t rs1 = (expanded >> 15) & 0x1f;
+		const uint32_t rs2 = (expanded >> 20) & 0x1f;
+		const int32_t immediate = instruction.get_immediate();
+
+		auto& x_regs = registers::x_reg_name_table;
+		auto data_reg = [&flags](const uint32_t reg) { return flags.is_float ? registers::f_reg_name_table[reg].second : registers::x_reg_name_table[reg].second; };
+
+		switch (expanded & 0x7f)
+		{
+		case 0x03:
+		case 0x07:
+			out << mnemonic << " " << data_reg(rd) << ", 0x" << std::hex << immediate << "(" << x_regs[rs1].second << ")";
+			break;
+
+		case 0x23:
+		case 0x27:
+			out << mnemonic << " " << data_reg(rs2) << ", 0x" << std::hex << immediate << "(" << x_regs[rs1].second << ")";
+			break;
+
+		case 0x13:
+		case 0x1b:
+			if (expanded == 0x13) {
+				out << mnemonic;
+				break;
+			}
+
+			//C.ADDI4SPN is the only one that doesn't write back into its source, C.LI reads zero
+			if (rs1 != 0 && rd != rs1) {
+				out << mnemonic << " " << x_regs[rd].second << ", " << x_regs[rs1].second << ", 0x" << std::hex << immediate;
+				break;
+			}
+
+			out << mnemonic << " " << x_regs[rd].second << ", 0x" << std::hex << (flags.is_shamt ? (immediate & 0x3f) : immediate);
+			break;
+
+		case 0x37:
+			out << mnemonic << " " << x_regs[rd].second << ", 0x" << std::hex << (expanded >> 12);
+			break;
+
+		case 0x33:
+		case 0x3b:
+			out << mnemonic << " " << x_regs[rd].second << ", " << x_regs[rs2].second;
+			break;
+
+		case 0x67:
+			out << mnemonic << " " << x_regs[rs1].second;
+			break;
+
+		case 0x6f:
+			out << mnemonic << " 0x" << std::hex << wrap_address(address + immediate);
+			break;
+
+		case 0x63:
+			out << mnemonic << " " << x_regs[rs1].second << ", 0x" << std::hex << wrap_address(address + immediate);
+			break;
+
+		default:
+			out << mnemonic;
+			break;
+		}
+	}
+
+	void disassembler::unknown_instruction_handler(std::ostream& out, const instruction::object& instruction) const
+	{
+		if (instruction.get_length() == 2)
+			out << ".half 0x" << std::hex << instruction.get_raw();
+		else
+			out << ".word 0x" << std::hex << instruction.get_raw();
 	}
 }
\ No newline at end of file
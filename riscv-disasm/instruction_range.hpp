@@ -0,0 +1,154 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "boundaries.hpp"
+#include "image.hpp"
+#include <iterator>
+#include <ranges>
+
+namespace riscv
+{
+	struct decoded_instruction
+	{
+		uint64_t address;
+		instruction::object instruction;
+	};
+
+	//Linear decode of a span of code as a range: nothing is decoded until it's looked at and nothing is kept
+	//besides the current instruction, so it composes with the standard adaptors and an early break costs nothing
+	//for the rest of the span, e.g.
+	//	for (auto& decoded : instruction_range{ img, function.begin, function.end } | std::views::filter(is_m))
+	//It's an input range, the current instruction lives in the iterator
+	class instruction_range : public std::ranges::view_interface<instruction_range>
+	{
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+		uint64_t m_address = 0;
+		isa m_architecture = isa::RV64;
+
+	public:
+		class iterator
+		{
+			const uint8_t* m_data = nullptr;
+			size_t m_size = 0;
+			size_t m_offset = 0;
+			uint64_t m_address = 0;
+			isa m_architecture = isa::RV64;
+
+			//Decoded on first dereference. Reset and emplaced rather than assigned, object isn't assignable
+			mutable std::optional<decoded_instruction> m_current;
+
+			size_t length() const
+			{
+				return instruction_length(m_data[m_offset]);
+			}
+
+		public:
+			using iterator_concept = std::input_iterator_tag;
+			using value_type = decoded_instruction;
+			using difference_type = std::ptrdiff_t;
+
+			iterator() = default;
+			iterator(const iterator& other) = default;
+
+			iterator(const uint8_t* data, const size_t size, const uint64_t address, const isa arch) : m_data{ data }, m_size{ size }, m_address{ address }, m_architecture{ arch }
+			{}
+
+			iterator& operator=(const iterator& other)
+			{
+				m_data = other.m_data;
+				m_size = other.m_size;
+				m_offset = other.m_offset;
+				m_address = other.m_address;
+				m_architecture = other.m_architecture;
+
+				m_current.reset();
+				if (other.m_current)
+					m_current.emplace(*other.m_current);
+
+				return *this;
+			}
+
+			const decoded_instruction& operator*() const
+			{
+				if (!m_current) {
+					uint32_t raw = m_data[m_offset] | (static_cast<uint32_t>(m_data[m_offset + 1]) << 8);
+
+					if (length() == 4)
+						raw |= (static_cast<uint32_t>(m_data[m_offset + 2]) << 16) | (static_cast<uint32_t>(m_data[m_offset + 3]) << 24);
+
+					m_current.emplace(decoded_instruction{ m_address + m_offset, instruction::object{ raw, m_architecture } });
+				}
+
+				return *m_current;
+			}
+
+			const decoded_instruction* operator->() const
+			{
+				return &**this;
+			}
+
+			iterator& operator++()
+			{
+				m_offset += length();
+				m_current.reset();
+				return *this;
+			}
+
+			void operator++(int)
+			{
+				++*this;
+			}
+
+			//Done once what's left can't hold the next instruction
+			bool operator==(std::default_sentinel_t) const
+			{
+				return m_size - m_offset < 2 || m_size - m_offset < length();
+			}
+		};
+
+		instruction_range() = default;
+
+		instruction_range(const uint8_t* data, const size_t size, const uint64_t address, const isa arch) : m_data{ data }, m_size{ size }, m_address{ address }, m_architecture{ arch }
+		{}
+
+		//[begin, end) of the segment begin is in, cut at the end of that segment. Empty if begin isn't mapped
+		instruction_range(const image& img, const uint64_t begin, const uint64_t end) : m_architecture{ img.get_architecture() }
+		{
+			const segment* seg = img.find_segment(begin);
+
+			if (!seg || end <= begin)
+				return;
+
+			m_data = seg->data + (begin - seg->address);
+			m_size = static_cast<size_t>(std::min<uint64_t>(end - begin, seg->size - (begin - seg->address)));
+			m_address = begin;
+		}
+
+		iterator begin() const
+		{
+			return iterator{ m_data, m_size, m_address, m_architecture };
+		}
+
+		std::default_sentinel_t end() const
+		{
+			return std::default_sentinel;
+		}
+	};
+
+	static_assert(std::ranges::input_range<instruction_range> && std::ranges::view<instruction_range>);
+}
\ No newline at end of file
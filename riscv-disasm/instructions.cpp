@@ -14,10 +14,12 @@
 //	You should have received a copy of the GNU General Public License
 //	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
 #include "instructions.hpp"
+#include <algorithm>
+#include <bit>
 
 namespace riscv {
 	namespace instruction {
-		const uint8_t object::get_opcode(const uint32_t instruction) const
+		const uint8_t object::get_opcode(const uint32_t instruction)
 		{
 			/*
 			Clears out all bits except last 7 (opcode)
@@ -26,12 +28,19 @@ namespace riscv {
 			return instruction & 0x0000007f;
 		}
 
-		//add errorchecks here omegalul
-		const type_identifier object::set_instruction_format(const uint32_t instruction) const
+		const type_identifier object::set_instruction_format(const uint32_t instruction)
 		{
+			if ((instruction & 0x3) != 0x3)
+				return type_identifier::CEXT;
+
 			const uint8_t opcode = get_opcode(instruction);
-			
-			return opcode_instruction_type.at(opcode);
+			auto type = opcode_instruction_type.find(opcode);
+
+			//Data, or an extension we don't handle (yet)
+			if (type == opcode_instruction_type.end())
+				return type_identifier::UNKNOWN;
+
+			return type->second;
 		}
 
 		const object::instruction_format object::set_instruction_data(const type_identifier type, const uint32_t instruction)
@@ -63,8 +72,9 @@ namespace riscv {
 				return cext_handler(instruction); //TODO: Pass instruction as uint16_t make sure that works properly
 				break;
 
+			//Keep the raw bits around so whoever prints it can still dump them
 			default:
-				return type_r{ 0 };
+				return type_r{ instruction };
 			}
 		}
 
@@ -78,9 +88,383 @@ namespace riscv {
 			return m_type;
 		}
 
+		const uint32_t object::get_raw() const
+		{
+			return std::visit([](const auto& data) { return static_cast<uint32_t>(data.instruction); }, m_data);
+		}
+
+		const uint32_t object::get_expanded() const
+		{
+			return m_expanded;
+		}
+
+		const uint8_t object::get_length() const
+		{
+			//Anything not ending in 0b11 is a 16 bit compressed instruction
+			return (get_raw() & 0x3) == 0x3 ? 4 : 2;
+		}
+
+		const extensions object::get_extension() const
+		{
+			if (m_type == type_identifier::CEXT)
+				return extensions::C;
+
+			const uint32_t opcode = m_expanded & 0x7f;
+			const uint32_t funct3 = (m_expanded >> 12) & 0x7;
+
+			//Float format field, S/D/Q are 0/1/3
+			auto float_extension = [](const uint32_t format)
+			{
+				return format == 3 ? extensions::Q : format == 1 ? extensions::D : extensions::F;
+			};
+
+			switch (opcode)
+			{
+			case 0x0F:
+				return funct3 == 1 ? extensions::ZIFENCEI : extensions::I;
+
+			case 0x73:
+				return funct3 ? extensions::ZICSR : extensions::I;
+
+			case 0x33:
+			case 0x3B:
+				return (m_expanded >> 25) == 1 ? extensions::M : extensions::I;
+
+			case 0x2F:
+				return extensions::A;
+
+			case 0x07:
+			case 0x27:
+				return funct3 == 4 ? extensions::Q : funct3 == 3 ? extensions::D : extensions::F;
+
+			case 0x43:
+			case 0x47:
+			case 0x4B:
+			case 0x4F:
+				return float_extension((m_expanded >> 25) & 0x3);
+
+			case 0x53: {
+				const uint32_t format = (m_expanded >> 25) & 0x3;
+
+				//Conversions between float formats need the wider one, FCVT.S.D is a D instruction
+				if ((m_expanded >> 27) == 0x08) {
+					const uint32_t source = (m_expanded >> 20) & 0x3;
+					auto width = [](const uint32_t f) { return f == 3 ? 2u : f; };
+
+					return float_extension(width(source) > width(format) ? source : format);
+				}
+
+				return float_extension(format);
+			}
+
+			default:
+				return extensions::I;
+			}
+		}
+
+		//The bitfields split the immediates up and sign extend every piece on its own, so put them back together from the raw bits instead
+		const int32_t object::get_immediate() const
+		{
+			const uint32_t raw = get_raw();
+
+			if (m_type == type_identifier::CEXT)
+				return m_expanded ? object{ m_expanded }.get_immediate() : 0;
+
+			switch (m_type)
+			{
+			case type_identifier::I:
+				return static_cast<int32_t>(raw) >> 20;
+
+			case type_identifier::S:
+				return ((static_cast<int32_t>(raw) >> 25) << 5) | ((raw >> 7) & 0x1f);
+
+			case type_identifier::B:
+				return (static_cast<int32_t>(raw & 0x80000000) >> 19) | ((raw & 0x80) << 4) | ((raw >> 20) & 0x7e0) | ((raw >> 7) & 0x1e);
+
+			case type_identifier::U:
+				return static_cast<int32_t>(raw & 0xfffff000);
+
+			case type_identifier::J:
+				return (static_cast<int32_t>(raw & 0x80000000) >> 11) | (raw & 0xff000) | ((raw >> 9) & 0x800) | ((raw >> 20) & 0x7fe);
+
+			default:
+				return 0;
+			}
+		}
+
+		const instruction_entry* find_instruction(const uint32_t instruction, const isa arch)
+		{
+			const uint32_t key = (instruction & 0x3) != 0x3 ? (instruction & 0x3) : (instruction & 0x0000007f);
+			auto potential_instructions = instruction_table.find(key);
+
+			if (potential_instructions == instruction_table.end())
+				return nullptr;
+
+			const instruction_entry* best = nullptr;
+			int best_bits = -1;
+
+			for (auto& instr_data : potential_instructions->second)
+			{
+				auto& [proper_opcode, mask, mnemonic, flags] { instr_data };
+
+				if ((instruction & mask) != proper_opcode)
+					continue;
+
+				//RV32 only encodings come first in the table, RV64 ones with the exact same mask right after
+				const int bits = std::popcount(mask);
+				if (bits > best_bits || (bits == best_bits && arch != isa::RV32)) {
+					best = &instr_data;
+					best_bits = bits;
+				}
+			}
+
+			return best;
+		}
+
+		namespace
+		{
+			struct mnemonic_ids
+			{
+				std::vector<std::string_view> names;
+				std::unordered_map<const instruction_entry*, uint16_t> ids;
+			};
+
+			const mnemonic_ids& get_mnemonic_ids()
+			{
+				static const mnemonic_ids table = []
+				{
+					mnemonic_ids result;
+
+					for (auto& [key, entries] : instruction_table)
+					{
+						for (auto& entry : entries)
+							result.names.push_back(std::get<2>(entry));
+					}
+
+					std::sort(result.names.begin(), result.names.end());
+					result.names.erase(std::unique(result.names.begin(), result.names.end()), result.names.end());
+
+					for (auto& [key, entries] : instruction_table)
+					{
+						for (auto& entry : entries)
+							result.ids.emplace(&entry, static_cast<uint16_t>(std::lower_bound(result.names.begin(), result.names.end(), std::get<2>(entry)) - result.names.begin()));
+					}
+
+					return result;
+				}();
+
+				return table;
+			}
+		}
+
+		const uint16_t get_mnemonic_id(const instruction_entry* entry)
+		{
+			if (!entry)
+				return invalid_mnemonic;
+
+			auto& ids = get_mnemonic_ids().ids;
+			auto found = ids.find(entry);
+
+			return found != ids.end() ? found->second : invalid_mnemonic;
+		}
+
+		const std::string_view get_mnemonic_name(const uint16_t id)
+		{
+			auto& names = get_mnemonic_ids().names;
+
+			return id < names.size() ? names[id] : "UNKNOWN";
+		}
+
+		const size_t get_mnemonic_count()
+		{
+			return get_mnemonic_ids().names.size();
+		}
+
 		const object::instruction_format object::cext_handler(const uint16_t instruction) const
 		{
+			const uint16_t quadrant = instruction & 0x3;
+			const uint16_t funct3 = instruction >> 13;
+
+			switch (quadrant)
+			{
+			case 0x0:
+				if (funct3 == 0b000)
+					return type_ciw{ instruction };
+
+				if (funct3 < 0b100)
+					return type_cl{ instruction };
+
+				return type_cs{ instruction };
+
+			case 0x1:
+				if (funct3 == 0b001 || funct3 == 0b101)
+					return type_cj{ instruction }; //C.JAL, on RV64 this is C.ADDIW which gets treated as CI by the printer
+
+				if (funct3 == 0b100)
+					return ((instruction >> 10) & 0x3) == 0x3 ? instruction_format{ type_ca{ instruction } } : instruction_format{ type_cb{ instruction } };
+
+				if (funct3 >= 0b110)
+					return type_cb{ instruction };
+
+				return type_ci{ instruction };
+
+			default:
+				if (funct3 == 0b100)
+					return type_cr{ instruction };
+
+				if (funct3 >= 0b101)
+					return type_css{ instruction };
+
+				return type_ci{ instruction };
+			}
+		}
+
+		namespace
+		{
+			constexpr uint32_t encode_i(const uint32_t opcode, const uint32_t rd, const uint32_t funct3, const uint32_t rs1, const uint32_t imm)
+			{
+				return ((imm & 0xfff) << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+			}
+
+			constexpr uint32_t encode_r(const uint32_t opcode, const uint32_t rd, const uint32_t funct3, const uint32_t rs1, const uint32_t rs2, const uint32_t funct7)
+			{
+				return (funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+			}
+
+			constexpr uint32_t encode_s(const uint32_t opcode, const uint32_t funct3, const uint32_t rs1, const uint32_t rs2, const uint32_t imm)
+			{
+				return (((imm >> 5) & 0x7f) << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | ((imm & 0x1f) << 7) | opcode;
+			}
+
+			constexpr uint32_t encode_b(const uint32_t funct3, const uint32_t rs1, const uint32_t rs2, const uint32_t imm)
+			{
+				return (((imm >> 12) & 0x1) << 31) | (((imm >> 5) & 0x3f) << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | (((imm >> 1) & 0xf) << 8) | (((imm >> 11) & 0x1) << 7) | 0x63;
+			}
+
+			constexpr uint32_t encode_j(const uint32_t rd, const uint32_t imm)
+			{
+				return (((imm >> 20) & 0x1) << 31) | (((imm >> 1) & 0x3ff) << 21) | (((imm >> 11) & 0x1) << 20) | (((imm >> 12) & 0xff) << 12) | (rd << 7) | 0x6f;
+			}
+
+			constexpr int32_t sign_extend(const uint32_t value, const uint32_t bits)
+			{
+				return static_cast<int32_t>(value << (32 - bits)) >> (32 - bits);
+			}
+		}
+
+		//Straight out of the "RVC Instruction Set Listings" chapter of the manual
+		const uint32_t expand_compressed(const uint16_t instruction, const isa arch)
+		{
+			const uint32_t c = instruction;
+			const uint32_t funct3 = c >> 13;
+			const bool rv32 = arch == isa::RV32;
 
+			//Full and "popular" (x8-x15) register fields
+			const uint32_t rd = (c >> 7) & 0x1f;
+			const uint32_t rs2 = (c >> 2) & 0x1f;
+			const uint32_t rd_p = 8 + ((c >> 2) & 0x7);
+			const uint32_t rs1_p = 8 + ((c >> 7) & 0x7);
+
+			const int32_t imm6 = sign_extend(((c >> 7) & 0x20) | ((c >> 2) & 0x1f), 6);
+			const uint32_t shamt = ((c >> 7) & 0x20) | ((c >> 2) & 0x1f);
+			const uint32_t offset_d = ((c >> 7) & 0x38) | ((c << 1) & 0xc0);
+			const uint32_t offset_w = ((c >> 7) & 0x38) | ((c >> 4) & 0x4) | ((c << 1) & 0x40);
+			const int32_t offset_j = sign_extend(((c >> 1) & 0x800) | ((c >> 7) & 0x10) | ((c >> 1) & 0x300) | ((c << 2) & 0x400) | ((c >> 1) & 0x40) | ((c << 1) & 0x80) | ((c >> 2) & 0xe) | ((c << 3) & 0x20), 12);
+
+			if (c == 0)
+				return 0;
+
+			switch (c & 0x3)
+			{
+			case 0x0:
+				switch (funct3)
+				{
+				case 0b000: {
+					const uint32_t imm = ((c >> 7) & 0x30) | ((c >> 1) & 0x3c0) | ((c >> 4) & 0x4) | ((c >> 2) & 0x8);
+					return imm ? encode_i(0x13, rd_p, 0, 2, imm) : 0;
+				}
+				case 0b001: return encode_i(0x07, rd_p, 3, rs1_p, offset_d);
+				case 0b010: return encode_i(0x03, rd_p, 2, rs1_p, offset_w);
+				case 0b011: return rv32 ? encode_i(0x07, rd_p, 2, rs1_p, offset_w) : encode_i(0x03, rd_p, 3, rs1_p, offset_d);
+				case 0b101: return encode_s(0x27, 3, rs1_p, rd_p, offset_d);
+				case 0b110: return encode_s(0x23, 2, rs1_p, rd_p, offset_w);
+				case 0b111: return rv32 ? encode_s(0x27, 2, rs1_p, rd_p, offset_w) : encode_s(0x23, 3, rs1_p, rd_p, offset_d);
+				default: return 0;
+				}
+
+			case 0x1:
+				switch (funct3)
+				{
+				case 0b000: return encode_i(0x13, rd, 0, rd, imm6);
+				case 0b001: return rv32 ? encode_j(1, offset_j) : (rd ? encode_i(0x1b, rd, 0, rd, imm6) : 0);
+				case 0b010: return encode_i(0x13, rd, 0, 0, imm6);
+				case 0b011: {
+					if (rd == 2) {
+						const int32_t imm = sign_extend(((c >> 3) & 0x200) | ((c >> 2) & 0x10) | ((c << 1) & 0x40) | ((c << 4) & 0x180) | ((c << 3) & 0x20), 10);
+						return imm ? encode_i(0x13, 2, 0, 2, imm) : 0;
+					}
+
+					const int32_t imm = sign_extend(((c << 5) & 0x20000) | ((c << 10) & 0x1f000), 18);
+					return imm ? ((imm & 0xfffff000) | (rd << 7) | 0x37) : 0;
+				}
+				case 0b100:
+					switch ((c >> 10) & 0x3)
+					{
+					case 0b00: return encode_i(0x13, rs1_p, 5, rs1_p, shamt);
+					case 0b01: return encode_i(0x13, rs1_p, 5, rs1_p, shamt | 0x400);
+					case 0b10: return encode_i(0x13, rs1_p, 7, rs1_p, imm6);
+					default: {
+						constexpr uint32_t alu_funct3[] = { 0, 4, 6, 7 };
+						const uint32_t op = (c >> 5) & 0x3;
+
+						if (c & 0x1000) //C.SUBW and C.ADDW, the other two are reserved
+							return op < 2 ? encode_r(0x3b, rs1_p, 0, rs1_p, rd_p, op == 0 ? 0x20 : 0) : 0;
+
+						return encode_r(0x33, rs1_p, alu_funct3[op], rs1_p, rd_p, op == 0 ? 0x20 : 0);
+					}
+					}
+				case 0b101: return encode_j(0, offset_j);
+				default: {
+					const int32_t imm = sign_extend(((c >> 4) & 0x100) | ((c >> 7) & 0x18) | ((c << 1) & 0xc0) | ((c >> 2) & 0x6) | ((c << 3) & 0x20), 9);
+					return encode_b(funct3 & 0x1, rs1_p, 0, imm);
+				}
+				}
+
+			default:
+				switch (funct3)
+				{
+				case 0b000: return encode_i(0x13, rd, 1, rd, shamt);
+				case 0b001: return encode_i(0x07, rd, 3, 2, ((c >> 7) & 0x20) | ((c >> 2) & 0x18) | ((c << 4) & 0x1c0));
+				case 0b010: return rd ? encode_i(0x03, rd, 2, 2, ((c >> 7) & 0x20) | ((c >> 2) & 0x1c) | ((c << 4) & 0xc0)) : 0;
+				case 0b011:
+					if (rv32)
+						return encode_i(0x07, rd, 2, 2, ((c >> 7) & 0x20) | ((c >> 2) & 0x1c) | ((c << 4) & 0xc0));
+
+					return rd ? encode_i(0x03, rd, 3, 2, ((c >> 7) & 0x20) | ((c >> 2) & 0x18) | ((c << 4) & 0x1c0)) : 0;
+				case 0b100:
+					if (!(c & 0x1000)) {
+						if (rs2 == 0) //C.JR
+							return rd ? encode_i(0x67, 0, 0, rd, 0) : 0;
+
+						return encode_r(0x33, rd, 0, 0, rs2, 0); //C.MV
+					}
+
+					if (rd == 0 && rs2 == 0) //C.EBREAK
+						return 0x00100073;
+
+					if (rs2 == 0) //C.JALR
+						return encode_i(0x67, 1, 0, rd, 0);
+
+					return encode_r(0x33, rd, 0, rd, rs2, 0); //C.ADD
+				case 0b101: return encode_s(0x27, 3, 2, rs2, ((c >> 7) & 0x38) | ((c >> 1) & 0x1c0));
+				case 0b110: return encode_s(0x23, 2, 2, rs2, ((c >> 7) & 0x3c) | ((c >> 1) & 0xc0));
+				default:
+					if (rv32)
+						return encode_s(0x27, 2, 2, rs2, ((c >> 7) & 0x3c) | ((c >> 1) & 0xc0));
+
+					return encode_s(0x23, 3, 2, rs2, ((c >> 7) & 0x38) | ((c >> 1) & 0x1c0));
+				}
+			}
 		}
 	}
 }
\ No newline at end of file
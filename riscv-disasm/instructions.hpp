@@ -17,16 +17,27 @@
 
 #include <cstdint>
 #include <array>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
 #include <variant>
 #include <unordered_map>
 
 namespace riscv
 {
+	enum class isa
+	{
+		RV32,
+		RV64,
+		RV128
+	};
+
 	namespace instruction
 	{
 		enum class type_identifier : uint8_t
 		{
-			R, R4, I, S, B, U, J, CEXT
+			R, R4, I, S, B, U, J, CEXT, UNKNOWN
 		};
 
 		enum class extensions
@@ -60,6 +71,20 @@ namespace riscv
 			instruction_flags(uint8_t&& f) : flag{ std::move(f) } {}
 		};
 
+		//Registers read and written by a single instruction, bits 0-31 are x0-x31 and bits 32-63 are f0-f31
+		//x0 never shows up in here since reading it is a constant and writing it does nothing
+		struct register_usage
+		{
+			uint64_t use;
+			uint64_t def;
+			uint16_t csr;
+			bool csr_read : 1;
+			bool csr_write : 1;
+
+			static constexpr uint64_t x(const uint32_t reg) { return reg ? (1ull << reg) : 0; }
+			static constexpr uint64_t f(const uint32_t reg) { return 1ull << (32 + reg); }
+		};
+
 		enum class float_rounding_mode
 		{
 			RNE,
@@ -76,6 +101,9 @@ namespace riscv
 			std::pair{float_rounding_mode::RDN, "RDN"},
 			std::pair{float_rounding_mode::RUP, "RUP"},
 			std::pair{float_rounding_mode::RMM, "RMM"},
+			//Indexed by rm straight from the instruction, 5 and 6 are reserved encodings
+			std::pair{static_cast<float_rounding_mode>(0x5), "RESERVED5"},
+			std::pair{static_cast<float_rounding_mode>(0x6), "RESERVED6"},
 			std::pair{float_rounding_mode::DYN, "DYN"},
 		};
 
@@ -284,6 +312,9 @@ namespace riscv
 			};
 		};
 
+		//Rewrites a compressed instruction into the 32 bit instruction it is shorthand for
+		const uint32_t expand_compressed(const uint16_t instruction, const isa arch);
+
 		class object
 		{
 			using instruction_format = std::variant<type_r, type_r4, type_i, type_s, type_b, type_u, type_j, type_cr, type_ci, type_css, type_ciw, type_cl, type_cs, type_ca, type_cb, type_cj>;
@@ -291,8 +322,11 @@ namespace riscv
 			const type_identifier m_type;
 			const instruction_format m_data;
 
-			const uint8_t get_opcode(const uint32_t instruction) const;
-			const type_identifier set_instruction_format(const uint32_t instruction) const;
+			//What a compressed instruction expands to (the instruction itself otherwise), 0 if it is reserved or illegal
+			const uint32_t m_expanded;
+
+			static const uint8_t get_opcode(const uint32_t instruction);
+			static const type_identifier set_instruction_format(const uint32_t instruction);
 			const instruction_format cext_handler(const uint16_t instruction) const;
 			const instruction_format set_instruction_data(const type_identifier type, const uint32_t instruction);
 
@@ -301,16 +335,25 @@ namespace riscv
 			object(const object& obj) = default;
 			object(object&& obj) = default;
 
-			explicit object(const uint32_t inst) : m_type { set_instruction_format(inst) }, m_data{ set_instruction_data(m_type, inst) }
+			//The ISA is needed to tell apart compressed encodings that mean different things on RV32 and RV64 (C.JAL vs C.ADDIW etc.)
+			explicit object(const uint32_t inst, const isa arch = isa::RV64) : m_type { set_instruction_format(inst) }, m_data{ set_instruction_data(m_type, inst) }, 
+				m_expanded{ m_type == type_identifier::CEXT ? expand_compressed(static_cast<uint16_t>(inst), arch) : inst }
 			{}
 
 			const type_identifier get_type() const;
 			const instruction_format get_data() const;
+			const uint32_t get_raw() const;
+			const uint32_t get_expanded() const;
+			const uint8_t get_length() const;
+			const int32_t get_immediate() const;
+			const register_usage get_register_usage() const;
+			//Compressed instructions are C no matter what they expand to
+			const extensions get_extension() const;
 		};
 
 		//Probably better (and faster) to generate an array filled with null spaces for potential instructions
 		//Can be done later tho
-		const std::unordered_map<uint8_t, const type_identifier> opcode_instruction_type {
+		inline const std::unordered_map<uint8_t, const type_identifier> opcode_instruction_type {
 			{0x37, type_identifier::U},
 			{0x17, type_identifier::U},
 			{0x6F, type_identifier::J},
@@ -334,14 +377,8 @@ namespace riscv
 			{0x4B, type_identifier::R4}, //FNMSUB.S/D/Q
 			{0x4F, type_identifier::R4}, //FNMADD.S/D/Q
 			{0x53, type_identifier::R}, //Everything else
+			//C extension is picked out by the lowest 2 bits before we ever get here
 
-			//C Extension
-			{0x0, type_identifier::CEXT},
-			{0x1, type_identifier::CEXT},
-			{0x2, type_identifier::CEXT},
-			{0x21, type_identifier::CEXT},
-			{0x41, type_identifier::CEXT},
-			{0x61, type_identifier::CEXT}
 		};
 
 		/*
@@ -351,9 +388,9 @@ namespace riscv
 		
 		//essentially maps each opcode to a set of instructions with said opcode, which each have a { match, mask, mnemonic, is_load_or_store_instr, is_floating_pt } tuple that we can use for parsing and checking which instruction it actually is
 		//change to constexpr when msvc decides to fucking implement it -_-
-		const std::unordered_map<uint8_t, const std::vector<std::tuple<uint32_t, uint32_t, std::string, instruction_flags>>> instruction_table {
+		inline const std::unordered_map<uint8_t, const std::vector<std::tuple<uint32_t, uint32_t, std::string_view, instruction_flags>>> instruction_table {
 			//CEXT
-			//TODO: fix the instruction_flags for this ext
+			//Keyed on the quadrant (lowest 2 bits) rather than the 7 bit opcode, RV32 only and RV64 only encodings share match and mask
 			{ 0x1, { 
 						{ 0x1, 0xffff, "C.NOP", 0b00000000 },
 						{ 0x6101, 0xef83, "C.ADDI16SP", 0b00000000 },
@@ -361,65 +398,50 @@ namespace riscv
 						{ 0x2001, 0xe003, "C.JAL", 0b00000000 },
 						{ 0x4001, 0xe003, "C.LI", 0b00000000 },
 						{ 0x6001, 0xe003, "C.LUI", 0b00000000 },
-						{ 0x8001, 0xec03, "C.SRLI", 0b00000000 },
-						{ 0x8401, 0xec03, "C.SRAI", 0b00000000 },
+						{ 0x8001, 0xec03, "C.SRLI", 0b01000000 },
+						{ 0x8401, 0xec03, "C.SRAI", 0b01000000 },
 						{ 0x8801, 0xec03, "C.ANDI", 0b00000000 },
 						{ 0x8c01, 0xfc63, "C.SUB", 0b00000000 },
+						{ 0x8c21, 0xfc63, "C.XOR", 0b00000000 },
+						{ 0x8c41, 0xfc63, "C.OR", 0b00000000 },
+						{ 0x8c61, 0xfc63, "C.AND", 0b00000000 },
 						{ 0xa001, 0xe003, "C.J", 0b00000000 },
 						{ 0xc001, 0xe003, "C.BEQZ", 0b00000000 },
 						{ 0xe001, 0xe003, "C.BNEZ", 0b00000000 },
 						{ 0x2001, 0xe003, "C.ADDIW", 0b00000000 },
-						{ 0x8001, 0xfc03, "C.SRLI.RV32", 0b00000000 },
-						{ 0x8401, 0xfc03, "C.SRAI.RV32", 0b00000000 },
-						{ 0x9c01, 0xfc63, "C.SUBW", 0b00000000 }
+						{ 0x9c01, 0xfc63, "C.SUBW", 0b00000000 },
+						{ 0x9c21, 0xfc63, "C.ADDW", 0b00000000 }
 					} 
 			},
 
 			{ 0x2, {
 						{ 0x8002, 0xf07f, "C.JR", 0b00000000 },
 						{ 0x9002, 0xf07f, "C.JALR", 0b00000000 },
-						{ 0x9002, 0xffff, "C.EBREAK", 0b00000000 },
-						{ 0x2, 0xe003, "C.SLLI", 0b00000000 },
-						{ 0x2002, 0xe003, "C.FLDSP", 0b00000000 },
-						{ 0x4002, 0xe003, "C.LWSP", 0b00000000 },
-						{ 0x6002, 0xe003, "C.FLWSP", 0b00000000 },
+						{ 0x9002, 0xffff, "C.EBREAK", 0b00010000 },
+						{ 0x2, 0xe003, "C.SLLI", 0b01000000 },
+						{ 0x2002, 0xe003, "C.FLDSP", 0b10000100 },
+						{ 0x4002, 0xe003, "C.LWSP", 0b00000100 },
+						{ 0x6002, 0xe003, "C.FLWSP", 0b10000100 },
 						{ 0x8002, 0xf003, "C.MV", 0b00000000 },
 						{ 0x9002, 0xf003, "C.ADD", 0b00000000 },
-						{ 0xa002, 0xe003, "C.FSDSP", 0b00000000 },
-						{ 0xc002, 0xe003, "C.SWSP", 0b00000000 },
-						{ 0xe002, 0xe003, "C.FSWSP", 0b00000000 },
-						{ 0x6002, 0xe003, "C.LDSP", 0b00000000 },
-						{ 0xe002, 0xe003, "C.SDSP", 0b00000000 },
-						{ 0x2, 0xf003, "C.SLLI.RV32", 0b00000000 }
+						{ 0xa002, 0xe003, "C.FSDSP", 0b10000100 },
+						{ 0xc002, 0xe003, "C.SWSP", 0b00000100 },
+						{ 0xe002, 0xe003, "C.FSWSP", 0b10000100 },
+						{ 0x6002, 0xe003, "C.LDSP", 0b00000100 },
+						{ 0xe002, 0xe003, "C.SDSP", 0b00000100 }
 					} 
 			},
 
 			{ 0x0, { 
 						{ 0x0, 0xe003, "C.ADDI4SPN", 0b00000000 },
-						{ 0x2000, 0xe003, "C.FLD", 0b00000000 },
-						{ 0x4000, 0xe003, "C.LW", 0b00000000 },
-						{ 0x6000, 0xe003, "C.FLW", 0b00000000 },
-						{ 0xa000, 0xe003, "C.FSD", 0b00000000 },
-						{ 0xc000, 0xe003, "C.SW", 0b00000000 },
-						{ 0xe000, 0xe003, "C.FSW", 0b00000000 },
-						{ 0x6000, 0xe003, "C.LD", 0b00000000 },
-						{ 0xe000, 0xe003, "C.SD", 0b00000000 }
-					} 
-			},
-
-			{ 0x21, { 
-						{ 0x8c21, 0xfc63, "C.XOR", 0b00000000 },
-						{ 0x9c21, 0xfc63, "C.ADDW", 0b00000000 }
-					} 
-			},
-
-			{ 0x41, {
-						{ 0x8c41, 0xfc63, "C.OR", 0b00000000 }
-					} 
-			},
-
-			{ 0x61, {
-						{ 0x8c61, 0xfc63, "C.AND", 0b00000000 }
+						{ 0x2000, 0xe003, "C.FLD", 0b10000100 },
+						{ 0x4000, 0xe003, "C.LW", 0b00000100 },
+						{ 0x6000, 0xe003, "C.FLW", 0b10000100 },
+						{ 0xa000, 0xe003, "C.FSD", 0b10000100 },
+						{ 0xc000, 0xe003, "C.SW", 0b00000100 },
+						{ 0xe000, 0xe003, "C.FSW", 0b10000100 },
+						{ 0x6000, 0xe003, "C.LD", 0b00000100 },
+						{ 0xe000, 0xe003, "C.SD", 0b00000100 }
 					} 
 			},
 
@@ -723,5 +745,19 @@ namespace riscv
 					}
 			} 
 		};
+
+		using instruction_entry = std::tuple<uint32_t, uint32_t, std::string_view, instruction_flags>;
+
+		//Looks up the { match, mask, mnemonic, flags } entry for a raw instruction, nullptr if we don't know it
+		//The most specific mask wins, ties between RV32 only and RV64 only compressed encodings are settled by arch
+		const instruction_entry* find_instruction(const uint32_t instruction, const isa arch = isa::RV64);
+
+		//Dense ids for mnemonics in name order, entries that share a name (RV32 and RV64 encodings) share an id.
+		//Only valid for entries find_instruction handed out, invalid_mnemonic for nullptr
+		constexpr uint16_t invalid_mnemonic = 0xffff;
+
+		const uint16_t get_mnemonic_id(const instruction_entry* entry);
+		const std::string_view get_mnemonic_name(const uint16_t id);
+		const size_t get_mnemonic_count();
 	}
 }
\ No newline at end of file
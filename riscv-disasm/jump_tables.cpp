@@ -0,0 +1,248 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "jump_tables.hpp"
+#include "constants.hpp"
+
+namespace riscv
+{
+	namespace analysis
+	{
+		namespace
+		{
+			struct fields
+			{
+				uint32_t opcode;
+				uint32_t rd;
+				uint32_t funct3;
+				uint32_t rs1;
+				uint32_t rs2;
+				uint32_t funct7;
+				int64_t imm;
+			};
+
+			fields decode(const instruction::object& instruction)
+			{
+				const uint32_t expanded = instruction.get_expanded();
+
+				return { expanded & 0x7f, (expanded >> 7) & 0x1f, (expanded >> 12) & 0x7, (expanded >> 15) & 0x1f, (expanded >> 20) & 0x1f, expanded >> 25, instruction.get_immediate() };
+			}
+
+			bool is_add(const fields& f)
+			{
+				return f.opcode == 0x33 && f.funct3 == 0 && f.funct7 == 0;
+			}
+
+			//LW, LD and LWU are the only loads compilers use for tables
+			uint8_t load_width(const fields& f)
+			{
+				if (f.opcode != 0x03)
+					return 0;
+
+				switch (f.funct3)
+				{
+				case 2:
+				case 6:
+					return 4;
+				case 3:
+					return 8;
+				default:
+					return 0;
+				}
+			}
+
+			//Last instruction before `before` that writes reg
+			std::optional<size_t> find_def(const std::vector<instruction::object>& history, const size_t before, const uint32_t reg)
+			{
+				for (size_t i = before; i-- > 0;)
+				{
+					if (history[i].get_register_usage().def & instruction::register_usage::x(reg))
+						return i;
+				}
+
+				return std::nullopt;
+			}
+
+			std::optional<uint64_t> value_before(const std::vector<instruction::object>& history, const std::vector<uint64_t>& addresses, const size_t at, const uint32_t reg, const isa arch)
+			{
+				constant_tracker tracker{ arch };
+
+				for (size_t i = 0; i < at; i++)
+					tracker.step(history[i], addresses[i]);
+
+				if (reg == 0 || !tracker.known(reg))
+					return std::nullopt;
+
+				return tracker.value(reg);
+			}
+		}
+
+		std::optional<jump_table> recover_jump_table(const image& img, const std::vector<instruction::object>& history, const std::vector<uint64_t>& addresses)
+		{
+			const isa arch = img.get_architecture();
+
+			if (history.empty())
+				return std::nullopt;
+
+			const size_t jump = history.size() - 1;
+			const fields jr = decode(history[jump]);
+
+			if (jr.opcode != 0x67 || jr.rd != 0)
+				return std::nullopt;
+
+			auto target_def = find_def(history, jump, jr.rs1);
+			if (!target_def)
+				return std::nullopt;
+
+			jump_table table{ addresses[jump], 0, 0, false, {} };
+			uint64_t relative_base = 0;
+			size_t load = *target_def;
+
+			//Relative tables add the table base back onto the loaded entry
+			const fields target = decode(history[*target_def]);
+			if (is_add(target)) {
+				bool found = false;
+
+				for (auto [loaded, other] : { std::pair{ target.rs1, target.rs2 }, std::pair{ target.rs2, target.rs1 } })
+				{
+					auto loaded_def = find_def(history, *target_def, loaded);
+					auto base = value_before(history, addresses, *target_def, other, arch);
+
+					if (loaded_def && base && load_width(decode(history[*loaded_def]))) {
+						load = *loaded_def;
+						relative_base = *base;
+						table.relative = true;
+						found = true;
+						break;
+					}
+				}
+
+				if (!found)
+					return std::nullopt;
+			}
+
+			const fields entry_load = decode(history[load]);
+			table.entry_size = load_width(entry_load);
+
+			if (!table.entry_size)
+				return std::nullopt;
+
+			auto address_def = find_def(history, load, entry_load.rs1);
+			if (!address_def)
+				return std::nullopt;
+
+			const fields address_add = decode(history[*address_def]);
+			if (!is_add(address_add))
+				return std::nullopt;
+
+			std::optional<uint64_t> table_base;
+			uint32_t scaled_index = 0;
+
+			for (auto [base, index] : { std::pair{ address_add.rs1, address_add.rs2 }, std::pair{ address_add.rs2, address_add.rs1 } })
+			{
+				table_base = value_before(history, addresses, *address_def, base, arch);
+
+				if (table_base) {
+					scaled_index = index;
+					break;
+				}
+			}
+
+			if (!table_base)
+				return std::nullopt;
+
+			table.table_address = *table_base + entry_load.imm;
+
+			auto shift_def = find_def(history, *address_def, scaled_index);
+			if (!shift_def)
+				return std::nullopt;
+
+			const fields shift = decode(history[*shift_def]);
+			const uint32_t expected_shift = table.entry_size == 8 ? 3 : 2;
+
+			if (shift.opcode != 0x13 || shift.funct3 != 1 || (shift.imm & 0x3f) != expected_shift)
+				return std::nullopt;
+
+			//Bounds check on the unscaled index, as long as nothing wrote the index in between
+			size_t entries = 0;
+			const uint32_t index = shift.rs1;
+			const auto index_def = find_def(history, *shift_def, index);
+
+			for (size_t i = *shift_def; i-- > 0;)
+			{
+				if (index_def && i <= *index_def)
+					break;
+
+				const fields branch = decode(history[i]);
+
+				if (branch.opcode != 0x63)
+					continue;
+
+				//bltu limit, index, default
+				if (branch.funct3 == 6 && branch.rs2 == index) {
+					if (auto limit = value_before(history, addresses, i, branch.rs1, arch))
+						entries = static_cast<size_t>(*limit) + 1;
+				}
+
+				//bgeu index, limit, default
+				if (branch.funct3 == 7 && branch.rs1 == index) {
+					if (auto limit = value_before(history, addresses, i, branch.rs2, arch))
+						entries = static_cast<size_t>(*limit);
+				}
+
+				break;
+			}
+
+			const bool bounded = entries != 0;
+			if (!bounded || entries > 0x10000)
+				entries = unbounded_table_limit;
+
+			for (size_t i = 0; i < entries; i++)
+			{
+				const uint64_t entry_address = table.table_address + i * table.entry_size;
+				uint64_t value = 0;
+
+				if (table.entry_size == 8) {
+					auto entry = img.read_value<uint64_t>(entry_address);
+					if (!entry)
+						break;
+
+					value = *entry;
+				} else {
+					auto entry = img.read_value<uint32_t>(entry_address);
+					if (!entry)
+						break;
+
+					value = entry_load.funct3 == 6 ? static_cast<uint64_t>(*entry) : static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(*entry)));
+				}
+
+				uint64_t destination = table.relative ? relative_base + value : value;
+
+				if (arch == isa::RV32)
+					destination &= 0xffffffff;
+
+				if ((destination & 1) || !img.is_code(destination))
+					break;
+
+				table.targets.push_back(destination);
+			}
+
+			if (table.targets.empty())
+				return std::nullopt;
+
+			return table;
+		}
+	}
+}
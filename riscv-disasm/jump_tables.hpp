@@ -0,0 +1,48 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "image.hpp"
+
+namespace riscv
+{
+	namespace analysis
+	{
+		struct jump_table
+		{
+			uint64_t jump_address;
+			uint64_t table_address;
+			uint8_t entry_size;
+
+			//PIC tables hold offsets from the table base instead of addresses
+			bool relative;
+			std::vector<uint64_t> targets;
+		};
+
+		//Tables without a bounds check we can find get read until the first entry that doesn't point at code, up to this many
+		constexpr size_t unbounded_table_limit = 256;
+
+		//Looks for the usual switch lowering in a straight line of code ending in an indirect jump:
+		//	bltu limit, index, default (or bgeu index, limit, default)
+		//	slli index, index, log2(entry size)
+		//	add address, index, table
+		//	lw/lwu/ld target, offset(address)
+		//	[add target, target, table]
+		//	jr target
+		//and reads the entries out of the image
+		std::optional<jump_table> recover_jump_table(const image& img, const std::vector<instruction::object>& history, const std::vector<uint64_t>& addresses);
+	}
+}
@@ -14,9 +14,459 @@
 //	You should have received a copy of the GNU General Public License
 //	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
 #include "riscv.hpp"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 int main(int argc, char* argv[])
 {
+	if (argc > 2 && std::string{ argv[1] } == "--trace") {
+		std::ifstream trace{ argv[2], std::ios::binary };
+
+		if (!trace) {
+			std::cerr << "can't open " << argv[2] << std::endl;
+			return 1;
+		}
+
+		const riscv::isa arch = argc > 3 && std::string{ argv[3] } == "--rv32" ? riscv::isa::RV32 : riscv::isa::RV64;
+
+		riscv::thread_pool pool;
+		riscv::trace_reader reader{ arch, pool };
+
+		reader.process(trace, std::cout);
+		return 0;
+	}
+
+	if (argc > 1 && std::string{ argv[1] } == "--stream") {
+		riscv::isa arch = riscv::isa::RV64;
+		uint64_t base_address = 0;
+		std::string path = "-";
+
+		for (int i = 2; i < argc; i++)
+		{
+			const std::string argument{ argv[i] };
+
+			if (argument == "--rv32")
+				arch = riscv::isa::RV32;
+			else if (argument == "--base" && i + 1 < argc)
+				base_address = std::stoull(argv[++i], nullptr, 16);
+			else
+				path = argument;
+		}
+
+		riscv::stream_disassembler disasm{ arch, base_address };
+
+		if (path == "-") {
+#ifdef _WIN32
+			_setmode(_fileno(stdin), _O_BINARY);
+#endif
+			std::ios::sync_with_stdio(false);
+			disasm.process(std::cin, std::cout);
+			return 0;
+		}
+
+		std::ifstream input{ path, std::ios::binary };
+
+		if (!input) {
+			std::cerr << "can't open " << path << std::endl;
+			return 1;
+		}
+
+		disasm.process(input, std::cout);
+		return 0;
+	}
+
+	if (argc > 2 && std::string{ argv[1] } == "--serve") {
+		try {
+			size_t images = 16;
+			riscv::load_options options;
+
+			for (int i = 3; i < argc; i++)
+			{
+				const std::string argument{ argv[i] };
+
+				if (argument == "--images" && i + 1 < argc)
+					images = std::stoul(argv[++i]);
+				else if (argument == "--rv32")
+					options.arch = riscv::isa::RV32;
+				else if (argument == "--base" && i + 1 < argc)
+					options.base = std::stoull(argv[++i], nullptr, 16);
+				else if (argument == "--map" && i + 1 < argc)
+					options.regions = riscv::read_load_map(argv[++i]);
+				else
+					throw std::invalid_argument("usage: --serve <socket> [--images <count>] [--rv32] [--base <hex>] [--map <file>]");
+			}
+
+			riscv::thread_pool pool;
+			riscv::server srv{ argv[2], pool, images, options };
+
+			srv.run();
+		} catch (const std::exception& error) {
+			std::cerr << error.what() << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	if (argc > 3 && std::string{ argv[1] } == "--request") {
+		try {
+			std::string request{ argv[3] };
+
+			for (int i = 4; i < argc; i++)
+				request += std::string{ "\n" } + argv[i];
+
+			std::cout << riscv::send_request(argv[2], request);
+		} catch (const std::exception& error) {
+			std::cerr << error.what() << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	if (argc > 3 && std::string{ argv[1] } == "--profile") {
+		try {
+			const riscv::image img = riscv::elf::load(std::string{ argv[2] });
+			const size_t top = argc > 5 && std::string{ argv[4] } == "--top" ? std::stoul(argv[5]) : 10;
+
+			riscv::thread_pool pool;
+			riscv::profile prof{ img, pool };
+
+			prof.add_samples(riscv::load_samples(argv[3]), pool);
+			prof.print(std::cout, top);
+		} catch (const std::exception& error) {
+			std::cerr << error.what() << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	if (argc > 3 && std::string{ argv[1] } == "--cost") {
+		try {
+			const riscv::analysis::cost_model model{ argv[2] };
+			const riscv::image img = riscv::elf::load(std::string{ argv[3] });
+
+			for (auto& function : riscv::analysis::find_functions(img))
+			{
+				if (argc > 4 && function.name != argv[4])
+					continue;
+
+				std::vector<uint8_t> code(function.reachable_end - function.begin);
+				img.read(function.begin, code.data(), code.size());
+
+				riscv::disassembler disasm{ code, img.get_architecture(), function.begin };
+
+				std::cout << function.name << ":\n";
+				riscv::analysis::print_block_costs(std::cout, model, disasm);
+				std::cout << "\n";
+			}
+		} catch (const std::exception& error) {
+			std::cerr << error.what() << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	if (argc > 2 && std::string{ argv[1] } == "--fusion") {
+		try {
+			const riscv::image img = riscv::elf::load(std::string{ argv[2] });
+
+			uint32_t enabled = riscv::analysis::all_fusions;
+			bool listing = false;
+
+			for (int i = 3; i < argc; i++)
+			{
+				const std::string option{ argv[i] };
+
+				if (option == "--listing")
+					listing = true;
+				else if (option == "--pairs" && i + 1 < argc)
+					enabled = riscv::analysis::parse_fusion_set(argv[++i]);
+			}
+
+			for (auto& function : riscv::analysis::find_functions(img))
+			{
+				std::vector<uint8_t> code(function.reachable_end - function.begin);
+				img.read(function.begin, code.data(), code.size());
+
+				riscv::disassembler disasm{ code, img.get_architecture(), function.begin };
+				riscv::analysis::print_fusion_report(std::cout, function.name, disasm, enabled, listing);
+			}
+		} catch (const std::exception& error) {
+			std::cerr << error.what() << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	if (argc > 2 && std::string{ argv[1] } == "--stats") {
+		try {
+			const riscv::image img = riscv::elf::load(std::string{ argv[2] });
+			riscv::thread_pool pool;
+
+			riscv::analysis::write_mix_report(std::cout, img, pool);
+		} catch (const std::exception& error) {
+			std::cerr << error.what() << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	if (argc > 3 && std::string{ argv[1] } == "--view") {
+		try {
+			riscv::load_options options;
+			std::vector<std::string> positional;
+
+			for (int i = 2; i < argc; i++)
+			{
+				const std::string argument{ argv[i] };
+
+				if (argument == "--rv32")
+					options.arch = riscv::isa::RV32;
+				else if (argument == "--base" && i + 1 < argc)
+					options.base = std::stoull(argv[++i], nullptr, 16);
+				else if (argument == "--map" && i + 1 < argc)
+					options.regions = riscv::read_load_map(argv[++i]);
+				else
+					positional.push_back(argument);
+			}
+
+			if (positional.size() < 2)
+				throw std::invalid_argument("usage: --view [--rv32] [--base <hex>] [--map <file>] <file> <address> [before] [after]");
+
+			const uint64_t address = std::stoull(positional[1], nullptr, 16);
+			const size_t before = positional.size() > 2 ? std::stoul(positional[2]) : 25;
+			const size_t after = positional.size() > 3 ? std::stoul(positional[3]) : 25;
+
+			const riscv::image img = riscv::load_image(positional[0], options);
+			const riscv::segment* seg = img.find_segment(address);
+
+			if (!seg)
+				throw std::runtime_error("nothing mapped at that address");
+
+			riscv::code_view view{ img, *seg };
+			view.print(std::cout, address, before, after + 1);
+		} catch (const std::exception& error) {
+			std::cerr << error.what() << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	if (argc > 3 && std::string{ argv[1] } == "--diff") {
+		try {
+			const riscv::image left = riscv::elf::load(std::string{ argv[2] });
+			const riscv::image right = riscv::elf::load(std::string{ argv[3] });
+			riscv::thread_pool pool;
+
+			const riscv::analysis::binary_diff diff{ left, right, pool };
+			diff.print(std::cout);
+		} catch (const std::exception& error) {
+			std::cerr << error.what() << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	if (argc > 3 && std::string{ argv[1] } == "--search") {
+		try {
+			riscv::load_options options;
+			std::vector<std::string> files;
+
+			for (int i = 3; i < argc; i++)
+			{
+				const std::string argument{ argv[i] };
+
+				if (argument == "--rv32")
+					options.arch = riscv::isa::RV32;
+				else if (argument == "--base" && i + 1 < argc)
+					options.base = std::stoull(argv[++i], nullptr, 16);
+				else if (argument == "--map" && i + 1 < argc)
+					options.regions = riscv::read_load_map(argv[++i]);
+				else
+					files.push_back(argument);
+			}
+
+			riscv::thread_pool pool;
+
+			for (auto& file : files)
+			{
+				const riscv::image img = riscv::load_image(file, options);
+
+				//Compressed encodings mean different things on RV32 and RV64, so the pattern follows the image
+				const riscv::analysis::instruction_pattern pattern{ argv[2], img.get_architecture() };
+				riscv::disassembler formatter{ img.get_architecture() };
+				const auto hits = riscv::analysis::search(img, pattern, pool);
+
+				for (const uint64_t address : hits)
+				{
+					uint32_t raw = *img.read_value<uint16_t>(address);
+
+					if ((raw & 0x3) == 0x3)
+						raw |= static_cast<uint32_t>(*img.read_value<uint16_t>(address + 2)) << 16;
+
+					std::cout << file << ": 0x" << std::hex << address << ": ";
+					formatter.format(std::cout, riscv::instruction::object{ raw, img.get_architecture() }, address);
+					std::cout << "\n";
+				}
+			}
+		} catch (const std::exception& error) {
+			std::cerr << error.what() << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	if (argc > 2 && std::string{ argv[1] } == "--core") {
+		std::string executable;
+		size_t before = 8;
+		size_t after = 8;
+		std::vector<std::string> cores;
+
+		for (int i = 2; i < argc; i++)
+		{
+			const std::string argument{ argv[i] };
+
+			if (argument == "--exe" && i + 1 < argc)
+				executable = argv[++i];
+			else if (argument == "--before" && i + 1 < argc)
+				before = std::stoul(argv[++i]);
+			else if (argument == "--after" && i + 1 < argc)
+				after = std::stoul(argv[++i]);
+			else
+				cores.push_back(argument);
+		}
+
+		//Every core on its own, printed in the order given
+		riscv::thread_pool pool;
+		std::vector<std::string> reports(cores.size());
+		std::vector<std::string> errors(cores.size());
+
+		pool.parallel_for(cores.size(), [&](const size_t i)
+		{
+			try {
+				riscv::core::dump core = riscv::core::load(cores[i]);
+
+				if (!executable.empty())
+					riscv::core::add_executable(core, executable);
+
+				std::ostringstream out;
+				out << "; " << cores[i] << "\n";
+				riscv::core::print_threads(out, core, before, after);
+				reports[i] = out.str();
+			} catch (const std::exception& error) {
+				errors[i] = cores[i] + ": " + error.what();
+			}
+		});
+
+		bool failed = false;
+
+		for (size_t i = 0; i < cores.size(); i++)
+		{
+			std::cout << reports[i];
+
+			if (!errors[i].empty()) {
+				std::cerr << errors[i] << std::endl;
+				failed = true;
+			}
+		}
+
+		return failed ? 1 : 0;
+	}
+
+	if (argc > 3 && std::string{ argv[1] } == "--batch") {
+		try {
+			riscv::thread_pool pool;
+			const std::vector<std::filesystem::path> paths{ argv + 3, argv + argc };
+
+			const auto inputs = riscv::collect_inputs(paths, argv[2]);
+			const size_t failed = riscv::run_batch(inputs, pool, std::cerr);
+
+			std::cerr << std::dec << inputs.size() - failed << " of " << inputs.size() << " inputs listed" << std::endl;
+
+			if (failed)
+				return 1;
+		} catch (const std::exception& error) {
+			std::cerr << error.what() << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	if (argc > 3 && std::string{ argv[1] } == "--store") {
+		try {
+			riscv::thread_pool pool;
+			riscv::function_store store{ argv[2] };
+
+			for (int i = 3; i < argc; i++)
+			{
+				const riscv::image img = riscv::elf::load(std::string{ argv[i] });
+				riscv::program prog{ img, pool, {}, &store };
+
+				prog.analyze();
+
+				std::cout << "; " << argv[i] << "\n";
+				prog.print(std::cout);
+			}
+
+			std::cerr << std::dec << store.get_hits() << " functions reused, " << store.get_misses() << " analyzed" << std::endl;
+		} catch (const std::exception& error) {
+			std::cerr << error.what() << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	if (argc > 1) {
+		try {
+			riscv::load_options options;
+			std::string path;
+
+			for (int i = 1; i < argc; i++)
+			{
+				const std::string argument{ argv[i] };
+
+				if (argument == "--rv32")
+					options.arch = riscv::isa::RV32;
+				else if (argument == "--base" && i + 1 < argc)
+					options.base = std::stoull(argv[++i], nullptr, 16);
+				else if (argument == "--map" && i + 1 < argc)
+					options.regions = riscv::read_load_map(argv[++i]);
+				else
+					path = argument;
+			}
+
+			const riscv::image img = riscv::load_image(path, options);
+
+			riscv::thread_pool pool;
+			riscv::program prog{ img, pool };
+			riscv::output_writer writer{ std::cout };
+
+			prog.write(writer);
+			writer.finish();
+		} catch (const std::exception& error) {
+			std::cerr << error.what() << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
 	std::vector<uint32_t> inst_test = { 
 		0xE218103, 0x00850463, 0x00002e17, 0xee1ff0ef, 0x00E12423, 
 		0x4027d79b, 0x40f707bb, 0x0CF2030F, 0x940133, 0x1e30a12f, 0x1200a12f,
@@ -0,0 +1,277 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "profile.hpp"
+#include "analysis.hpp"
+#include "constants.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+namespace riscv
+{
+	namespace
+	{
+		bool looks_like_text(const std::vector<uint8_t>& file)
+		{
+			const size_t checked = std::min<size_t>(file.size(), 4096);
+
+			for (size_t i = 0; i < checked; i++)
+			{
+				const uint8_t c = file[i];
+
+				if (c < 0x20 && c != '\n' && c != '\r' && c != '\t')
+					return false;
+			}
+
+			return true;
+		}
+
+		void parse_text_samples(const std::vector<uint8_t>& file, std::vector<sample>& samples)
+		{
+			const char* position = reinterpret_cast<const char*>(file.data());
+			const char* const end = position + file.size();
+
+			while (position < end)
+			{
+				const char* line_end = static_cast<const char*>(std::memchr(position, '\n', end - position));
+				if (!line_end)
+					line_end = end;
+
+				const char* cursor = position;
+
+				while (cursor < line_end && (*cursor == ' ' || *cursor == '\t'))
+					cursor++;
+
+				if (line_end - cursor > 2 && cursor[0] == '0' && (cursor[1] == 'x' || cursor[1] == 'X'))
+					cursor += 2;
+
+				uint64_t pc = 0;
+				size_t digits = 0;
+
+				for (; cursor < line_end; cursor++, digits++)
+				{
+					const char c = *cursor;
+
+					if (c >= '0' && c <= '9')
+						pc = (pc << 4) | (c - '0');
+					else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+						pc = (pc << 4) | ((c | 0x20) - 'a' + 10);
+					else
+						break;
+				}
+
+				if (digits) {
+					while (cursor < line_end && (*cursor == ' ' || *cursor == '\t'))
+						cursor++;
+
+					uint64_t count = 1;
+
+					if (cursor < line_end && *cursor >= '0' && *cursor <= '9') {
+						for (count = 0; cursor < line_end && *cursor >= '0' && *cursor <= '9'; cursor++)
+							count = count * 10 + (*cursor - '0');
+					}
+
+					if (count)
+						samples.push_back({ pc, count });
+				}
+
+				position = line_end + 1;
+			}
+		}
+
+		std::string percentage(const uint64_t count, const uint64_t total)
+		{
+			std::ostringstream out;
+			out << std::fixed << std::setprecision(2) << (total ? 100.0 * count / total : 0.0) << "%";
+			return out.str();
+		}
+	}
+
+	std::vector<sample> load_samples(const std::string& path)
+	{
+		const std::vector<uint8_t> file = read_file(path);
+		std::vector<sample> samples;
+
+		if (looks_like_text(file)) {
+			parse_text_samples(file, samples);
+			return samples;
+		}
+
+		samples.resize(file.size() / sizeof(uint64_t));
+
+		for (size_t i = 0; i < samples.size(); i++)
+		{
+			std::memcpy(&samples[i].pc, file.data() + i * sizeof(uint64_t), sizeof(uint64_t));
+			samples[i].weight = 1;
+		}
+
+		return samples;
+	}
+
+	profile::profile(const image& img, thread_pool& pool) : m_image{ img }, m_functions{ analysis::find_functions(img) }
+	{
+		m_code.resize(m_functions.size());
+
+		pool.parallel_for(m_functions.size(), [this](const size_t index)
+		{
+			const analysis::function& function = m_functions[index];
+
+			std::vector<uint8_t> code(function.end - function.begin);
+			m_image.read(function.begin, code.data(), code.size());
+
+			m_code[index] = std::make_unique<disassembler>(code, m_image.get_architecture(), function.begin);
+		});
+
+		for (auto& code : m_code)
+		{
+			m_function_start.push_back(m_index.size());
+			m_index.insert(m_index.end(), code->get_addresses().begin(), code->get_addresses().end());
+
+			for (auto& instruction : code->get_decoded())
+				m_lengths.push_back(static_cast<uint8_t>(instruction.get_length()));
+		}
+
+		m_function_start.push_back(m_index.size());
+		m_counts.assign(m_index.size(), 0);
+	}
+
+	void profile::add_samples(const std::vector<sample>& samples, thread_pool& pool)
+	{
+		//Each slice sorts its own share and walks it alongside the index, so binning is a merge rather than a search per
+		//sample and only the instructions that were actually hit come back to be added up
+		const size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+		const size_t slices = std::max<size_t>(1, std::min<size_t>(samples.size() / 65536, threads * 4));
+		const size_t slice_size = (samples.size() + slices - 1) / slices;
+
+		std::vector<std::vector<std::pair<size_t, uint64_t>>> hits(slices);
+		std::vector<uint64_t> missed(slices, 0);
+		std::vector<uint64_t> weights(slices, 0);
+
+		pool.parallel_for(slices, [&](const size_t slice)
+		{
+			const size_t first = std::min(samples.size(), slice * slice_size);
+			const size_t last = std::min(samples.size(), first + slice_size);
+
+			std::vector<sample> sorted{ samples.begin() + first, samples.begin() + last };
+			std::sort(sorted.begin(), sorted.end(), [](const sample& a, const sample& b) { return a.pc < b.pc; });
+
+			auto& local = hits[slice];
+			auto instruction = m_index.begin();
+
+			for (const auto& [pc, weight] : sorted)
+			{
+				weights[slice] += weight;
+
+				//Instruction containing the pc, which has to be the last one starting at or before it
+				instruction = std::upper_bound(instruction, m_index.end(), pc);
+
+				if (instruction == m_index.begin() || pc - *(instruction - 1) >= m_lengths[instruction - m_index.begin() - 1]) {
+					missed[slice] += weight;
+					continue;
+				}
+
+				const size_t index = instruction - m_index.begin() - 1;
+
+				if (!local.empty() && local.back().first == index)
+					local.back().second += weight;
+				else
+					local.emplace_back(index, weight);
+
+				//Same pc again is the common case
+				--instruction;
+			}
+		});
+
+		for (size_t slice = 0; slice < slices; slice++)
+		{
+			for (auto& [index, count] : hits[slice])
+				m_counts[index] += count;
+
+			m_unattributed += missed[slice];
+			m_total += weights[slice];
+		}
+	}
+
+	const uint64_t profile::function_samples(const size_t function) const
+	{
+		return std::accumulate(m_counts.begin() + m_function_start[function], m_counts.begin() + m_function_start[function + 1], uint64_t{ 0 });
+	}
+
+	void profile::print_function(std::ostream& out, const size_t function) const
+	{
+		const disassembler& code = *m_code[function];
+		auto& instructions = code.get_decoded();
+		auto& addresses = code.get_addresses();
+		const size_t first = m_function_start[function];
+
+		const auto leaders = analysis::find_leaders(instructions, addresses, analysis::function_range{ 0, instructions.size() });
+		const auto resolved = analysis::propagate_constants(instructions, addresses, code.get_architecture());
+		auto next_resolved = resolved.begin();
+
+		const uint64_t samples = function_samples(function);
+		out << m_functions[function].name << ": " << std::dec << samples << " samples (" << percentage(samples, m_total) << ")\n";
+
+		for (size_t i = 0; i < instructions.size(); i++)
+		{
+			if (leaders[i]) {
+				size_t block_end = i + 1;
+				while (block_end < instructions.size() && !leaders[block_end])
+					block_end++;
+
+				const uint64_t block_samples = std::accumulate(m_counts.begin() + first + i, m_counts.begin() + first + block_end, uint64_t{ 0 });
+				out << "; block 0x" << std::hex << addresses[i] << ": " << std::dec << block_samples << " samples (" << percentage(block_samples, m_total) << ")\n";
+			}
+
+			const uint64_t count = m_counts[first + i];
+			out << std::dec << std::setw(10) << count << std::setw(8) << percentage(count, m_total) << "  0x" << std::hex << addresses[i] << ": ";
+			code.format(out, instructions[i], addresses[i]);
+
+			if (next_resolved != resolved.end() && next_resolved->index == i) {
+				out << " # 0x" << std::hex << next_resolved->value;
+				++next_resolved;
+			}
+
+			out << "\n";
+		}
+	}
+
+	void profile::print(std::ostream& out, const size_t top_functions) const
+	{
+		std::vector<std::pair<uint64_t, size_t>> hottest;
+
+		for (size_t i = 0; i < m_functions.size(); i++)
+		{
+			if (const uint64_t samples = function_samples(i))
+				hottest.emplace_back(samples, i);
+		}
+
+		std::sort(hottest.begin(), hottest.end(), [](const auto& a, const auto& b) { return a.first > b.first || (a.first == b.first && a.second < b.second); });
+
+		if (hottest.size() > top_functions)
+			hottest.resize(top_functions);
+
+		out << std::dec << m_total << " samples, " << m_unattributed << " outside of any function\n";
+
+		for (auto& [samples, function] : hottest)
+		{
+			out << "\n";
+			print_function(out, function);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "disassembler.hpp"
+#include "functions.hpp"
+#include "thread_pool.hpp"
+#include <memory>
+
+namespace riscv
+{
+	struct sample
+	{
+		uint64_t pc;
+		uint64_t weight;
+	};
+
+	//Text files hold one hex pc per line, optionally followed by a decimal sample count (lines counting 0 are skipped).
+	//Anything else is taken as raw little endian 64 bit pcs, one sample each
+	std::vector<sample> load_samples(const std::string& path);
+
+	class profile
+	{
+		const image& m_image;
+		std::vector<analysis::function> m_functions;
+		std::vector<std::unique_ptr<disassembler>> m_code;
+
+		//Every decoded instruction address in the image, sorted, with each function owning a contiguous run
+		std::vector<uint64_t> m_index;
+		std::vector<uint8_t> m_lengths;
+		std::vector<size_t> m_function_start;
+		std::vector<uint64_t> m_counts;
+
+		uint64_t m_total = 0;
+		uint64_t m_unattributed = 0;
+
+		const uint64_t function_samples(const size_t function) const;
+		void print_function(std::ostream& out, const size_t function) const;
+
+	public:
+		profile() = delete;
+		profile(const profile& prof) = delete;
+		profile(profile&& prof) = delete;
+
+		profile(const image& img, thread_pool& pool);
+
+		void add_samples(const std::vector<sample>& samples, thread_pool& pool);
+
+		//Hottest functions first, each with per block and per instruction counts
+		void print(std::ostream& out, const size_t top_functions = 10) const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "program.hpp"
+#include "disassembler.hpp"
+#include <algorithm>
+#include <sstream>
+
+namespace riscv
+{
+	program::program(const image& img, thread_pool& pool, const std::vector<uint64_t>& entry_points, function_store* store) : m_image{ img }, m_pool{ pool }, m_store{ store }, m_functions{ analysis::find_functions(img, entry_points) }
+	{
+		m_listings.resize(m_functions.size());
+	}
+
+	void program::analyze_function(const size_t index)
+	{
+		const analysis::function& function = m_functions[index];
+
+		std::vector<uint8_t> code(function.end - function.begin);
+		m_image.read(function.begin, code.data(), code.size());
+
+		const isa arch = m_image.get_architecture();
+
+		std::ostringstream out;
+		out << function.name << ":\n";
+
+		if (m_store) {
+			const store_key key = make_store_key(code.data(), code.size(), arch);
+			auto entry = m_store->find(key);
+
+			if (!entry) {
+				if (auto made = make_function_template(code, arch, function.begin))
+					entry = m_store->insert(key, std::move(*made));
+			}
+
+			if (entry) {
+				entry->render(out, function.begin, arch);
+				m_listings[index] = out.str();
+				return;
+			}
+		}
+
+		disassembler disasm{ code, arch, function.begin };
+		disasm.parse_instructions(out);
+
+		m_listings[index] = out.str();
+	}
+
+	void program::analyze()
+	{
+		//Every task writes only its own slot, no locking needed
+		m_pool.parallel_for(m_functions.size(), [this](const size_t index) { analyze_function(index); });
+	}
+
+	void program::reanalyze(const size_t index)
+	{
+		analyze_function(index);
+	}
+
+	void program::print(std::ostream& out) const
+	{
+		for (size_t i = 0; i < m_listings.size(); i++)
+		{
+			if (i)
+				out << "\n";
+
+			out << m_listings[i];
+		}
+	}
+
+	void program::write(output_writer& writer)
+	{
+		const size_t window = std::max<size_t>(64, m_pool.size() * 16);
+
+		for (size_t first = 0; first < m_functions.size(); first += window)
+		{
+			const size_t count = std::min(window, m_functions.size() - first);
+
+			m_pool.parallel_for(count, [this, first](const size_t index) { analyze_function(first + index); });
+
+			for (size_t i = first; i < first + count; i++)
+			{
+				if (i)
+					writer.submit("\n");
+
+				writer.submit(std::move(m_listings[i]));
+				m_listings[i].clear();
+			}
+		}
+	}
+
+	const std::vector<analysis::function>& program::get_functions() const
+	{
+		return m_functions;
+	}
+
+	const std::string& program::get_listing(const size_t index) const
+	{
+		return m_listings[index];
+	}
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "functions.hpp"
+#include "store.hpp"
+#include "thread_pool.hpp"
+#include "writer.hpp"
+#include <ostream>
+
+namespace riscv
+{
+	//Whole program listing, decoded, analyzed and formatted one function at a time so functions can go to
+	//different threads and any single one can be redone without touching the rest. With a store, functions
+	//already analyzed in some other image are only rendered at their new address
+	class program
+	{
+		const image& m_image;
+		thread_pool& m_pool;
+		function_store* m_store;
+		std::vector<analysis::function> m_functions;
+		std::vector<std::string> m_listings;
+
+		void analyze_function(const size_t index);
+
+	public:
+		program() = delete;
+		program(const program& prog) = delete;
+		program(program&& prog) = delete;
+
+		program(const image& img, thread_pool& pool, const std::vector<uint64_t>& entry_points = {}, function_store* store = nullptr);
+
+		void analyze();
+		void reanalyze(const size_t index);
+
+		//Functions in address order
+		void print(std::ostream& out) const;
+
+		//analyze() and print() overlapped: functions are analyzed a window at a time and each window goes to the
+		//writer while the next one is being worked on. The listings are handed over, not kept
+		void write(output_writer& writer);
+
+		const std::vector<analysis::function>& get_functions() const;
+		const std::string& get_listing(const size_t index) const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,148 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "instructions.hpp"
+
+namespace riscv
+{
+	namespace instruction
+	{
+		namespace
+		{
+			//rs2 is part of the encoding (LR, FSQRT, FCVT, ...) when the mask covers bits 20-24
+			constexpr uint32_t rs2_field_mask = 0x01f00000;
+
+			//funct5 groups of OP-FP where rd or rs1 live in the integer register file
+			constexpr bool float_rd_is_x(const uint32_t funct5)
+			{
+				return funct5 == 0x14 || funct5 == 0x18 || funct5 == 0x1C; //FEQ/FLT/FLE, FCVT.W*.fmt, FMV.X.fmt/FCLASS
+			}
+
+			constexpr bool float_rs1_is_x(const uint32_t funct5)
+			{
+				return funct5 == 0x1A || funct5 == 0x1E; //FCVT.fmt.W*, FMV.fmt.X
+			}
+		}
+
+		const register_usage object::get_register_usage() const
+		{
+			register_usage usage{};
+
+			//Compressed instructions touch exactly what their expansion does
+			if (m_type == type_identifier::CEXT)
+				return m_expanded ? object{ m_expanded }.get_register_usage() : usage;
+
+			const uint32_t raw = get_raw();
+			const instruction_entry* entry = find_instruction(raw);
+
+			if (!entry)
+				return usage;
+
+			auto& [proper_opcode, mask, mnemonic, flags] { *entry };
+
+			switch (m_type)
+			{
+			case type_identifier::R: {
+				auto& instruction = std::get<type_r>(m_data);
+				const bool has_rs2 = (mask & rs2_field_mask) != rs2_field_mask;
+
+				if (flags.is_float) {
+					const uint32_t funct5 = instruction.funct7 >> 2;
+
+					usage.def |= float_rd_is_x(funct5) ? register_usage::x(instruction.rd) : register_usage::f(instruction.rd);
+					usage.use |= float_rs1_is_x(funct5) ? register_usage::x(instruction.rs1) : register_usage::f(instruction.rs1);
+
+					if (has_rs2)
+						usage.use |= register_usage::f(instruction.rs2);
+
+					break;
+				}
+
+				//Integer ops and the A extension, LR has rs2 baked into the encoding
+				usage.def |= register_usage::x(instruction.rd);
+				usage.use |= register_usage::x(instruction.rs1);
+
+				if (has_rs2)
+					usage.use |= register_usage::x(instruction.rs2);
+
+				break;
+			}
+
+			case type_identifier::R4: {
+				auto& instruction = std::get<type_r4>(m_data);
+
+				usage.def |= register_usage::f(instruction.rd);
+				usage.use |= register_usage::f(instruction.rs1) | register_usage::f(instruction.rs2) | register_usage::f(instruction.rs3);
+				break;
+			}
+
+			case type_identifier::I: {
+				auto& instruction = std::get<type_i>(m_data);
+
+				if (flags.is_fence || flags.is_e_sys)
+					break;
+
+				//Zicsr, funct3 & 3 is 1 for RW, 2 for RS and 3 for RC
+				if (instruction.opcode == 0x73) {
+					const uint32_t operation = instruction.funct3 & 0x3;
+
+					usage.csr = static_cast<uint16_t>(instruction.imm & 0xfff);
+					usage.csr_read = operation != 1 || instruction.rd != 0;
+					usage.csr_write = operation == 1 || instruction.rs1 != 0;
+					usage.def |= register_usage::x(instruction.rd);
+
+					if (!flags.is_imm_csr)
+						usage.use |= register_usage::x(instruction.rs1);
+
+					break;
+				}
+
+				//Float loads still take their base address from an integer register
+				usage.def |= flags.is_float ? register_usage::f(instruction.rd) : register_usage::x(instruction.rd);
+				usage.use |= register_usage::x(instruction.rs1);
+				break;
+			}
+
+			case type_identifier::S: {
+				auto& instruction = std::get<type_s>(m_data);
+
+				usage.use |= register_usage::x(instruction.rs1);
+				usage.use |= flags.is_float ? register_usage::f(instruction.rs2) : register_usage::x(instruction.rs2);
+				break;
+			}
+
+			case type_identifier::B: {
+				auto& instruction = std::get<type_b>(m_data);
+
+				usage.use |= register_usage::x(instruction.rs1) | register_usage::x(instruction.rs2);
+				break;
+			}
+
+			case type_identifier::U:
+				usage.def |= register_usage::x(std::get<type_u>(m_data).rd);
+				break;
+
+			case type_identifier::J:
+				usage.def |= register_usage::x(std::get<type_j>(m_data).rd);
+				break;
+
+			default:
+				break;
+			}
+
+			return usage;
+		}
+	}
+}
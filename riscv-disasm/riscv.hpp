@@ -16,7 +16,29 @@
 #pragma once
 
 #include <cstdint>
+#include "arena.hpp"
+#include "archive.hpp"
+#include "batch.hpp"
+#include "boundaries.hpp"
+#include "columns.hpp"
+#include "core.hpp"
+#include "cost_model.hpp"
+#include "diff.hpp"
 #include "disassembler.hpp"
+#include "elf.hpp"
+#include "firmware.hpp"
+#include "fusion.hpp"
+#include "instruction_range.hpp"
+#include "profile.hpp"
+#include "program.hpp"
+#include "search.hpp"
+#include "server.hpp"
+#include "stats.hpp"
+#include "store.hpp"
+#include "stream.hpp"
+#include "trace.hpp"
+#include "view.hpp"
+#include "writer.hpp"
 
 namespace riscv
 {
@@ -0,0 +1,270 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#define RISCV_DISASM_EXPORTS
+#include "riscv_disasm.h"
+#include "columns.hpp"
+#include "trace.hpp"
+#include <cstring>
+
+static_assert(sizeof(riscv_instruction) == 32, "riscv_instruction is part of the ABI");
+static_assert(static_cast<int>(riscv::instruction::extensions::C) == RISCV_EXT_C, "riscv_extension has to follow instruction::extensions");
+
+struct riscv_decoder
+{
+	//Records by raw encoding with the address left at 0, direct mapped like decode_cache
+	struct slot
+	{
+		bool valid = false;
+		riscv_instruction record;
+	};
+
+	const riscv::isa arch;
+	const uint32_t extensions;
+
+	riscv::disassembler formatter;
+	riscv::decode_cache text;
+	std::vector<slot> records;
+	std::string line;
+
+	static constexpr uint32_t cache_bits = 12;
+
+	riscv_decoder(const riscv::isa isa, const uint32_t extension_set) : arch{ isa }, extensions{ extension_set }, formatter{ isa }, text{ formatter }, records(size_t{ 1 } << cache_bits)
+	{}
+
+	const riscv_instruction& lookup(const uint32_t raw)
+	{
+		slot& entry = records[static_cast<uint32_t>(raw * 0x9e3779b1u) >> (32 - cache_bits)];
+
+		if (entry.valid && entry.record.raw == raw)
+			return entry.record;
+
+		const riscv::instruction::object instruction{ raw, arch };
+		const uint32_t expanded = instruction.get_expanded();
+		const uint8_t extension = static_cast<uint8_t>(instruction.get_extension());
+
+		const riscv::instruction::instruction_entry* found = expanded ? riscv::instruction::find_instruction(raw, arch) : nullptr;
+
+		if (!(extensions & RISCV_EXT_BIT(extension)))
+			found = nullptr;
+
+		//C.FLD needs D as well as C, C.FLW needs F and so on
+		if (found && extension == RISCV_EXT_C && !(extensions & RISCV_EXT_BIT(static_cast<uint8_t>(riscv::instruction::object{ expanded, arch }.get_extension()))))
+			found = nullptr;
+
+		const riscv::operand_fields fields = found ? riscv::get_operand_fields(expanded) : riscv::operand_fields{};
+
+		entry.valid = true;
+		entry.record = riscv_instruction{ 0, raw, expanded, found ? instruction.get_immediate() : 0, riscv::instruction::get_mnemonic_id(found),
+			instruction.get_length(), extension, fields.rd, fields.rs1, fields.rs2, fields.rs3, 0 };
+
+		return entry.record;
+	}
+};
+
+namespace
+{
+	thread_local std::string last_error;
+
+	void fail(const char* message)
+	{
+		last_error = message;
+	}
+
+	//Every entry point starts with this, so the message always belongs to the most recent call
+	void clear_error()
+	{
+		last_error.clear();
+	}
+}
+
+extern "C"
+{
+	uint32_t riscv_api_version(void)
+	{
+		clear_error();
+
+		return RISCV_API_VERSION;
+	}
+
+	const char* riscv_last_error(void)
+	{
+		return last_error.c_str();
+	}
+
+	riscv_decoder* riscv_decoder_create(riscv_isa isa, uint32_t extensions)
+	{
+		clear_error();
+
+		if (isa != RISCV_ISA_RV32 && isa != RISCV_ISA_RV64) {
+			fail("unsupported isa");
+			return nullptr;
+		}
+
+		try {
+			return new riscv_decoder{ isa == RISCV_ISA_RV32 ? riscv::isa::RV32 : riscv::isa::RV64, extensions & RISCV_EXT_ALL };
+		} catch (const std::exception& error) {
+			fail(error.what());
+			return nullptr;
+		}
+	}
+
+	void riscv_decoder_destroy(riscv_decoder* decoder)
+	{
+		clear_error();
+
+		delete decoder;
+	}
+
+	size_t riscv_decode(riscv_decoder* decoder, const uint8_t* code, size_t size, uint64_t address, riscv_instruction* out, size_t capacity, size_t* consumed)
+	{
+		clear_error();
+
+		size_t offset = 0;
+		size_t count = 0;
+
+		if (!decoder || (!code && size) || (!out && capacity)) {
+			fail("invalid argument");
+		} else {
+			try {
+				while (count < capacity && offset + 2 <= size)
+				{
+					uint32_t raw = code[offset] | (code[offset + 1] << 8);
+
+					if ((raw & 0x3) == 0x3) {
+						//Cut off in the middle of a 32 bit instruction
+						if (offset + 4 > size)
+							break;
+
+						raw |= (code[offset + 2] << 16) | (static_cast<uint32_t>(code[offset + 3]) << 24);
+					}
+
+					riscv_instruction& record = out[count++];
+
+					record = decoder->lookup(raw);
+					record.address = address + offset;
+					offset += record.length;
+				}
+			} catch (const std::exception& error) {
+				fail(error.what());
+			}
+		}
+
+		if (consumed)
+			*consumed = offset;
+
+		return count;
+	}
+
+	size_t riscv_format(riscv_decoder* decoder, const riscv_instruction* instructions, size_t count, uint32_t flags, char* buffer, size_t size, size_t* written, size_t* line_offsets)
+	{
+		clear_error();
+
+		size_t used = 0;
+		size_t done = 0;
+
+		if (!decoder || (!instructions && count) || (!buffer && size)) {
+			fail("invalid argument");
+		} else {
+			try {
+				std::string& line = decoder->line;
+
+				for (; done < count; done++)
+				{
+					const riscv_instruction& record = instructions[done];
+					line.clear();
+
+					if (flags & RISCV_FORMAT_ADDRESS) {
+						riscv::append_hex(line, record.address);
+						line += ": ";
+					}
+
+					//Left out of the decoder's extension set, show it the way the listing shows unknown encodings
+					if (record.mnemonic == RISCV_INVALID_MNEMONIC) {
+						line += record.length == 2 ? ".half " : ".word ";
+						riscv::append_hex(line, record.raw);
+					} else {
+						decoder->text.format(line, record.raw, record.address);
+					}
+
+					line += '\n';
+
+					if (line.size() > size - used)
+						break;
+
+					std::memcpy(buffer + used, line.data(), line.size());
+
+					if (line_offsets)
+						line_offsets[done] = used;
+
+					used += line.size();
+				}
+			} catch (const std::exception& error) {
+				fail(error.what());
+			}
+		}
+
+		if (written)
+			*written = used;
+
+		return done;
+	}
+
+	size_t riscv_mnemonic_count(void)
+	{
+		clear_error();
+
+		return riscv::instruction::get_mnemonic_count();
+	}
+
+	const char* riscv_mnemonic_name(uint16_t mnemonic)
+	{
+		clear_error();
+
+		//The names are the table's string literals, so they are NUL terminated
+		if (mnemonic >= riscv::instruction::get_mnemonic_count())
+			return nullptr;
+
+		return riscv::instruction::get_mnemonic_name(mnemonic).data();
+	}
+
+	uint16_t riscv_mnemonic_find(const char* name)
+	{
+		clear_error();
+
+		if (!name)
+			return RISCV_INVALID_MNEMONIC;
+
+		const std::string_view wanted{ name };
+
+		size_t low = 0;
+		size_t high = riscv::instruction::get_mnemonic_count();
+
+		while (low < high)
+		{
+			const size_t middle = (low + high) / 2;
+
+			if (riscv::instruction::get_mnemonic_name(static_cast<uint16_t>(middle)) < wanted)
+				low = middle + 1;
+			else
+				high = middle;
+		}
+
+		if (low < riscv::instruction::get_mnemonic_count() && riscv::instruction::get_mnemonic_name(static_cast<uint16_t>(low)) == wanted)
+			return static_cast<uint16_t>(low);
+
+		return RISCV_INVALID_MNEMONIC;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+//Plain C interface for embedding the disassembler from other languages. Everything goes through an opaque decoder
+//and caller owned arrays, work is done in batches so a foreign call covers thousands of instructions at a time.
+//Nothing in here throws or hands out memory the caller has to free with anything but riscv_decoder_destroy
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(RISCV_DISASM_STATIC)
+#define RISCV_API
+#elif defined(_WIN32)
+#ifdef RISCV_DISASM_EXPORTS
+#define RISCV_API __declspec(dllexport)
+#else
+#define RISCV_API __declspec(dllimport)
+#endif
+#else
+#define RISCV_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Bumped whenever a record layout or signature changes
+#define RISCV_API_VERSION 1
+
+#define RISCV_INVALID_MNEMONIC 0xffff
+
+typedef enum riscv_isa
+{
+	RISCV_ISA_RV32 = 0,
+	RISCV_ISA_RV64 = 1
+} riscv_isa;
+
+//Same order as the extension field of riscv_instruction, the decoder takes a set of them as bits
+typedef enum riscv_extension
+{
+	RISCV_EXT_I = 0,
+	RISCV_EXT_ZIFENCEI = 1,
+	RISCV_EXT_ZICSR = 2,
+	RISCV_EXT_M = 3,
+	RISCV_EXT_A = 4,
+	RISCV_EXT_F = 5,
+	RISCV_EXT_D = 6,
+	RISCV_EXT_Q = 7,
+	RISCV_EXT_C = 8
+} riscv_extension;
+
+#define RISCV_EXT_BIT(extension) (1u << (extension))
+#define RISCV_EXT_ALL 0x1ffu
+
+//Prefix every line with "0x<address>: " like the listing does
+#define RISCV_FORMAT_ADDRESS 0x1u
+
+//32 bytes. Register fields and immediate come from the expanded encoding, fields the format doesn't have are 0.
+//Instructions we don't know, or that belong to an extension the decoder wasn't asked for, get RISCV_INVALID_MNEMONIC.
+//Compressed ones need C and the extension of what they expand to
+typedef struct riscv_instruction
+{
+	uint64_t address;
+	uint32_t raw;
+	uint32_t expanded;
+	int32_t immediate;
+	uint16_t mnemonic;
+	uint8_t length;
+	uint8_t extension;
+	uint8_t rd;
+	uint8_t rs1;
+	uint8_t rs2;
+	uint8_t rs3;
+	uint32_t reserved;
+} riscv_instruction;
+
+typedef struct riscv_decoder riscv_decoder;
+
+RISCV_API uint32_t riscv_api_version(void);
+
+//Why the last call on this thread failed, empty if it succeeded. Every other call clears it first
+RISCV_API const char* riscv_last_error(void);
+
+//NULL on failure. extensions is a set of RISCV_EXT_BIT values. A decoder keeps caches, use one per thread
+RISCV_API riscv_decoder* riscv_decoder_create(riscv_isa isa, uint32_t extensions);
+RISCV_API void riscv_decoder_destroy(riscv_decoder* decoder);
+
+//Decodes up to capacity instructions from code, which sits at address. Stops early at the end of the buffer or in
+//front of an instruction cut off by it. Returns the number of records written, consumed gets the bytes they cover
+//so the next call can pick up from there
+RISCV_API size_t riscv_decode(riscv_decoder* decoder, const uint8_t* code, size_t size, uint64_t address, riscv_instruction* out, size_t capacity, size_t* consumed);
+
+//Formats instructions one line each ('\n' terminated, no NUL) into buffer. Stops in front of the first line that
+//doesn't fit. Returns the number of instructions formatted, written gets the bytes used. line_offsets is optional
+//and gets where each formatted line starts
+RISCV_API size_t riscv_format(riscv_decoder* decoder, const riscv_instruction* instructions, size_t count, uint32_t flags, char* buffer, size_t size, size_t* written, size_t* line_offsets);
+
+//Mnemonic ids are dense and in name order, names are upper case and stay valid for the life of the library
+RISCV_API size_t riscv_mnemonic_count(void);
+RISCV_API const char* riscv_mnemonic_name(uint16_t mnemonic);
+RISCV_API uint16_t riscv_mnemonic_find(const char* name);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,342 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "search.hpp"
+#include "boundaries.hpp"
+#include "registers.hpp"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RISCV_SEARCH_SSE2
+#endif
+
+namespace riscv
+{
+	namespace analysis
+	{
+		namespace
+		{
+			//Chunks are searched in parallel, see scan_chunks for how they find their first instruction
+			constexpr size_t chunk_size = 1 << 20;
+
+			int64_t parse_value(const std::string& text)
+			{
+				for (size_t reg = 0; reg < registers::x_reg_name_table.size(); reg++)
+				{
+					if (text == registers::x_reg_name_table[reg].second || text == "x" + std::to_string(reg))
+						return static_cast<int64_t>(reg);
+				}
+
+				for (size_t reg = 0; reg < registers::f_reg_name_table.size(); reg++)
+				{
+					if (text == registers::f_reg_name_table[reg].second || text == "f" + std::to_string(reg))
+						return static_cast<int64_t>(reg);
+				}
+
+				size_t used = 0;
+				int64_t value = 0;
+
+				try {
+					value = std::stoll(text, &used, 0);
+				} catch (const std::exception&) {
+					used = 0;
+				}
+
+				if (!used || used != text.size())
+					throw std::invalid_argument("not a register or number: " + text);
+
+				return value;
+			}
+
+			//FENCE with particular fm/pred/succ values, the table only knows them as FENCE. Matched on those fields
+			//(and funct3/opcode) the same way a mask/match pattern would be
+			struct fence_variant
+			{
+				const char* mnemonic;
+				uint32_t mask;
+				uint32_t match;
+			};
+
+			constexpr fence_variant fence_variants[] = {
+				{ "FENCE.TSO", 0xfff0707f, 0x8330000f },
+				{ "PAUSE", 0xfff0707f, 0x0100000f }
+			};
+
+			uint32_t read_word(const uint8_t* data, const size_t size, const size_t offset)
+			{
+				uint32_t word = 0;
+				std::memcpy(&word, data + offset, std::min<size_t>(4, size - offset));
+				return word;
+			}
+		}
+
+		instruction_pattern::instruction_pattern(const std::string& text, const isa arch) : m_architecture{ arch }
+		{
+			std::istringstream parts{ text };
+			std::string encoding;
+
+			if (!(parts >> encoding))
+				throw std::invalid_argument("empty pattern");
+
+			if (const size_t slash = encoding.find('/'); slash != std::string::npos) {
+				const uint32_t mask = static_cast<uint32_t>(parse_value(encoding.substr(0, slash)));
+				const uint32_t match = static_cast<uint32_t>(parse_value(encoding.substr(slash + 1)));
+
+				m_encodings.emplace_back(mask, match & mask);
+			} else {
+				std::transform(encoding.begin(), encoding.end(), encoding.begin(), [](const char c) { return static_cast<char>(std::toupper(static_cast<unsigned char>(c))); });
+
+				auto variant = std::find_if(std::begin(fence_variants), std::end(fence_variants), [&encoding](const fence_variant& v) { return encoding == v.mnemonic; });
+
+				//Decodes as FENCE, so there's no mnemonic to check afterwards
+				if (variant != std::end(fence_variants))
+					m_encodings.emplace_back(variant->mask, variant->match);
+
+				for (auto& [key, entries] : instruction::instruction_table)
+				{
+					for (auto& entry : entries)
+					{
+						auto& [match, mask, mnemonic, flags] { entry };
+
+						if (mnemonic == encoding) {
+							m_encodings.emplace_back(mask, match);
+							continue;
+						}
+
+						//Compressed forms of the instruction count too (C.JR and C.JALR for JALR), the match value with
+						//and without the free bits set is enough to see what an entry expands to
+						if ((match & 0x3) == 0x3)
+							continue;
+
+						for (const uint32_t sample : { match, match | (~mask & 0xfffc) })
+						{
+							const instruction::instruction_entry* expanded = instruction::find_instruction(instruction::expand_compressed(static_cast<uint16_t>(sample), arch), arch);
+
+							if (expanded && std::get<2>(*expanded) == encoding) {
+								m_encodings.emplace_back(mask, match);
+								break;
+							}
+						}
+					}
+				}
+
+				if (m_encodings.empty())
+					throw std::invalid_argument("unknown mnemonic " + encoding);
+
+				if (variant == std::end(fence_variants))
+					m_mnemonic = encoding;
+
+				std::sort(m_encodings.begin(), m_encodings.end());
+				m_encodings.erase(std::unique(m_encodings.begin(), m_encodings.end()), m_encodings.end());
+			}
+
+			std::string constraint;
+
+			while (parts >> constraint)
+			{
+				const size_t equals = constraint.find('=');
+
+				if (equals == std::string::npos || equals == 0)
+					throw std::invalid_argument("expected field=value or field!=value: " + constraint);
+
+				const bool equal = constraint[equals - 1] != '!';
+				const std::string name = constraint.substr(0, equal ? equals : equals - 1);
+
+				static const std::pair<const char*, operand_constraint::field> fields[] = {
+					{ "rd", operand_constraint::field::rd },
+					{ "rs1", operand_constraint::field::rs1 },
+					{ "rs2", operand_constraint::field::rs2 },
+					{ "rs3", operand_constraint::field::rs3 },
+					{ "csr", operand_constraint::field::csr },
+					{ "imm", operand_constraint::field::imm }
+				};
+
+				auto found = std::find_if(std::begin(fields), std::end(fields), [&name](const auto& field) { return name == field.first; });
+
+				if (found == std::end(fields))
+					throw std::invalid_argument("unknown operand " + name);
+
+				m_constraints.push_back({ found->second, equal, parse_value(constraint.substr(equals + 1)) });
+			}
+		}
+
+		bool instruction_pattern::matches(const instruction::object& instruction) const
+		{
+			const uint32_t expanded = instruction.get_expanded();
+
+			if (!expanded && instruction.get_type() == instruction::type_identifier::CEXT)
+				return false;
+
+			//The table masks aren't always the whole story, a more specific entry can claim the encoding.
+			//Compared by name, RV32 and RV64 encodings of an instruction are separate entries
+			if (!m_mnemonic.empty()) {
+				const instruction::instruction_entry* entry = instruction::find_instruction(instruction.get_raw(), m_architecture);
+				const instruction::instruction_entry* expanded_entry = instruction::find_instruction(expanded, m_architecture);
+
+				if ((!entry || std::get<2>(*entry) != m_mnemonic) && (!expanded_entry || std::get<2>(*expanded_entry) != m_mnemonic))
+					return false;
+			}
+
+			for (auto& constraint : m_constraints)
+			{
+				int64_t value = 0;
+
+				switch (constraint.which)
+				{
+				case operand_constraint::field::rd:
+					value = (expanded >> 7) & 0x1f;
+					break;
+				case operand_constraint::field::rs1:
+					value = (expanded >> 15) & 0x1f;
+					break;
+				case operand_constraint::field::rs2:
+					value = (expanded >> 20) & 0x1f;
+					break;
+				case operand_constraint::field::rs3:
+					value = expanded >> 27;
+					break;
+				case operand_constraint::field::csr:
+					value = expanded >> 20;
+					break;
+				case operand_constraint::field::imm:
+					value = instruction.get_immediate();
+					break;
+				}
+
+				if ((value == constraint.value) != constraint.equal)
+					return false;
+			}
+
+			return true;
+		}
+
+		const std::vector<std::pair<uint32_t, uint32_t>>& instruction_pattern::get_encodings() const
+		{
+			return m_encodings;
+		}
+
+		void prefilter(const uint8_t* data, const size_t size, const uint32_t mask, const uint32_t match, std::vector<size_t>& offsets)
+		{
+			size_t offset = 0;
+
+#ifdef RISCV_SEARCH_SSE2
+			//Words at offsets 0, 4, 8, 12 and at 2, 6, 10, 14 from two unaligned loads, 16 bytes per iteration
+			const __m128i masks = _mm_set1_epi32(static_cast<int>(mask));
+			const __m128i matches = _mm_set1_epi32(static_cast<int>(match));
+
+			for (; offset + 18 <= size; offset += 16)
+			{
+				const __m128i even = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset));
+				const __m128i odd = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset + 2));
+
+				const int even_hits = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(even, masks), matches)));
+				const int odd_hits = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(odd, masks), matches)));
+
+				if (!(even_hits | odd_hits))
+					continue;
+
+				for (int word = 0; word < 4; word++)
+				{
+					if (even_hits & (1 << word))
+						offsets.push_back(offset + word * 4);
+
+					if (odd_hits & (1 << word))
+						offsets.push_back(offset + word * 4 + 2);
+				}
+			}
+#endif
+
+			for (; offset + 2 <= size; offset += 2)
+			{
+				if ((read_word(data, size, offset) & mask) == match)
+					offsets.push_back(offset);
+			}
+		}
+
+		std::vector<uint64_t> search(const image& img, const instruction_pattern& pattern, thread_pool& pool)
+		{
+			std::vector<uint64_t> hits;
+
+			for (auto& seg : img.get_segments())
+			{
+				if (!seg.executable || !seg.data)
+					continue;
+
+				const uint8_t* data = seg.data;
+				const size_t size = seg.size;
+
+				std::vector<std::vector<uint64_t>> chunk_hits((size + chunk_size - 1) / chunk_size);
+
+				scan_chunks(data, size, chunk_size, pool, [&](const size_t index, const uint64_t start, const uint64_t end)
+				{
+					const size_t begin = index * chunk_size;
+					std::vector<size_t> candidates;
+
+					for (auto& [mask, match] : pattern.get_encodings())
+					{
+						const size_t before = candidates.size();
+
+						prefilter(data + begin, std::min<size_t>(size, end + 2) - begin, mask, match, candidates);
+
+						for (size_t i = before; i < candidates.size(); i++)
+							candidates[i] += begin;
+
+						//The last halfword belongs to the next chunk
+						while (candidates.size() > before && candidates.back() >= end)
+							candidates.pop_back();
+					}
+
+					std::sort(candidates.begin(), candidates.end());
+					candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+					auto& found = chunk_hits[index];
+					found.clear();
+
+					//Only the low two bits of every instruction get looked at while walking to the candidates
+					uint64_t boundary = start;
+
+					for (const size_t candidate : candidates)
+					{
+						boundary = walk_lengths(data, boundary, candidate);
+
+						if (boundary != candidate)
+							continue;
+
+						uint32_t raw = read_word(data, size, candidate);
+
+						if ((raw & 0x3) != 0x3)
+							raw &= 0xffff;
+
+						const instruction::object instruction{ raw, img.get_architecture() };
+
+						if (candidate + instruction.get_length() <= size && pattern.matches(instruction))
+							found.push_back(seg.address + candidate);
+					}
+
+					return walk_lengths(data, boundary, end);
+				});
+
+				for (auto& found : chunk_hits)
+					hits.insert(hits.end(), found.begin(), found.end());
+			}
+
+			return hits;
+		}
+	}
+}
\ No newline at end of file
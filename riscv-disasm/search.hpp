@@ -0,0 +1,70 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "image.hpp"
+#include "thread_pool.hpp"
+
+namespace riscv
+{
+	namespace analysis
+	{
+		struct operand_constraint
+		{
+			enum class field : uint8_t
+			{
+				rd, rs1, rs2, rs3, csr, imm
+			};
+
+			field which;
+			bool equal;
+			int64_t value;
+		};
+
+		//A mnemonic or a mask/match pair, then any number of operand constraints, all separated by spaces:
+		//	"CSRRW csr=0x300", "0xffffffff/0x8330000f", "JALR rs1!=ra"
+		//Operands are the fields of the expanded instruction, so constraints work the same on compressed ones, and a
+		//mnemonic also finds the compressed instructions that expand to it. FENCE.TSO and PAUSE are accepted too and
+		//match on the fm/pred/succ fields of FENCE
+		class instruction_pattern
+		{
+			std::vector<std::pair<uint32_t, uint32_t>> m_encodings;
+			//Empty for mask/match patterns
+			std::string m_mnemonic;
+			std::vector<operand_constraint> m_constraints;
+			isa m_architecture;
+
+		public:
+			instruction_pattern() = delete;
+
+			//Throws std::invalid_argument on an unknown mnemonic, register or field
+			instruction_pattern(const std::string& text, const isa arch);
+
+			bool matches(const instruction::object& instruction) const;
+
+			//mask, match
+			const std::vector<std::pair<uint32_t, uint32_t>>& get_encodings() const;
+		};
+
+		//Offsets (halfword aligned) of every 32 bit little endian word in data with (word & mask) == match.
+		//Words past the end read as zero so 16 bit patterns still match in the last halfword
+		void prefilter(const uint8_t* data, const size_t size, const uint32_t mask, const uint32_t match, std::vector<size_t>& offsets);
+
+		//Addresses of matching instructions in every code segment, in order. The raw words get compared against the
+		//pattern's encodings first and only the candidates are decoded, after checking they sit on an instruction boundary
+		std::vector<uint64_t> search(const image& img, const instruction_pattern& pattern, thread_pool& pool);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,554 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "server.hpp"
+#include "search.hpp"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace riscv
+{
+	namespace
+	{
+		std::vector<std::string> split_request(const std::string& request)
+		{
+			std::vector<std::string> words;
+			size_t start = 0;
+
+			while (start <= request.size())
+			{
+				size_t end = request.find('\n', start);
+
+				if (end == std::string::npos)
+					end = request.size();
+
+				words.push_back(request.substr(start, end - start));
+				start = end + 1;
+			}
+
+			return words;
+		}
+
+		uint64_t parse_address(const std::string& text)
+		{
+			size_t used = 0;
+			const uint64_t value = std::stoull(text, &used, 16);
+
+			if (used != text.size())
+				throw std::invalid_argument("bad address " + text);
+
+			return value;
+		}
+
+#ifndef _WIN32
+		bool read_exact(const int fd, void* buffer, size_t size)
+		{
+			auto bytes = static_cast<uint8_t*>(buffer);
+
+			while (size)
+			{
+				const ssize_t count = ::read(fd, bytes, size);
+
+				if (count < 0 && errno == EINTR)
+					continue;
+
+				if (count <= 0)
+					return false;
+
+				bytes += count;
+				size -= static_cast<size_t>(count);
+			}
+
+			return true;
+		}
+
+		bool write_exact(const int fd, const void* buffer, size_t size)
+		{
+			auto bytes = static_cast<const uint8_t*>(buffer);
+
+#ifdef MSG_NOSIGNAL
+			constexpr int flags = MSG_NOSIGNAL;
+#else
+			constexpr int flags = 0;
+#endif
+
+			while (size)
+			{
+				const ssize_t count = ::send(fd, bytes, size, flags);
+
+				if (count < 0 && errno == EINTR)
+					continue;
+
+				if (count <= 0)
+					return false;
+
+				bytes += count;
+				size -= static_cast<size_t>(count);
+			}
+
+			return true;
+		}
+
+		bool read_message(const int fd, std::string& message)
+		{
+			uint8_t header[4];
+
+			if (!read_exact(fd, header, sizeof(header)))
+				return false;
+
+			const uint32_t length = header[0] | (header[1] << 8) | (header[2] << 16) | (static_cast<uint32_t>(header[3]) << 24);
+
+			if (length > server::max_message)
+				return false;
+
+			message.resize(length);
+			return read_exact(fd, message.data(), message.size());
+		}
+
+		bool write_message(const int fd, const std::string& message)
+		{
+			const uint32_t length = static_cast<uint32_t>(message.size());
+			const uint8_t header[4] = { static_cast<uint8_t>(length), static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length >> 16), static_cast<uint8_t>(length >> 24) };
+
+			return write_exact(fd, header, sizeof(header)) && write_exact(fd, message.data(), message.size());
+		}
+
+		void set_cloexec(const int fd)
+		{
+			::fcntl(fd, F_SETFD, ::fcntl(fd, F_GETFD) | FD_CLOEXEC);
+		}
+
+		sockaddr_un make_address(const std::string& path)
+		{
+			sockaddr_un address{};
+
+			if (path.size() >= sizeof(address.sun_path))
+				throw std::runtime_error("socket path too long: " + path);
+
+			address.sun_family = AF_UNIX;
+			std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+			return address;
+		}
+#endif
+	}
+
+	image_cache::image_cache(const size_t limit, const load_options& options) : m_limit{ limit ? limit : 1 }, m_options{ options }
+	{}
+
+	std::shared_ptr<loaded_image> image_cache::get(const std::string& path)
+	{
+		std::error_code error;
+		const auto modified = std::filesystem::last_write_time(path, error);
+		const uintmax_t size = error ? 0 : std::filesystem::file_size(path, error);
+
+		if (error)
+			throw std::runtime_error("can't open " + path);
+
+		{
+			std::scoped_lock lock{ m_lock };
+
+			for (auto entry = m_recent.begin(); entry != m_recent.end(); ++entry)
+			{
+				if (entry->first != path)
+					continue;
+
+				if (entry->second->modified == modified && entry->second->size == size) {
+					m_recent.splice(m_recent.begin(), m_recent, entry);
+					return entry->second;
+				}
+
+				//Changed on disk, requests still holding the old one keep it alive until they're done
+				m_recent.erase(entry);
+				break;
+			}
+		}
+
+		//Loaded outside the lock so a big file doesn't hold up requests for others. Two requests missing at the
+		//same time both load it, the second one just replaces the first
+		auto loaded = std::make_shared<loaded_image>();
+		loaded->modified = modified;
+		loaded->size = size;
+
+		loaded->img = std::make_unique<image>(load_image(path, m_options));
+
+		std::scoped_lock lock{ m_lock };
+
+		m_recent.remove_if([&path](auto& entry) { return entry.first == path; });
+		m_recent.emplace_front(path, loaded);
+
+		while (m_recent.size() > m_limit)
+			m_recent.pop_back();
+
+		return loaded;
+	}
+
+	size_t image_cache::size()
+	{
+		std::scoped_lock lock{ m_lock };
+		return m_recent.size();
+	}
+
+	std::string server::range(loaded_image& loaded, const uint64_t begin, const uint64_t end)
+	{
+		if (end <= begin || end - begin > max_range)
+			throw std::invalid_argument("bad range");
+
+		const image& img = *loaded.img;
+		const segment* seg = img.find_segment(begin);
+
+		if (!seg)
+			throw std::runtime_error("nothing mapped at that address");
+
+		const uint64_t last = std::min(end, seg->address + seg->size);
+		const size_t index = seg - img.get_segments().data();
+
+		disassembler formatter{ img.get_architecture() };
+		std::ostringstream out;
+
+		std::scoped_lock lock{ loaded.view_lock };
+
+		if (loaded.views.size() <= index)
+			loaded.views.resize(img.get_segments().size());
+
+		if (!loaded.views[index])
+			loaded.views[index] = std::make_unique<code_view>(img, *seg);
+
+		code_view& view = *loaded.views[index];
+		std::optional<uint64_t> address = view.instruction_start(begin);
+
+		while (address && *address < last)
+		{
+			const auto lines = view.window(*address, 0, 512);
+
+			if (lines.empty())
+				break;
+
+			for (auto& line : lines)
+			{
+				if (line.address >= last)
+					break;
+
+				out << "0x" << std::hex << line.address << ": ";
+				formatter.format(out, line.instruction, line.address);
+				out << "\n";
+			}
+
+			address = view.next(lines.back().address);
+		}
+
+		return out.str();
+	}
+
+	std::string server::function(loaded_image& loaded, const std::string& which)
+	{
+		std::call_once(loaded.functions_found, [&loaded] { loaded.functions = analysis::find_functions(*loaded.img); });
+
+		const bool by_address = which.rfind("0x", 0) == 0;
+		const uint64_t address = by_address ? parse_address(which.substr(2)) : 0;
+
+		auto found = std::find_if(loaded.functions.begin(), loaded.functions.end(), [&](const analysis::function& function)
+		{
+			return by_address ? address >= function.begin && address < function.end : function.name == which;
+		});
+
+		if (found == loaded.functions.end())
+			throw std::runtime_error("no function " + which);
+
+		std::vector<uint8_t> code(found->end - found->begin);
+		loaded.img->read(found->begin, code.data(), code.size());
+
+		disassembler disasm{ code, loaded.img->get_architecture(), found->begin };
+		std::ostringstream out;
+
+		out << found->name << ":\n";
+		disasm.parse_instructions(out);
+
+		return out.str();
+	}
+
+	std::string server::search(loaded_image& loaded, const std::string& pattern)
+	{
+		const image& img = *loaded.img;
+		const analysis::instruction_pattern compiled{ pattern, img.get_architecture() };
+
+		disassembler formatter{ img.get_architecture() };
+		std::ostringstream out;
+
+		for (const uint64_t address : analysis::search(img, compiled, m_pool))
+		{
+			uint32_t raw = *img.read_value<uint16_t>(address);
+
+			if ((raw & 0x3) == 0x3)
+				raw |= static_cast<uint32_t>(*img.read_value<uint16_t>(address + 2)) << 16;
+
+			out << "0x" << std::hex << address << ": ";
+			formatter.format(out, instruction::object{ raw, img.get_architecture() }, address);
+			out << "\n";
+		}
+
+		return out.str();
+	}
+
+	std::string server::handle(const std::string& request)
+	{
+		const std::vector<std::string> words = split_request(request);
+		const std::string& command = words[0];
+
+		if (command == "ping" && words.size() == 1)
+			return "pong\n";
+
+		if (command == "shutdown" && words.size() == 1) {
+			stop();
+			return "stopping\n";
+		}
+
+		if (command == "range" && words.size() == 4)
+			return range(*m_images.get(words[1]), parse_address(words[2]), parse_address(words[3]));
+
+		if (command == "function" && words.size() == 3)
+			return function(*m_images.get(words[1]), words[2]);
+
+		if (command == "search" && words.size() == 3)
+			return search(*m_images.get(words[1]), words[2]);
+
+		throw std::invalid_argument("bad request: " + command);
+	}
+
+#ifndef _WIN32
+	server::server(const std::string& path, thread_pool& pool, const size_t cached_images, const load_options& options) : m_path{ path }, m_pool{ pool }, m_images{ cached_images, options }
+	{
+		const sockaddr_un address = make_address(path);
+
+		m_listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if (m_listener < 0)
+			throw std::runtime_error("can't create socket");
+
+		set_cloexec(m_listener);
+		::unlink(path.c_str());
+
+		if (::bind(m_listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || ::listen(m_listener, SOMAXCONN) < 0 || ::pipe(m_wake) < 0) {
+			::close(m_listener);
+			throw std::runtime_error("can't listen on " + path + ": " + std::strerror(errno));
+		}
+
+		//Wakeups are only ever a hint, a full pipe already means the loop is going to wake up
+		for (const int fd : m_wake)
+		{
+			set_cloexec(fd);
+			::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+		}
+	}
+
+	server::~server()
+	{
+		::close(m_listener);
+		::close(m_wake[0]);
+		::close(m_wake[1]);
+		::unlink(m_path.c_str());
+	}
+
+	void server::wake()
+	{
+		const char signal = 0;
+		[[maybe_unused]] const ssize_t ignored = ::write(m_wake[1], &signal, 1);
+	}
+
+	void server::stop()
+	{
+		m_stopping = true;
+		wake();
+	}
+
+	void server::serve_connection(const int client)
+	{
+		bool keep = false;
+
+		try {
+			std::string request;
+
+			if (read_message(client, request)) {
+				std::string answer{ '\0' };
+
+				try {
+					answer += handle(request);
+				} catch (const std::exception& error) {
+					answer = std::string{ '\1' } + error.what();
+				}
+
+				keep = write_message(client, answer);
+			}
+		} catch (const std::exception&) {
+			keep = false;
+		}
+
+		if (keep && !m_stopping) {
+			std::scoped_lock lock{ m_returned_lock };
+			m_returned.push_back(client);
+		} else {
+			::close(client);
+		}
+
+		wake();
+
+		{
+			std::scoped_lock lock{ m_busy_lock };
+			m_busy--;
+		}
+
+		m_idle.notify_all();
+	}
+
+	void server::run()
+	{
+		std::vector<int> idle;
+		std::vector<pollfd> watched;
+
+		while (!m_stopping)
+		{
+			{
+				std::scoped_lock lock{ m_returned_lock };
+				idle.insert(idle.end(), m_returned.begin(), m_returned.end());
+				m_returned.clear();
+			}
+
+			watched.clear();
+			watched.push_back(pollfd{ m_listener, POLLIN, 0 });
+			watched.push_back(pollfd{ m_wake[0], POLLIN, 0 });
+
+			for (const int client : idle)
+				watched.push_back(pollfd{ client, POLLIN, 0 });
+
+			if (::poll(watched.data(), watched.size(), -1) < 0) {
+				if (errno == EINTR)
+					continue;
+
+				throw std::runtime_error("poll failed");
+			}
+
+			if (watched[1].revents) {
+				char drain[64];
+				while (::read(m_wake[0], drain, sizeof(drain)) > 0);
+			}
+
+			idle.clear();
+
+			//Anything with a request waiting (or that hung up) goes to the pool, the rest keeps waiting
+			for (size_t i = 2; i < watched.size(); i++)
+			{
+				if (!watched[i].revents) {
+					idle.push_back(watched[i].fd);
+					continue;
+				}
+
+				{
+					std::scoped_lock lock{ m_busy_lock };
+					m_busy++;
+				}
+
+				m_pool.submit([this, client = watched[i].fd] { serve_connection(client); });
+			}
+
+			if (watched[0].revents & POLLIN) {
+				const int client = ::accept(m_listener, nullptr, nullptr);
+
+				if (client >= 0) {
+					set_cloexec(client);
+
+					//A client that stops halfway through a request shouldn't hold on to a worker forever
+					timeval timeout{ 10, 0 };
+					::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+					idle.push_back(client);
+				}
+			}
+		}
+
+		{
+			std::unique_lock lock{ m_busy_lock };
+			m_idle.wait(lock, [this] { return m_busy == 0; });
+		}
+
+		for (const int client : idle)
+			::close(client);
+
+		for (const int client : m_returned)
+			::close(client);
+
+		m_returned.clear();
+	}
+
+	std::string send_request(const std::string& path, const std::string& request)
+	{
+		const sockaddr_un address = make_address(path);
+		const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if (fd < 0)
+			throw std::runtime_error("can't create socket");
+
+		std::string answer;
+		const bool sent = ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0 && write_message(fd, request) && read_message(fd, answer);
+
+		::close(fd);
+
+		if (!sent || answer.empty())
+			throw std::runtime_error("no answer from " + path);
+
+		if (answer[0] != '\0')
+			throw std::runtime_error(answer.substr(1));
+
+		return answer.substr(1);
+	}
+#else
+	server::server(const std::string& path, thread_pool& pool, const size_t cached_images, const load_options& options) : m_path{ path }, m_pool{ pool }, m_images{ cached_images, options }
+	{
+		throw std::runtime_error("serving needs unix domain sockets, not supported on this platform yet");
+	}
+
+	server::~server()
+	{}
+
+	void server::wake()
+	{}
+
+	void server::stop()
+	{
+		m_stopping = true;
+	}
+
+	void server::serve_connection(const int client)
+	{}
+
+	void server::run()
+	{}
+
+	std::string send_request(const std::string& path, const std::string& request)
+	{
+		throw std::runtime_error("requests need unix domain sockets, not supported on this platform yet");
+	}
+#endif
+}
\ No newline at end of file
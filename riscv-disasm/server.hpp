@@ -0,0 +1,125 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "firmware.hpp"
+#include "functions.hpp"
+#include "thread_pool.hpp"
+#include "view.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <list>
+#include <mutex>
+
+namespace riscv
+{
+	//Everything a request against one file needs, kept between requests. Functions are only found the first time
+	//something asks for them, code views are made per segment when first used
+	struct loaded_image
+	{
+		std::filesystem::file_time_type modified;
+		uintmax_t size;
+		std::unique_ptr<image> img;
+
+		std::once_flag functions_found;
+		std::vector<analysis::function> functions;
+
+		//code_view isn't thread safe, one lock for all views of the image
+		std::mutex view_lock;
+		std::vector<std::unique_ptr<code_view>> views;
+	};
+
+	//Loaded images by path, least recently used ones dropped past the limit. Files that changed on disk are loaded again
+	class image_cache
+	{
+		std::mutex m_lock;
+		std::list<std::pair<std::string, std::shared_ptr<loaded_image>>> m_recent;
+		size_t m_limit;
+		load_options m_options;
+
+	public:
+		image_cache() = delete;
+		image_cache(const image_cache& cache) = delete;
+		image_cache(image_cache&& cache) = delete;
+
+		//options are for the files that don't say where they go or what they are, same as load_image
+		image_cache(const size_t limit, const load_options& options = {});
+
+		//Throws std::runtime_error when the file can't be read or parsed
+		std::shared_ptr<loaded_image> get(const std::string& path);
+
+		size_t size();
+	};
+
+	//Answers disassembly requests over a unix domain socket. Every message either way is a 4 byte little endian
+	//length followed by that many bytes. A request is the command and its arguments separated by newlines, the
+	//answer starts with a status byte (0 ok, 1 error) followed by text:
+	//  ping
+	//  range <file> <hex begin> <hex end>
+	//  function <file> <name or hex address>
+	//  search <file> <pattern>
+	//  shutdown
+	//Clients can send any number of requests over one connection. Idle connections wait in poll(), a connection
+	//with a request waiting is handed to the pool, so the number of clients isn't limited by the number of threads
+	class server
+	{
+		std::string m_path;
+		thread_pool& m_pool;
+		image_cache m_images;
+
+		int m_listener = -1;
+		int m_wake[2] = { -1, -1 };
+		std::atomic<bool> m_stopping = false;
+
+		//Connections a worker is done with, for the poll loop to pick up again
+		std::mutex m_returned_lock;
+		std::vector<int> m_returned;
+
+		std::mutex m_busy_lock;
+		std::condition_variable m_idle;
+		size_t m_busy = 0;
+
+		void wake();
+		void serve_connection(const int client);
+
+		std::string range(loaded_image& loaded, const uint64_t begin, const uint64_t end);
+		std::string function(loaded_image& loaded, const std::string& which);
+		std::string search(loaded_image& loaded, const std::string& pattern);
+
+	public:
+		static constexpr size_t max_message = 64 * 1024 * 1024;
+		static constexpr uint64_t max_range = 16 * 1024 * 1024;
+
+		server() = delete;
+		server(const server& srv) = delete;
+		server(server&& srv) = delete;
+
+		//Replaces whatever is at path, throws std::runtime_error if the socket can't be set up
+		server(const std::string& path, thread_pool& pool, const size_t cached_images = 16, const load_options& options = {});
+		~server();
+
+		//Serves until stop() or a shutdown request, then waits for requests in progress to finish
+		void run();
+		void stop();
+
+		//One request, what run() does for each message. Throws on bad requests, the text goes back as the error
+		std::string handle(const std::string& request);
+	};
+
+	//Sends one request and returns the answer text, throws std::runtime_error for errors on either side
+	std::string send_request(const std::string& path, const std::string& request);
+}
\ No newline at end of file
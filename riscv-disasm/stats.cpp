@@ -0,0 +1,203 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "stats.hpp"
+#include "functions.hpp"
+#include "instruction_range.hpp"
+#include <algorithm>
+#include <iomanip>
+
+namespace riscv
+{
+	namespace analysis
+	{
+		namespace
+		{
+			constexpr const char* extension_names[] = { "I", "Zifencei", "Zicsr", "M", "A", "F", "D", "Q", "C" };
+			constexpr const char* type_names[] = { "R", "R4", "I", "S", "B", "U", "J", "C", "unknown" };
+
+			void write_string(std::ostream& out, const std::string& text)
+			{
+				out << '"';
+
+				for (const char c : text)
+				{
+					if (c == '"' || c == '\\')
+						out << '\\' << c;
+					else if (static_cast<unsigned char>(c) < 0x20)
+						out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::setfill(' ') << std::dec;
+					else
+						out << c;
+				}
+
+				out << '"';
+			}
+
+			void write_address(std::ostream& out, const uint64_t address)
+			{
+				out << "\"0x" << std::hex << address << std::dec << '"';
+			}
+		}
+
+		void instruction_mix::add(const instruction::object& instruction, const isa arch)
+		{
+			const instruction::type_identifier type = instruction.get_type();
+
+			m_total++;
+			m_types[static_cast<size_t>(type)]++;
+
+			if (type == instruction::type_identifier::CEXT)
+				m_compressed++;
+
+			//Reserved compressed encodings (all zeroes included) match a table entry but aren't that instruction
+			const instruction::instruction_entry* entry = instruction.get_expanded() ? instruction::find_instruction(instruction.get_raw(), arch) : nullptr;
+
+			m_mnemonics[entry]++;
+
+			if (entry)
+				m_extensions[static_cast<size_t>(instruction.get_extension())]++;
+		}
+
+		void instruction_mix::add_range(const image& img, const uint64_t address, const uint64_t size)
+		{
+			for (auto& decoded : instruction_range{ img, address, address + size })
+				add(decoded.instruction, img.get_architecture());
+		}
+
+		void instruction_mix::merge(const instruction_mix& other)
+		{
+			m_total += other.m_total;
+			m_compressed += other.m_compressed;
+
+			for (size_t i = 0; i < m_extensions.size(); i++)
+				m_extensions[i] += other.m_extensions[i];
+
+			for (size_t i = 0; i < m_types.size(); i++)
+				m_types[i] += other.m_types[i];
+
+			for (auto& [entry, count] : other.m_mnemonics)
+				m_mnemonics[entry] += count;
+		}
+
+		void instruction_mix::write_json(std::ostream& out) const
+		{
+			out << std::dec << "{\"instructions\":" << m_total << ",\"compressed\":" << m_compressed
+				<< ",\"compressed_ratio\":" << std::fixed << std::setprecision(4) << (m_total ? static_cast<double>(m_compressed) / m_total : 0.0);
+
+			out << ",\"extensions\":{";
+			bool first = true;
+
+			for (size_t i = 0; i < m_extensions.size(); i++)
+			{
+				if (!m_extensions[i])
+					continue;
+
+				out << (first ? "" : ",") << '"' << extension_names[i] << "\":" << m_extensions[i];
+				first = false;
+			}
+
+			out << "},\"formats\":{";
+			first = true;
+
+			for (size_t i = 0; i < m_types.size(); i++)
+			{
+				if (!m_types[i])
+					continue;
+
+				out << (first ? "" : ",") << '"' << type_names[i] << "\":" << m_types[i];
+				first = false;
+			}
+
+			//Sorted so reports diff cleanly between releases
+			std::vector<std::pair<std::string, uint64_t>> mnemonics;
+
+			for (auto& [entry, count] : m_mnemonics)
+				mnemonics.emplace_back(entry ? std::get<2>(*entry) : "unknown", count);
+
+			std::sort(mnemonics.begin(), mnemonics.end());
+
+			out << "},\"mnemonics\":{";
+			first = true;
+
+			for (auto& [name, count] : mnemonics)
+			{
+				out << (first ? "" : ",");
+				write_string(out, name);
+				out << ":" << count;
+				first = false;
+			}
+
+			out << "}}";
+		}
+
+		void write_mix_report(std::ostream& out, const image& img, thread_pool& pool)
+		{
+			std::vector<const segment*> sections;
+
+			for (auto& seg : img.get_segments())
+			{
+				if (seg.executable)
+					sections.push_back(&seg);
+			}
+
+			const std::vector<function> functions = find_functions(img);
+
+			std::vector<instruction_mix> section_mix(sections.size());
+			std::vector<instruction_mix> function_mix(functions.size());
+
+			pool.parallel_for(sections.size() + functions.size(), [&](const size_t index)
+			{
+				if (index < sections.size())
+					section_mix[index].add_range(img, sections[index]->address, sections[index]->size);
+				else
+					function_mix[index - sections.size()].add_range(img, functions[index - sections.size()].begin, functions[index - sections.size()].end - functions[index - sections.size()].begin);
+			});
+
+			instruction_mix total;
+
+			out << "{\"architecture\":\"" << (img.get_architecture() == isa::RV32 ? "RV32" : "RV64") << "\",\"sections\":[";
+
+			for (size_t i = 0; i < sections.size(); i++)
+			{
+				out << (i ? "," : "") << "{\"name\":";
+				write_string(out, sections[i]->name);
+				out << ",\"address\":";
+				write_address(out, sections[i]->address);
+				out << ",\"mix\":";
+				section_mix[i].write_json(out);
+				out << "}";
+
+				total.merge(section_mix[i]);
+			}
+
+			out << "],\"functions\":[";
+
+			for (size_t i = 0; i < functions.size(); i++)
+			{
+				out << (i ? "," : "") << "{\"name\":";
+				write_string(out, functions[i].name);
+				out << ",\"address\":";
+				write_address(out, functions[i].begin);
+				out << ",\"mix\":";
+				function_mix[i].write_json(out);
+				out << "}";
+			}
+
+			out << "],\"total\":";
+			total.write_json(out);
+			out << "}\n";
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "image.hpp"
+#include "thread_pool.hpp"
+#include <ostream>
+#include <unordered_map>
+
+namespace riscv
+{
+	namespace analysis
+	{
+		//Counts straight off the decoded objects, nothing gets formatted
+		class instruction_mix
+		{
+			uint64_t m_total = 0;
+			uint64_t m_compressed = 0;
+			std::array<uint64_t, 9> m_extensions{};
+			std::array<uint64_t, 9> m_types{};
+
+			//Keyed on the table entry, names are only looked up when writing the report
+			std::unordered_map<const instruction::instruction_entry*, uint64_t> m_mnemonics;
+
+		public:
+			void add(const instruction::object& instruction, const isa arch);
+
+			//Decodes [address, address + size) in a straight line
+			void add_range(const image& img, const uint64_t address, const uint64_t size);
+
+			void merge(const instruction_mix& other);
+
+			void write_json(std::ostream& out) const;
+		};
+
+		//Per code section and per function mix plus the total, as one JSON object
+		void write_mix_report(std::ostream& out, const image& img, thread_pool& pool);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,348 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "store.hpp"
+#include "disassembler.hpp"
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace riscv
+{
+	namespace
+	{
+		constexpr char store_magic[4] = { 'R', 'D', 'F', 'S' };
+		constexpr uint32_t store_version = 1;
+
+		//Far enough that no address can move by it by accident, small enough to keep every alignment and fit RV32
+		constexpr uint64_t probe_distance = 0x40000000;
+
+		uint64_t mix(uint64_t value)
+		{
+			value ^= value >> 33;
+			value *= 0xff51afd7ed558ccdull;
+			value ^= value >> 33;
+			value *= 0xc4ceb9fe1a85ec53ull;
+			value ^= value >> 33;
+			return value;
+		}
+
+		uint64_t process_id()
+		{
+#ifdef _WIN32
+			return static_cast<uint64_t>(_getpid());
+#else
+			return static_cast<uint64_t>(getpid());
+#endif
+		}
+
+		bool is_hex(const char c)
+		{
+			return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+		}
+
+		//Hex number after a 0x at position, moves position past it
+		uint64_t read_hex(const std::string& text, size_t& position)
+		{
+			uint64_t value = 0;
+
+			for (position += 2; position < text.size() && is_hex(text[position]); position++)
+				value = (value << 4) | static_cast<uint64_t>(text[position] <= '9' ? text[position] - '0' : text[position] - 'a' + 10);
+
+			return value;
+		}
+
+		bool at_hex(const std::string& text, const size_t position)
+		{
+			return position + 2 < text.size() && text[position] == '0' && text[position + 1] == 'x' && is_hex(text[position + 2]);
+		}
+
+		template <typename T>
+		void write_value(std::ostream& out, const T value)
+		{
+			out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+		}
+
+		template <typename T>
+		bool read_value(std::istream& in, T& value)
+		{
+			return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+		}
+	}
+
+	const std::string store_key::to_string() const
+	{
+		std::ostringstream text;
+		text << std::hex;
+		text.fill('0');
+		text.width(16);
+		text << high;
+		text.width(16);
+		text << low;
+		return text.str();
+	}
+
+	const store_key make_store_key(const uint8_t* code, const size_t size, const isa arch)
+	{
+		uint64_t fnv = 0xcbf29ce484222325ull;
+		uint64_t mixed = mix(size ^ (static_cast<uint64_t>(arch) << 56));
+
+		for (size_t i = 0; i < size; i++)
+		{
+			fnv ^= code[i];
+			fnv *= 0x100000001b3ull;
+		}
+
+		for (size_t i = 0; i < size; i += 8)
+		{
+			uint64_t word = 0;
+			for (size_t j = 0; j < 8 && i + j < size; j++)
+				word |= static_cast<uint64_t>(code[i + j]) << (j * 8);
+
+			mixed = mix(mixed ^ word) + 0x9e3779b97f4a7c15ull;
+		}
+
+		fnv ^= static_cast<uint64_t>(arch);
+		fnv *= 0x100000001b3ull;
+
+		return { fnv, mixed };
+	}
+
+	void function_template::render(std::ostream& out, const uint64_t base_address, const isa arch) const
+	{
+		for (size_t i = 0; i < pieces.size(); i++)
+		{
+			out << pieces[i];
+
+			if (i < offsets.size()) {
+				uint64_t address = base_address + offsets[i];
+
+				if (arch == isa::RV32)
+					address &= 0xffffffff;
+
+				out << "0x" << std::hex << address;
+			}
+		}
+	}
+
+	std::optional<function_template> make_function_template(const std::vector<uint8_t>& code, const isa arch, const uint64_t base_address)
+	{
+		const uint64_t width_mask = arch == isa::RV32 ? 0xffffffff : ~0ull;
+
+		disassembler disasm{ code, arch, base_address };
+
+		std::ostringstream at_base;
+		disasm.parse_instructions(at_base);
+
+		//Same code a fixed distance away, whatever moved by that distance is an address
+		disasm.rebase((base_address + probe_distance) & width_mask);
+
+		std::ostringstream at_probe;
+		disasm.parse_instructions(at_probe);
+
+		const std::string a = at_base.str();
+		const std::string b = at_probe.str();
+
+		function_template entry;
+		std::string piece;
+		size_t i = 0;
+		size_t j = 0;
+
+		while (i < a.size() && j < b.size())
+		{
+			if (at_hex(a, i) && at_hex(b, j)) {
+				const size_t start = i;
+				const uint64_t value = read_hex(a, i);
+				const uint64_t moved = read_hex(b, j);
+
+				if (value == moved) {
+					piece.append(a, start, i - start);
+				} else if (((moved - value) & width_mask) == probe_distance) {
+					entry.pieces.push_back(std::move(piece));
+					entry.offsets.push_back(value - base_address);
+					piece.clear();
+				} else {
+					return std::nullopt;
+				}
+
+				continue;
+			}
+
+			if (a[i] != b[j])
+				return std::nullopt;
+
+			piece.push_back(a[i]);
+			i++;
+			j++;
+		}
+
+		if (i != a.size() || j != b.size())
+			return std::nullopt;
+
+		entry.pieces.push_back(std::move(piece));
+		return entry;
+	}
+
+	function_store::function_store(std::filesystem::path directory) : m_directory{ std::move(directory) }
+	{
+		if (!m_directory.empty())
+			std::filesystem::create_directories(m_directory);
+	}
+
+	const std::filesystem::path function_store::entry_path(const store_key& key) const
+	{
+		const std::string name = key.to_string();
+
+		//Fan out a level so no single directory ends up with every function of the fleet
+		return m_directory / name.substr(0, 2) / name;
+	}
+
+	std::shared_ptr<const function_template> function_store::load(const store_key& key) const
+	{
+		std::ifstream in{ entry_path(key), std::ios::binary };
+		if (!in)
+			return nullptr;
+
+		char magic[4];
+		uint32_t version = 0;
+		uint32_t pieces = 0;
+
+		if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + 4, store_magic) || !read_value(in, version) || version != store_version || !read_value(in, pieces) || !pieces)
+			return nullptr;
+
+		auto entry = std::make_shared<function_template>();
+
+		for (uint32_t i = 0; i < pieces; i++)
+		{
+			uint32_t length = 0;
+			if (!read_value(in, length))
+				return nullptr;
+
+			std::string piece(length, '\0');
+			if (!in.read(piece.data(), length))
+				return nullptr;
+
+			entry->pieces.push_back(std::move(piece));
+
+			if (i + 1 < pieces) {
+				uint64_t offset = 0;
+				if (!read_value(in, offset))
+					return nullptr;
+
+				entry->offsets.push_back(offset);
+			}
+		}
+
+		return entry;
+	}
+
+	void function_store::save(const store_key& key, const function_template& entry) const
+	{
+		const std::filesystem::path path = entry_path(key);
+		std::filesystem::create_directories(path.parent_path());
+
+		//Written aside and renamed so a concurrent reader never sees half an entry, named by process and thread so
+		//other writers to the same store never share the file
+		std::filesystem::path partial = path;
+		partial += "." + std::to_string(process_id()) + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+
+		{
+			std::ofstream out{ partial, std::ios::binary | std::ios::trunc };
+			if (!out)
+				return;
+
+			out.write(store_magic, sizeof(store_magic));
+			write_value(out, store_version);
+			write_value(out, static_cast<uint32_t>(entry.pieces.size()));
+
+			for (size_t i = 0; i < entry.pieces.size(); i++)
+			{
+				write_value(out, static_cast<uint32_t>(entry.pieces[i].size()));
+				out.write(entry.pieces[i].data(), entry.pieces[i].size());
+
+				if (i < entry.offsets.size())
+					write_value(out, entry.offsets[i]);
+			}
+
+			if (!out)
+				return;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(partial, path, error);
+
+		if (error)
+			std::filesystem::remove(partial, error);
+	}
+
+	std::shared_ptr<const function_template> function_store::find(const store_key& key)
+	{
+		{
+			std::scoped_lock lock{ m_lock };
+			auto found = m_entries.find(key);
+
+			if (found != m_entries.end()) {
+				m_hits++;
+				return found->second;
+			}
+		}
+
+		if (!m_directory.empty()) {
+			if (auto entry = load(key)) {
+				std::scoped_lock lock{ m_lock };
+				m_hits++;
+				return m_entries.emplace(key, std::move(entry)).first->second;
+			}
+		}
+
+		m_misses++;
+		return nullptr;
+	}
+
+	std::shared_ptr<const function_template> function_store::insert(const store_key& key, function_template entry)
+	{
+		auto shared = std::make_shared<const function_template>(std::move(entry));
+
+		{
+			std::scoped_lock lock{ m_lock };
+			auto [found, inserted] = m_entries.emplace(key, shared);
+
+			//Someone else analyzed the same function at the same time
+			if (!inserted)
+				return found->second;
+		}
+
+		if (!m_directory.empty())
+			save(key, *shared);
+
+		return shared;
+	}
+
+	const size_t function_store::get_hits() const
+	{
+		return m_hits;
+	}
+
+	const size_t function_store::get_misses() const
+	{
+		return m_misses;
+	}
+}
\ No newline at end of file
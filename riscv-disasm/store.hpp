@@ -0,0 +1,96 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "instructions.hpp"
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <unordered_map>
+
+namespace riscv
+{
+	//Two independent 64 bit hashes over the code bytes, the architecture and the length. Nothing that depends
+	//on where the function was linked goes in, so the same function in two images gets the same key
+	struct store_key
+	{
+		uint64_t low;
+		uint64_t high;
+
+		bool operator==(const store_key& other) const
+		{
+			return low == other.low && high == other.high;
+		}
+
+		const std::string to_string() const;
+	};
+
+	const store_key make_store_key(const uint8_t* code, const size_t size, const isa arch);
+
+	//A function listing with every address in it replaced by its offset from the function start, text
+	//pieces and offsets alternate: pieces[0] offsets[0] pieces[1] ... pieces[n]
+	struct function_template
+	{
+		std::vector<std::string> pieces;
+		std::vector<uint64_t> offsets;
+
+		void render(std::ostream& out, const uint64_t base_address, const isa arch) const;
+	};
+
+	//Decodes and analyzes the function once and works out which numbers in the listing move with it.
+	//Empty if the listing can't be made position independent, that function just doesn't get stored
+	std::optional<function_template> make_function_template(const std::vector<uint8_t>& code, const isa arch, const uint64_t base_address);
+
+	//Listings of functions already seen, in memory and optionally in a directory so they carry over between runs
+	//and between every image of a firmware release. Safe to share between threads
+	class function_store
+	{
+		struct key_hash
+		{
+			size_t operator()(const store_key& key) const
+			{
+				return static_cast<size_t>(key.low);
+			}
+		};
+
+		std::filesystem::path m_directory;
+		std::mutex m_lock;
+		std::unordered_map<store_key, std::shared_ptr<const function_template>, key_hash> m_entries;
+
+		std::atomic<size_t> m_hits = 0;
+		std::atomic<size_t> m_misses = 0;
+
+		const std::filesystem::path entry_path(const store_key& key) const;
+		std::shared_ptr<const function_template> load(const store_key& key) const;
+		void save(const store_key& key, const function_template& entry) const;
+
+	public:
+		function_store(const function_store& store) = delete;
+		function_store(function_store&& store) = delete;
+
+		//No directory keeps everything in memory only
+		explicit function_store(std::filesystem::path directory = {});
+
+		std::shared_ptr<const function_template> find(const store_key& key);
+		std::shared_ptr<const function_template> insert(const store_key& key, function_template entry);
+
+		const size_t get_hits() const;
+		const size_t get_misses() const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "stream.hpp"
+
+namespace riscv
+{
+	ring_buffer::ring_buffer(const size_t capacity)
+	{
+		size_t size = 16;
+		while (size < capacity)
+			size <<= 1;
+
+		m_data.resize(size);
+		m_mask = size - 1;
+	}
+
+	bool ring_buffer::fill(std::istream& in)
+	{
+		while (size() < m_data.size())
+		{
+			//Free space is contiguous up to the end of the storage, the rest gets picked up on the next round
+			const size_t start = static_cast<size_t>(m_tail & m_mask);
+			const size_t free = std::min(m_data.size() - size(), m_data.size() - start);
+
+			in.read(reinterpret_cast<char*>(m_data.data() + start), static_cast<std::streamsize>(free));
+			const size_t got = static_cast<size_t>(in.gcount());
+			m_tail += got;
+
+			if (got < free)
+				return false;
+		}
+
+		return true;
+	}
+
+	stream_disassembler::stream_disassembler(const isa arch, const uint64_t base_address, const size_t buffer_size) : m_formatter{ arch }, m_cache{ m_formatter }, m_buffer{ buffer_size }, m_address{ base_address }
+	{}
+
+	void stream_disassembler::process(std::istream& in, std::ostream& out)
+	{
+		output_writer writer{ out };
+
+		process(in, writer);
+		writer.finish();
+	}
+
+	void stream_disassembler::process(std::istream& in, output_writer& writer)
+	{
+		const bool rv32 = m_formatter.get_architecture() == isa::RV32;
+
+		std::string text = writer.acquire();
+
+		for (bool more = true; more;)
+		{
+			more = m_buffer.fill(in);
+
+			while (m_buffer.size() >= 2)
+			{
+				uint32_t raw = m_buffer.at(0) | (static_cast<uint32_t>(m_buffer.at(1)) << 8);
+				const size_t length = (raw & 0x3) == 0x3 ? 4 : 2;
+
+				//Rest of it comes with the next fill
+				if (m_buffer.size() < length)
+					break;
+
+				if (length == 4)
+					raw |= (static_cast<uint32_t>(m_buffer.at(2)) << 16) | (static_cast<uint32_t>(m_buffer.at(3)) << 24);
+
+				const uint64_t address = rv32 ? m_address & 0xffffffff : m_address;
+
+				append_hex(text, address);
+				text += ": ";
+				m_cache.format(text, raw, address);
+				text += '\n';
+
+				m_buffer.consume(length);
+				m_address += length;
+
+				if (text.size() >= output_writer::block_size) {
+					writer.submit(std::move(text));
+					text = writer.acquire();
+				}
+			}
+		}
+
+		if (m_buffer.size()) {
+			append_hex(text, rv32 ? m_address & 0xffffffff : m_address);
+			text += ": ; " + std::to_string(m_buffer.size()) + " trailing byte(s)\n";
+			m_buffer.consume(m_buffer.size());
+		}
+
+		writer.submit(std::move(text));
+	}
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "trace.hpp"
+#include "writer.hpp"
+#include <istream>
+
+namespace riscv
+{
+	//Fixed size byte ring, positions only ever grow and get masked on access so an instruction can straddle the wrap
+	class ring_buffer
+	{
+		std::vector<uint8_t> m_data;
+		size_t m_mask;
+		uint64_t m_head = 0;
+		uint64_t m_tail = 0;
+
+	public:
+		ring_buffer() = delete;
+		ring_buffer(const ring_buffer& buffer) = delete;
+		ring_buffer(ring_buffer&& buffer) = delete;
+
+		//Rounded up to a power of two
+		explicit ring_buffer(const size_t capacity);
+
+		//Reads until the buffer is full or the input ends, false once nothing more will come
+		bool fill(std::istream& in);
+
+		size_t size() const
+		{
+			return static_cast<size_t>(m_tail - m_head);
+		}
+
+		uint8_t at(const size_t offset) const
+		{
+			return m_data[(m_head + offset) & m_mask];
+		}
+
+		void consume(const size_t count)
+		{
+			m_head += count;
+		}
+	};
+
+	//Linear disassembly of a byte stream of any length in constant memory: the input goes through a ring buffer,
+	//an instruction cut off by the end of a read waits for the next one, and output goes out in blocks as it's made
+	class stream_disassembler
+	{
+		disassembler m_formatter;
+		decode_cache m_cache;
+		ring_buffer m_buffer;
+		uint64_t m_address;
+
+	public:
+		stream_disassembler() = delete;
+		stream_disassembler(const stream_disassembler& disasm) = delete;
+		stream_disassembler(stream_disassembler&& disasm) = delete;
+
+		stream_disassembler(const isa arch, const uint64_t base_address = 0, const size_t buffer_size = 1024 * 1024);
+
+		void process(std::istream& in, std::ostream& out);
+
+		//Same, with the writes on the writer's thread so decoding never waits for output
+		void process(std::istream& in, output_writer& writer);
+	};
+}
\ No newline at end of file
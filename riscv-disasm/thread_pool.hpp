@@ -0,0 +1,177 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace riscv
+{
+	class thread_pool
+	{
+		std::vector<std::thread> m_workers;
+		std::queue<std::function<void()>> m_tasks;
+		std::mutex m_lock;
+		std::condition_variable m_signal;
+		bool m_stopping = false;
+
+		void worker()
+		{
+			for (;;)
+			{
+				std::function<void()> task;
+
+				{
+					std::unique_lock lock{ m_lock };
+					m_signal.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+
+					if (m_tasks.empty())
+						return;
+
+					task = std::move(m_tasks.front());
+					m_tasks.pop();
+				}
+
+				task();
+			}
+		}
+
+	public:
+		thread_pool(const thread_pool& pool) = delete;
+		thread_pool(thread_pool&& pool) = delete;
+
+		explicit thread_pool(size_t threads = std::thread::hardware_concurrency())
+		{
+			if (threads == 0)
+				threads = 1;
+
+			for (size_t i = 0; i < threads; i++)
+				m_workers.emplace_back([this] { worker(); });
+		}
+
+		~thread_pool()
+		{
+			{
+				std::scoped_lock lock{ m_lock };
+				m_stopping = true;
+			}
+
+			m_signal.notify_all();
+
+			for (auto& worker : m_workers)
+				worker.join();
+		}
+
+		size_t size() const
+		{
+			return m_workers.size();
+		}
+
+		template<typename F>
+		auto submit(F&& task) -> std::future<decltype(task())>
+		{
+			auto packaged = std::make_shared<std::packaged_task<decltype(task())()>>(std::forward<F>(task));
+			auto result = packaged->get_future();
+
+			{
+				std::scoped_lock lock{ m_lock };
+				m_tasks.emplace([packaged] { (*packaged)(); });
+			}
+
+			m_signal.notify_one();
+			return result;
+		}
+
+		//Runs body(i) for every i in [0, count) and returns once all of them are done
+		//The calling thread takes part too, and helpers that only get scheduled after the work ran out just return,
+		//so this is safe to call from inside a task running on the same pool
+		template<typename F>
+		void parallel_for(const size_t count, F&& body)
+		{
+			struct shared_state
+			{
+				std::atomic<size_t> next{ 0 };
+				std::mutex lock;
+				std::condition_variable done;
+				size_t running = 0;
+				bool closed = false;
+				std::exception_ptr error;
+			};
+
+			auto state = std::make_shared<shared_state>();
+
+			auto run = [state, count, &body]
+			{
+				try {
+					for (size_t i = state->next++; i < count; i = state->next++)
+						body(i);
+				} catch (...) {
+					std::scoped_lock lock{ state->lock };
+
+					if (!state->error)
+						state->error = std::current_exception();
+
+					state->next = count;
+				}
+			};
+
+			const size_t helpers = std::min(m_workers.size(), count > 0 ? count - 1 : 0);
+
+			for (size_t i = 0; i < helpers; i++)
+			{
+				std::scoped_lock lock{ m_lock };
+
+				m_tasks.emplace([state, run]
+				{
+					{
+						std::scoped_lock lock{ state->lock };
+
+						if (state->closed)
+							return;
+
+						state->running++;
+					}
+
+					run();
+
+					std::scoped_lock lock{ state->lock };
+
+					if (--state->running == 0)
+						state->done.notify_all();
+				});
+			}
+
+			m_signal.notify_all();
+			run();
+
+			std::unique_lock lock{ state->lock };
+			state->closed = true;
+			state->done.wait(lock, [&state] { return state->running == 0; });
+
+			if (state->error)
+				std::rethrow_exception(state->error);
+		}
+	};
+}
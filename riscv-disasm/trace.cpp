@@ -0,0 +1,255 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "trace.hpp"
+
+namespace riscv
+{
+	namespace
+	{
+		int hex_digit(const char c)
+		{
+			if (c >= '0' && c <= '9')
+				return c - '0';
+
+			if (c >= 'a' && c <= 'f')
+				return c - 'a' + 10;
+
+			if (c >= 'A' && c <= 'F')
+				return c - 'A' + 10;
+
+			return -1;
+		}
+
+		bool is_space(const char c)
+		{
+			return c == ' ' || c == '\t' || c == '\r';
+		}
+
+		//Hex number with or without 0x at position, moves position past it
+		std::optional<uint64_t> parse_hex(std::string_view line, size_t& position)
+		{
+			if (line.size() - position > 2 && line[position] == '0' && (line[position + 1] == 'x' || line[position + 1] == 'X'))
+				position += 2;
+
+			uint64_t value = 0;
+			size_t digits = 0;
+
+			for (; position < line.size(); position++, digits++)
+			{
+				const int digit = hex_digit(line[position]);
+				if (digit < 0)
+					break;
+
+				value = (value << 4) | digit;
+			}
+
+			if (!digits || digits > 16)
+				return std::nullopt;
+
+			return value;
+		}
+
+		void skip_spaces(std::string_view line, size_t& position)
+		{
+			while (position < line.size() && is_space(line[position]))
+				position++;
+		}
+	}
+
+	std::optional<trace_record> parse_trace_line(std::string_view line)
+	{
+		size_t position = 0;
+
+		//"core   0:" prefix, the hart number is decimal and would otherwise look like a pc
+		if (line.substr(0, 4) == "core") {
+			position = line.find(':');
+			if (position == std::string_view::npos)
+				return std::nullopt;
+
+			position++;
+		}
+
+		const size_t open = line.find('(', position);
+
+		if (open != std::string_view::npos) {
+			//pc is the last number before the parenthesis, commit logs put the privilege level in front of it
+			std::optional<uint64_t> pc;
+
+			while (position < open)
+			{
+				skip_spaces(line, position);
+
+				if (position >= open)
+					break;
+
+				size_t end = position;
+				pc = parse_hex(line, end);
+
+				if (end == position || (end < line.size() && !is_space(line[end]) && end != open))
+					return std::nullopt;
+
+				position = end;
+			}
+
+			position = open + 1;
+			auto raw = parse_hex(line, position);
+
+			if (!pc || !raw || position >= line.size() || line[position] != ')' || *raw > 0xffffffff)
+				return std::nullopt;
+
+			return trace_record{ *pc, static_cast<uint32_t>(*raw) };
+		}
+
+		skip_spaces(line, position);
+		auto pc = parse_hex(line, position);
+
+		if (!pc || position >= line.size() || !is_space(line[position]))
+			return std::nullopt;
+
+		skip_spaces(line, position);
+		auto raw = parse_hex(line, position);
+
+		if (!raw || *raw > 0xffffffff)
+			return std::nullopt;
+
+		return trace_record{ *pc, static_cast<uint32_t>(*raw) };
+	}
+
+	void append_hex(std::string& out, uint64_t value)
+	{
+		char digits[16];
+		size_t count = 0;
+
+		do {
+			digits[count++] = "0123456789abcdef"[value & 0xf];
+			value >>= 4;
+		} while (value);
+
+		out += "0x";
+
+		while (count)
+			out += digits[--count];
+	}
+
+	decode_cache::decode_cache(const disassembler& formatter, const uint32_t bits) : m_formatter{ formatter }, m_entries(size_t{ 1 } << bits), m_shift{ 32 - bits }
+	{}
+
+	void decode_cache::format(std::string& out, const uint32_t raw, const uint64_t address)
+	{
+		//Fibonacci hashing, encodings that only differ in a register field would all collide with a plain mask
+		entry& slot = m_entries[static_cast<uint32_t>(raw * 0x9e3779b1u) >> m_shift];
+
+		if (!slot.valid || slot.raw != raw) {
+			slot.raw = raw;
+			slot.valid = true;
+			slot.decoded.emplace(raw, m_formatter.get_architecture());
+
+			const uint32_t opcode = slot.decoded->get_expanded() & 0x7f;
+			slot.pc_relative = opcode == 0x63 || opcode == 0x6f;
+			slot.text.clear();
+
+			if (!slot.pc_relative) {
+				m_text.str({});
+				m_formatter.format(m_text, *slot.decoded, 0);
+				slot.text = m_text.str();
+			}
+		}
+
+		if (!slot.pc_relative) {
+			out += slot.text;
+			return;
+		}
+
+		m_text.str({});
+		m_formatter.format(m_text, *slot.decoded, address);
+		out += m_text.str();
+	}
+
+	trace_reader::trace_reader(const isa arch, thread_pool& pool) : m_formatter{ arch }, m_pool{ pool }
+	{}
+
+	void trace_reader::process_chunk(std::string_view chunk, std::string& out, decode_cache& cache) const
+	{
+		out.clear();
+
+		while (!chunk.empty())
+		{
+			size_t end = chunk.find('\n');
+			if (end == std::string_view::npos)
+				end = chunk.size();
+
+			if (auto record = parse_trace_line(chunk.substr(0, end))) {
+				append_hex(out, m_formatter.get_architecture() == isa::RV32 ? record->pc & 0xffffffff : record->pc);
+				out += ": ";
+				cache.format(out, record->raw, record->pc);
+				out += '\n';
+			}
+
+			chunk.remove_prefix(std::min(end + 1, chunk.size()));
+		}
+	}
+
+	void trace_reader::process(std::istream& in, std::ostream& out)
+	{
+		const size_t chunk_count = 4 * (std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1);
+
+		while (m_caches.size() < chunk_count)
+			m_caches.push_back(std::make_unique<decode_cache>(m_formatter));
+
+		std::vector<std::string> outputs(chunk_count);
+		std::string block;
+		std::string carry;
+
+		while (in)
+		{
+			block.swap(carry);
+			carry.clear();
+
+			const size_t kept = block.size();
+			block.resize(kept + block_size);
+			in.read(block.data() + kept, block_size);
+			block.resize(kept + static_cast<size_t>(in.gcount()));
+
+			//The partial last line waits for the next block
+			if (in) {
+				const size_t last_line = block.rfind('\n');
+
+				if (last_line != std::string::npos) {
+					carry.assign(block, last_line + 1, std::string::npos);
+					block.resize(last_line + 1);
+				}
+			}
+
+			std::vector<std::string_view> chunks;
+			std::string_view rest{ block };
+
+			for (size_t i = 0; i < chunk_count && !rest.empty(); i++)
+			{
+				size_t end = i + 1 == chunk_count ? rest.size() : std::min(rest.size(), block.size() / chunk_count);
+				end = rest.find('\n', end ? end - 1 : 0);
+				end = end == std::string_view::npos ? rest.size() : end + 1;
+
+				chunks.push_back(rest.substr(0, end));
+				rest.remove_prefix(end);
+			}
+
+			m_pool.parallel_for(chunks.size(), [&](const size_t index) { process_chunk(chunks[index], outputs[index], *m_caches[index]); });
+
+			for (size_t i = 0; i < chunks.size(); i++)
+				out.write(outputs[i].data(), outputs[i].size());
+		}
+	}
+}
\ No newline at end of file
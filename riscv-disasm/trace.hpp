@@ -0,0 +1,92 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "disassembler.hpp"
+#include "thread_pool.hpp"
+#include <istream>
+#include <optional>
+#include <sstream>
+#include <string_view>
+
+namespace riscv
+{
+	struct trace_record
+	{
+		uint64_t pc;
+		uint32_t raw;
+	};
+
+	//Spike style lines ("core   0: 0x0000000080000000 (0x00000297) ...", commit logs included) or plain "<pc> <instruction>" hex pairs.
+	//Anything else (exceptions, register dumps) isn't an instruction
+	std::optional<trace_record> parse_trace_line(std::string_view line);
+
+	//"0x" and lowercase hex without leading zeros, what the listings print, without going through a stream
+	void append_hex(std::string& out, uint64_t value);
+
+	//Direct mapped on the raw bits, traces keep executing the same handful of encodings so nearly everything is a hit.
+	//Text for anything that doesn't print a pc relative target is cached as is, branches and jumps only keep the decode
+	class decode_cache
+	{
+		struct entry
+		{
+			uint32_t raw;
+			bool valid = false;
+			bool pc_relative;
+			std::optional<instruction::object> decoded;
+			std::string text;
+		};
+
+		const disassembler& m_formatter;
+		std::vector<entry> m_entries;
+		uint32_t m_shift;
+		std::ostringstream m_text;
+
+	public:
+		decode_cache() = delete;
+		decode_cache(const decode_cache& cache) = delete;
+		decode_cache(decode_cache&& cache) = delete;
+
+		//bits is log2 of the number of entries
+		decode_cache(const disassembler& formatter, const uint32_t bits = 14);
+
+		void format(std::string& out, const uint32_t raw, const uint64_t address);
+	};
+
+	class trace_reader
+	{
+		disassembler m_formatter;
+		thread_pool& m_pool;
+
+		//One per chunk of a block, chunk i always uses cache i so they're never shared between threads
+		std::vector<std::unique_ptr<decode_cache>> m_caches;
+
+		static constexpr size_t block_size = 16 * 1024 * 1024;
+
+		void process_chunk(std::string_view chunk, std::string& out, decode_cache& cache) const;
+
+	public:
+		trace_reader() = delete;
+		trace_reader(const trace_reader& reader) = delete;
+		trace_reader(trace_reader&& reader) = delete;
+
+		trace_reader(const isa arch, thread_pool& pool);
+
+		//Reads the trace a block at a time, each block is split on line boundaries into chunks that are
+		//parsed and formatted in parallel, then written out in order
+		void process(std::istream& in, std::ostream& out);
+	};
+}
\ No newline at end of file
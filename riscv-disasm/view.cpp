@@ -0,0 +1,322 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "view.hpp"
+#include "boundaries.hpp"
+#include <algorithm>
+
+namespace riscv
+{
+	code_view::code_view(const image& img, const segment& seg, const size_t cache_pages) : m_segment{ seg }, m_architecture{ img.get_architecture() }, m_formatter{ img.get_architecture() }, m_page_starts((seg.size + page_size - 1) / page_size, unknown), m_page_sure(m_page_starts.size(), false), m_cache_pages{ std::max<size_t>(cache_pages, 2) }
+	{
+		m_seeds.push_back(0);
+
+		for (auto& sym : img.get_symbols())
+		{
+			if (sym.function && seg.contains(sym.address) && !(sym.address & 1))
+				m_seeds.push_back(sym.address - seg.address);
+		}
+
+		std::sort(m_seeds.begin(), m_seeds.end());
+		m_seeds.erase(std::unique(m_seeds.begin(), m_seeds.end()), m_seeds.end());
+	}
+
+	size_t code_view::length_at(const uint64_t offset) const
+	{
+		return instruction_length(m_segment.data[offset]);
+	}
+
+	uint64_t code_view::walk(uint64_t offset, const uint64_t target) const
+	{
+		return walk_lengths(m_segment.data, offset, target);
+	}
+
+	uint64_t code_view::page_start(const size_t index)
+	{
+		if (m_page_starts[index] != unknown)
+			return m_page_starts[index];
+
+		const uint64_t boundary = static_cast<uint64_t>(index) * page_size;
+
+		//Closest known start at or before the page, from a seed or an earlier page
+		uint64_t from = 0;
+		size_t from_page = index;
+		bool sure = true;
+
+		auto seed = std::upper_bound(m_seeds.begin(), m_seeds.end(), boundary);
+		from = *std::prev(seed);
+
+		for (size_t i = index; i-- > 0 && boundary - static_cast<uint64_t>(i) * page_size <= max_walk;)
+		{
+			if (m_page_starts[i] != unknown) {
+				if (m_page_starts[i] > from) {
+					from = m_page_starts[i];
+					from_page = i;
+					sure = m_page_sure[i];
+				}
+				break;
+			}
+		}
+
+		if (boundary - from > max_walk) {
+			from = boundary > lead_in ? boundary - lead_in : 0;
+			from_page = index;
+			sure = false;
+		}
+
+		//Fill in every page passed on the way so the next lookup nearby is free
+		for (size_t i = from_page + 1; i < index; i++)
+		{
+			if (m_page_starts[i] == unknown) {
+				m_page_starts[i] = walk(from, static_cast<uint64_t>(i) * page_size);
+				m_page_sure[i] = sure;
+			}
+
+			from = m_page_starts[i];
+			sure = m_page_sure[i];
+		}
+
+		m_page_starts[index] = walk(from, boundary);
+		m_page_sure[index] = sure;
+		return m_page_starts[index];
+	}
+
+	void code_view::link(size_t index, uint64_t offset, const bool sure)
+	{
+		//The earlier page wins unless the later start came from a seed. Same idea as redoing chunks in
+		//scan_chunks, once a fixed up start agrees with what was there everything after it is right again
+		for (; index < m_page_starts.size(); index++)
+		{
+			if (m_page_starts[index] == offset) {
+				m_page_sure[index] = m_page_sure[index] || sure;
+				return;
+			}
+
+			const bool known = m_page_starts[index] != unknown;
+
+			if (known && m_page_sure[index])
+				return;
+
+			m_page_starts[index] = offset;
+			m_page_sure[index] = sure;
+
+			if (!known)
+				return;
+
+			if (auto cached = m_pages.find(index); cached != m_pages.end()) {
+				m_recent.erase(cached->second.second);
+				m_pages.erase(cached);
+			}
+
+			offset = walk(offset, static_cast<uint64_t>(index + 1) * page_size);
+		}
+	}
+
+	const code_view::page& code_view::get_page(const size_t index)
+	{
+		auto cached = m_pages.find(index);
+
+		if (cached != m_pages.end()) {
+			m_recent.splice(m_recent.begin(), m_recent, cached->second.second);
+			return cached->second.first;
+		}
+
+		if (m_pages.size() >= m_cache_pages) {
+			m_pages.erase(m_recent.back());
+			m_recent.pop_back();
+		}
+
+		page decoded;
+		const uint64_t end = std::min<uint64_t>(static_cast<uint64_t>(index + 1) * page_size, m_segment.size);
+
+		uint64_t offset = page_start(index);
+		const bool sure = m_page_sure[index];
+
+		//A guessed page never runs over a start that is known for sure
+		uint64_t limit = m_segment.size;
+
+		if (index + 1 < m_page_starts.size() && m_page_starts[index + 1] != unknown && m_page_sure[index + 1])
+			limit = m_page_starts[index + 1];
+
+		while (offset < end)
+		{
+			const size_t length = length_at(offset);
+
+			//Cut off by the end of the segment or by a start known for sure
+			if (offset + length > limit)
+				break;
+
+			uint32_t raw = m_segment.data[offset] | (static_cast<uint32_t>(m_segment.data[offset + 1]) << 8);
+			if (length == 4)
+				raw |= (static_cast<uint32_t>(m_segment.data[offset + 2]) << 16) | (static_cast<uint32_t>(m_segment.data[offset + 3]) << 24);
+
+			decoded.addresses.push_back(m_segment.address + offset);
+			decoded.instructions.emplace_back(raw, m_architecture);
+			offset += length;
+		}
+
+		//Where this page ran out is exactly where the next one starts
+		link(index + 1, offset, sure);
+
+		m_recent.push_front(index);
+		return m_pages.emplace(index, std::pair{ std::move(decoded), m_recent.begin() }).first->second.first;
+	}
+
+	std::pair<size_t, size_t> code_view::locate(const uint64_t offset)
+	{
+		size_t index = static_cast<size_t>(offset / page_size);
+
+		//A guessed start gets checked against the page before it first, so every lookup of an address sees the same
+		//instructions no matter which pages happened to be decoded already
+		if (index > 0 && !m_page_sure[index]) {
+			page_start(index);
+
+			if (!m_page_sure[index])
+				get_page(index - 1);
+		}
+
+		for (;;)
+		{
+			const page& current = get_page(index);
+			const uint64_t address = m_segment.address + offset;
+
+			//Covered by an instruction that started in an earlier page
+			if (current.addresses.empty() || current.addresses.front() > address) {
+				if (index == 0)
+					return { 0, 0 };
+
+				index--;
+				continue;
+			}
+
+			const size_t position = std::upper_bound(current.addresses.begin(), current.addresses.end(), address) - current.addresses.begin() - 1;
+			return { index, position };
+		}
+	}
+
+	std::vector<view_line> code_view::window(const uint64_t address, const size_t before, const size_t after)
+	{
+		std::vector<view_line> lines;
+
+		if (!m_segment.contains(address) || m_page_starts.empty())
+			return lines;
+
+		auto [page_index, at] = locate(address - m_segment.address);
+
+		//Step back to the first line, then collect forwards. Decoding the pages behind can move where the ones after
+		//start, so the line covering the address is looked for again in what comes out rather than counted on
+		size_t leading = 0;
+
+		while (leading < before)
+		{
+			if (at == 0) {
+				if (page_index == 0)
+					break;
+
+				page_index--;
+				at = get_page(page_index).addresses.size();
+				continue;
+			}
+
+			at--;
+			leading++;
+		}
+
+		lines.reserve(leading + after);
+
+		size_t covering = 0;
+
+		while (page_index < m_page_starts.size())
+		{
+			const page& current = get_page(page_index);
+
+			if (at >= current.addresses.size()) {
+				page_index++;
+				at = 0;
+				continue;
+			}
+
+			if (current.addresses[at] > address) {
+				if (lines.size() >= covering + after)
+					break;
+			} else {
+				covering = lines.size();
+			}
+
+			lines.push_back({ current.addresses[at], current.instructions[at] });
+			at++;
+		}
+
+		//view_line can't be shuffled around, a fresh copy drops whatever ended up outside the window
+		const size_t first = covering > before ? covering - before : 0;
+		const size_t last = std::min(lines.size(), covering + after);
+
+		if (first == 0 && last == lines.size())
+			return lines;
+
+		return std::vector<view_line>(lines.begin() + first, lines.begin() + last);
+	}
+
+	std::optional<uint64_t> code_view::instruction_start(const uint64_t address)
+	{
+		auto lines = window(address, 0, 1);
+
+		if (lines.empty())
+			return std::nullopt;
+
+		return lines.front().address;
+	}
+
+	std::optional<uint64_t> code_view::next(const uint64_t address)
+	{
+		auto lines = window(address, 0, 2);
+
+		if (lines.size() < 2)
+			return std::nullopt;
+
+		return lines.back().address;
+	}
+
+	std::optional<uint64_t> code_view::previous(const uint64_t address)
+	{
+		auto lines = window(address, 1, 1);
+
+		if (lines.size() < 2)
+			return std::nullopt;
+
+		return lines.front().address;
+	}
+
+	void code_view::print(std::ostream& out, const uint64_t address, const size_t before, const size_t after)
+	{
+		const auto lines = window(address, before, after);
+
+		//Marked from the same lines that get printed, the start has to agree with them
+		uint64_t current = ~0ull;
+
+		for (auto& line : lines)
+		{
+			if (line.address <= address)
+				current = line.address;
+		}
+
+		for (auto& line : lines)
+		{
+			out << (line.address == current ? "> " : "  ") << "0x" << std::hex << line.address << ": ";
+			m_formatter.format(out, line.instruction, line.address);
+			out << "\n";
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include "disassembler.hpp"
+#include "image.hpp"
+#include <list>
+#include <unordered_map>
+
+namespace riscv
+{
+	struct view_line
+	{
+		uint64_t address;
+		instruction::object instruction;
+	};
+
+	//Random access over one code segment without decoding it up front. Where instructions start is only known
+	//by decoding from a known start, so the view keeps the first start of every page it has needed so far and
+	//gets new ones by walking instruction lengths from the closest known start. Starts too far from anything known
+	//are picked up with a short lead in instead, mixed 16/32 bit code falls back into step within a few instructions,
+	//and a guess gets corrected once the page before it has been decoded and ends somewhere else.
+	//Decoded pages live in an LRU. Not thread safe, every lookup can change the caches
+	class code_view
+	{
+		struct page
+		{
+			std::vector<uint64_t> addresses;
+			std::vector<instruction::object> instructions;
+		};
+
+		const segment& m_segment;
+		const isa m_architecture;
+		disassembler m_formatter;
+
+		//Offset of the first instruction starting in each page, or unknown
+		std::vector<uint64_t> m_page_starts;
+		//Walked from a seed rather than guessed from a lead in
+		std::vector<bool> m_page_sure;
+		//Function symbols and the segment start, starts we know for sure
+		std::vector<uint64_t> m_seeds;
+
+		std::list<size_t> m_recent;
+		std::unordered_map<size_t, std::pair<page, std::list<size_t>::iterator>> m_pages;
+		size_t m_cache_pages;
+
+		static constexpr size_t page_size = 4096;
+		static constexpr uint64_t unknown = ~0ull;
+		//About 128K length checks, well under a millisecond
+		static constexpr size_t max_walk = 256 * 1024;
+		static constexpr size_t lead_in = 64;
+
+		size_t length_at(const uint64_t offset) const;
+		uint64_t walk(uint64_t offset, const uint64_t target) const;
+		uint64_t page_start(const size_t index);
+		//Where the page before index really ended, fixes up guessed starts from there on until they agree again
+		void link(size_t index, uint64_t offset, const bool sure);
+		const page& get_page(const size_t index);
+
+		//Page and position of the instruction covering offset
+		std::pair<size_t, size_t> locate(const uint64_t offset);
+
+	public:
+		code_view() = delete;
+		code_view(const code_view& view) = delete;
+		code_view(code_view&& view) = delete;
+
+		code_view(const image& img, const segment& seg, const size_t cache_pages = 256);
+
+		//The instruction covering address, up to before instructions ahead of it and after - 1 behind it
+		std::vector<view_line> window(const uint64_t address, const size_t before, const size_t after);
+
+		//Start of the instruction covering address, of the one after it and of the one before it
+		std::optional<uint64_t> instruction_start(const uint64_t address);
+		std::optional<uint64_t> next(const uint64_t address);
+		std::optional<uint64_t> previous(const uint64_t address);
+
+		void print(std::ostream& out, const uint64_t address, const size_t before, const size_t after);
+	};
+}
\ No newline at end of file
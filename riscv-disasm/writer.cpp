@@ -0,0 +1,190 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#include "writer.hpp"
+#include <iostream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+#define RISCV_WRITER_WRITEV
+#endif
+
+namespace riscv
+{
+	output_writer::output_writer(std::ostream& out) : m_out{ out }
+	{
+#ifdef RISCV_WRITER_WRITEV
+		if (&out == &std::cout) {
+			std::cout.flush();
+			m_descriptor = 1;
+		}
+#endif
+
+		m_thread = std::thread{ [this] { run(); } };
+	}
+
+	output_writer::~output_writer()
+	{
+		try {
+			finish();
+		} catch (...) {
+		}
+	}
+
+	std::string output_writer::acquire()
+	{
+		{
+			std::scoped_lock lock{ m_lock };
+
+			if (!m_free.empty()) {
+				std::string block = std::move(m_free.back());
+				m_free.pop_back();
+				return block;
+			}
+		}
+
+		std::string block;
+		block.reserve(block_size + 256);
+		return block;
+	}
+
+	void output_writer::submit(std::string&& block)
+	{
+		if (block.empty())
+			return;
+
+		std::unique_lock lock{ m_lock };
+
+		//Back pressure, a single block bigger than the limit still goes through once the queue drained
+		m_space.wait(lock, [this] { return m_pending_bytes < max_pending_bytes || m_pending.empty(); });
+
+		m_pending_bytes += block.size();
+		m_pending.push_back(std::move(block));
+		m_ready.notify_one();
+	}
+
+	void output_writer::finish()
+	{
+		{
+			std::scoped_lock lock{ m_lock };
+
+			if (m_finished)
+				return;
+
+			m_finished = true;
+			m_closing = true;
+		}
+
+		m_ready.notify_one();
+		m_thread.join();
+
+		if (m_descriptor < 0)
+			m_out.flush();
+
+		if (m_failed)
+			throw std::runtime_error("writer: output failed");
+	}
+
+	void output_writer::run()
+	{
+		std::vector<std::string> batch;
+
+		for (;;)
+		{
+			{
+				std::unique_lock lock{ m_lock };
+				m_ready.wait(lock, [this] { return m_closing || !m_pending.empty(); });
+
+				if (m_pending.empty())
+					return;
+
+				while (!m_pending.empty() && batch.size() < max_batch)
+				{
+					m_pending_bytes -= m_pending.front().size();
+					batch.push_back(std::move(m_pending.front()));
+					m_pending.pop_front();
+				}
+			}
+
+			m_space.notify_all();
+
+			//After a failure the rest is dropped so producers never get stuck
+			if (!m_failed && !write_batch(batch))
+				m_failed = true;
+
+			std::scoped_lock lock{ m_lock };
+
+			for (auto& block : batch)
+			{
+				if (m_free.size() < max_free && block.capacity() >= block_size) {
+					block.clear();
+					m_free.push_back(std::move(block));
+				}
+			}
+
+			batch.clear();
+		}
+	}
+
+	bool output_writer::write_batch(std::vector<std::string>& batch)
+	{
+#ifdef RISCV_WRITER_WRITEV
+		if (m_descriptor >= 0) {
+			std::vector<iovec> vectors;
+			vectors.reserve(batch.size());
+
+			for (auto& block : batch)
+				vectors.push_back({ block.data(), block.size() });
+
+			size_t first = 0;
+
+			while (first < vectors.size())
+			{
+				const int count = static_cast<int>(std::min<size_t>(vectors.size() - first, IOV_MAX));
+				const ssize_t written = ::writev(m_descriptor, vectors.data() + first, count);
+
+				if (written < 0) {
+					if (errno == EINTR)
+						continue;
+
+					return false;
+				}
+
+				//Partial write, skip what went out and go again
+				size_t left = static_cast<size_t>(written);
+
+				while (first < vectors.size() && left >= vectors[first].iov_len)
+					left -= vectors[first++].iov_len;
+
+				if (left) {
+					vectors[first].iov_base = static_cast<char*>(vectors[first].iov_base) + left;
+					vectors[first].iov_len -= left;
+				}
+			}
+
+			return true;
+		}
+#endif
+
+		for (auto& block : batch)
+			m_out.write(block.data(), static_cast<std::streamsize>(block.size()));
+
+		return static_cast<bool>(m_out);
+	}
+}
\ No newline at end of file
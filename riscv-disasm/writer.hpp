@@ -0,0 +1,73 @@
+//	Copyright(C) 2020 xenocidewiki
+//	This file is part of riscv-disasm.
+//
+//	riscv-disasm is free software : you can redistribute it and /or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	riscv-disasm is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with riscv-disasm. If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace riscv
+{
+	//Output on its own thread: producers hand over finished blocks of text in order and go back to decoding,
+	//the writer thread takes everything queued at once and writes it with a single gathering write (writev where
+	//there is one). Producers block while too much is queued, so memory stays bounded however fast they are
+	class output_writer
+	{
+		std::ostream& m_out;
+		int m_descriptor = -1;
+
+		std::mutex m_lock;
+		std::condition_variable m_ready;
+		std::condition_variable m_space;
+		std::deque<std::string> m_pending;
+		std::vector<std::string> m_free;
+		size_t m_pending_bytes = 0;
+		bool m_closing = false;
+		bool m_failed = false;
+		bool m_finished = false;
+
+		std::thread m_thread;
+
+		static constexpr size_t max_pending_bytes = 64 * 1024 * 1024;
+		static constexpr size_t max_batch = 256;
+		static constexpr size_t max_free = 64;
+
+		void run();
+		bool write_batch(std::vector<std::string>& batch);
+
+	public:
+		static constexpr size_t block_size = 256 * 1024;
+
+		output_writer() = delete;
+		output_writer(const output_writer& writer) = delete;
+		output_writer(output_writer&& writer) = delete;
+
+		//std::cout gets written through the file descriptor directly, anything else through the stream
+		explicit output_writer(std::ostream& out);
+		~output_writer();
+
+		//An empty block with room for block_size bytes, recycled from earlier submissions when possible
+		std::string acquire();
+		void submit(std::string&& block);
+
+		//Waits for everything to be written, throws std::runtime_error if any of it couldn't be
+		void finish();
+	};
+}
\ No newline at end of file